@@ -0,0 +1,151 @@
+#ifndef KWGRAPH_ADJACENCY_H
+#define KWGRAPH_ADJACENCY_H
+
+#include "graphview.h"
+
+namespace KWGraph
+{
+    // Compressed (CSR) undirected view of a graph for the algorithms that
+    // treat edges as symmetric. Every edge shows up in the lists of both of
+    // its ends, neighbors are sorted by id, self loops are dropped and
+    // parallel edges are merged keeping the largest weight. Keeping the max
+    // means an edge that was added in both directions keeps its weight
+    // instead of being counted twice.
+    template <typename T>
+    struct SymmetricAdjacency
+    {
+        // Neighbors of node i are targets[offsets[i]] .. targets[offsets[i + 1]]
+        std::vector<int>    offsets;
+        std::vector<int>    targets;
+        std::vector<T>      weights;
+
+        inline size_t GetNrNodes() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+        inline int GetDegree(int id) const { return offsets[id + 1] - offsets[id]; }
+        inline const int* GetNeighbors(int id) const { return targets.data() + offsets[id]; }
+        inline const T* GetWeights(int id) const { return weights.data() + offsets[id]; }
+    };
+
+    namespace
+    {
+        template <typename T>
+        struct SymmetricBuildData
+        {
+            const std::vector<int>*     offsets;
+            std::vector<int>*           targets;
+            std::vector<T>*             weights;
+            std::vector<int>*           degrees;
+        };
+
+        // Sorts and dedupes the neighbor lists of [begin, end) in place
+        template <typename T>
+        static void SortSymmetricLists(void* userData, int begin, int end)
+        {
+            SymmetricBuildData<T>* data = static_cast<SymmetricBuildData<T>*>(userData);
+            std::vector< std::pair<int, T> > list;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                int first = (*data->offsets)[nodeIt];
+                int last = (*data->offsets)[nodeIt + 1];
+                list.clear();
+                for(int slotIt = first; slotIt < last; ++slotIt)
+                    list.push_back(std::make_pair((*data->targets)[slotIt], (*data->weights)[slotIt]));
+                std::sort(list.begin(), list.end());
+
+                int outIt = first;
+                for(size_t listIt = 0; listIt < list.size(); ++listIt)
+                {
+                    if(outIt > first && (*data->targets)[outIt - 1] == list[listIt].first)
+                    {
+                        T& weight = (*data->weights)[outIt - 1];
+                        weight = std::max(weight, list[listIt].second);
+                        continue;
+                    }
+                    (*data->targets)[outIt] = list[listIt].first;
+                    (*data->weights)[outIt] = list[listIt].second;
+                    ++outIt;
+                }
+                (*data->degrees)[nodeIt] = outIt - first;
+            }
+        }
+
+        template <typename T, typename GraphType>
+        static void BuildSymmetricLists(const GraphType& graph, SymmetricAdjacency<T>& adjacency)
+        {
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            std::vector<int> offsets(nrNodes + 1, 0);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                NeighborRange<T> neighbors = graph.Neighbors(nodeIt);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    int destination = edgeIt.GetDestination();
+                    if(destination == nodeIt)
+                        continue;
+                    ++offsets[nodeIt + 1];
+                    ++offsets[destination + 1];
+                }
+            }
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                offsets[nodeIt + 1] += offsets[nodeIt];
+
+            std::vector<int> targets(offsets[nrNodes]);
+            std::vector<T> weights(offsets[nrNodes]);
+            std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                NeighborRange<T> neighbors = graph.Neighbors(nodeIt);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    NeighborView<T> edge = *edgeIt;
+                    if(edge.destination == nodeIt)
+                        continue;
+                    targets[fill[nodeIt]] = edge.destination;
+                    weights[fill[nodeIt]++] = edge.weight;
+                    targets[fill[edge.destination]] = nodeIt;
+                    weights[fill[edge.destination]++] = edge.weight;
+                }
+            }
+
+            std::vector<int> degrees(nrNodes, 0);
+            SymmetricBuildData<T> data;
+            data.offsets = &offsets;
+            data.targets = &targets;
+            data.weights = &weights;
+            data.degrees = &degrees;
+            if(nrNodes > 0)
+                PParallelFor(0, nrNodes, 0, SortSymmetricLists<T>, &data);
+
+            // Squeeze out the slots freed by the merged duplicates
+            adjacency.offsets.resize(nrNodes + 1);
+            adjacency.offsets[0] = 0;
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                adjacency.offsets[nodeIt + 1] = adjacency.offsets[nodeIt] + degrees[nodeIt];
+            adjacency.targets.resize(adjacency.offsets[nrNodes]);
+            adjacency.weights.resize(adjacency.offsets[nrNodes]);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                std::copy(targets.begin() + offsets[nodeIt], targets.begin() + offsets[nodeIt] + degrees[nodeIt],
+                          adjacency.targets.begin() + adjacency.offsets[nodeIt]);
+                std::copy(weights.begin() + offsets[nodeIt], weights.begin() + offsets[nodeIt] + degrees[nodeIt],
+                          adjacency.weights.begin() + adjacency.offsets[nodeIt]);
+            }
+        }
+    }
+
+    template <typename T>
+    void BuildSymmetricAdjacency(const Graph<T>& graph, SymmetricAdjacency<T>& adjacency)
+    {
+        BuildSymmetricLists(graph, adjacency);
+    }
+
+    // Only the visible edges, hidden nodes end up without neighbors
+    template <typename T>
+    void BuildSymmetricAdjacency(const GraphView<T>& graph, SymmetricAdjacency<T>& adjacency)
+    {
+        BuildSymmetricLists(graph, adjacency);
+    }
+}
+
+#endif
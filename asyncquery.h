@@ -0,0 +1,406 @@
+#ifndef KWGRAPH_ASYNC_QUERY_H
+#define KWGRAPH_ASYNC_QUERY_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "graphview.h"
+
+namespace KWGraph
+{
+    enum QueryStatus
+    {
+        QueryStatus_Pending,
+        QueryStatus_Done,
+        QueryStatus_Cancelled
+    };
+
+    struct ComponentsQueryResult
+    {
+        ComponentsQueryResult() : nrComponents(0) {}
+        std::vector<int> componentIds;
+        int              nrComponents;
+    };
+
+    template <typename Result>
+    struct QueryState
+    {
+        QueryState() : status(QueryStatus_Pending), isCancelled(false) {}
+
+        void Finish(QueryStatus finalStatus)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            status = finalStatus;
+            doneCondition.notify_all();
+        }
+
+        std::mutex              lock;
+        std::condition_variable doneCondition;
+        QueryStatus             status;
+        Result                  result;
+        std::atomic<bool>       isCancelled;
+    };
+
+    // Handle to the result of a query running on the task scheduler
+    // NOTE: Waiting on a future from inside a scheduler task can starve the
+    // pool, only wait on them from threads outside of it
+    template <typename Result>
+    class QueryFuture
+    {
+    private:
+        std::shared_ptr< QueryState<Result> > m_state;
+    public:
+        QueryFuture() {}
+        explicit QueryFuture(const std::shared_ptr< QueryState<Result> >& state) : m_state(state) {}
+
+        bool IsValid() const { return m_state.get() != NULL; }
+
+        bool IsReady() const
+        {
+            std::lock_guard<std::mutex> guard(m_state->lock);
+            return m_state->status != QueryStatus_Pending;
+        }
+
+        QueryStatus Wait() const
+        {
+            std::unique_lock<std::mutex> guard(m_state->lock);
+            while(m_state->status == QueryStatus_Pending)
+                m_state->doneCondition.wait(guard);
+            return m_state->status;
+        }
+
+        // Blocks until the query is done, the result is empty if the query
+        // was cancelled
+        const Result& Get() const
+        {
+            Wait();
+            return m_state->result;
+        }
+
+        // The traversal running the query aborts at the next node it visits
+        void Cancel() { m_state->isCancelled.store(true, std::memory_order_relaxed); }
+    };
+
+    typedef QueryFuture<PathQueryResult>        PathFuture;
+    typedef QueryFuture< std::vector<int> >     DistancesFuture;
+    typedef QueryFuture<ComponentsQueryResult>  ComponentsFuture;
+
+    // Runs graph queries on the task scheduler without blocking the caller.
+    // Shortest path queries from the same source that are still waiting to
+    // run are merged so they share a single BFS. GraphType can also be a
+    // GraphView, hidden nodes reach nothing and are in no component.
+    // NOTE: The graph must not be modified while queries are in flight
+    template <typename T, typename GraphType = Graph<T> >
+    class AsyncQueryEngine
+    {
+    private:
+        typedef std::shared_ptr< QueryState<PathQueryResult> > PathState;
+        typedef std::shared_ptr< QueryState< std::vector<int> > > DistancesState;
+        typedef std::shared_ptr< QueryState<ComponentsQueryResult> > ComponentsState;
+
+        struct PathGroup
+        {
+            AsyncQueryEngine*       engine;
+            int                     source;
+            std::vector<int>        destinations;
+            std::vector<PathState>  queries;
+        };
+
+        struct DistancesTask
+        {
+            AsyncQueryEngine*       engine;
+            int                     source;
+            DistancesState          query;
+        };
+
+        struct ComponentsTask
+        {
+            AsyncQueryEngine*       engine;
+            ComponentsState         query;
+        };
+
+        // Aborts once every destination has been found or every query in the
+        // group has been cancelled
+        class PathGroupVisitor : public GraphVisitor<T>
+        {
+        private:
+            const PathGroup*    m_group;
+            std::vector<int>    m_destinations;
+            size_t              m_nrFound;
+            unsigned int        m_nrProcessed;
+        public:
+            explicit PathGroupVisitor(const PathGroup* group) :
+                GraphVisitor<T>(NULL, group->source),
+                m_group(group),
+                m_destinations(group->destinations),
+                m_nrFound(0),
+                m_nrProcessed(0)
+            {
+                std::sort(m_destinations.begin(), m_destinations.end());
+                m_destinations.erase(std::unique(m_destinations.begin(), m_destinations.end()),
+                                     m_destinations.end());
+            }
+
+            virtual NodeAction OnBeginNodeProcess(const Node<T>& /*node*/)
+            {
+                // Looking at every query is linear in the group size so only
+                // do it every few nodes
+                if((m_nrProcessed++ & 63) != 0)
+                    return NodeAction_Continue;
+                for(size_t queryIt = 0; queryIt < m_group->queries.size(); ++queryIt)
+                {
+                    if(!m_group->queries[queryIt]->isCancelled.load(std::memory_order_relaxed))
+                        return NodeAction_Continue;
+                }
+                return NodeAction_Abort;
+            }
+
+            virtual NodeAction OnNodeProcess(const Node<T>& node)
+            {
+                if(std::binary_search(m_destinations.begin(), m_destinations.end(), node.id))
+                {
+                    if(++m_nrFound == m_destinations.size())
+                        return NodeAction_Abort;
+                }
+                return NodeAction_Continue;
+            }
+        };
+
+        class CancellableVisitor : public GraphVisitor<T>
+        {
+        private:
+            const std::atomic<bool>* m_isCancelled;
+        public:
+            CancellableVisitor(int source, const std::atomic<bool>* isCancelled) :
+                GraphVisitor<T>(NULL, source),
+                m_isCancelled(isCancelled) {}
+
+            virtual NodeAction OnBeginNodeProcess(const Node<T>& /*node*/)
+            {
+                if(m_isCancelled->load(std::memory_order_relaxed))
+                    return NodeAction_Abort;
+                return NodeAction_Continue;
+            }
+        };
+
+        const GraphType*            m_graph;
+        PTaskScheduler*             m_scheduler;
+        PTaskGroup                  m_tasks;
+        std::mutex                  m_lock;
+        std::map<int, PathGroup*>   m_pendingPaths;
+        std::vector<TraversalWorkspace*> m_freeWorkspaces;
+
+        AsyncQueryEngine(const AsyncQueryEngine&);
+        AsyncQueryEngine& operator=(const AsyncQueryEngine&);
+
+        TraversalWorkspace* AcquireWorkspace()
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            if(m_freeWorkspaces.empty())
+                return new TraversalWorkspace();
+            TraversalWorkspace* workspace = m_freeWorkspaces.back();
+            m_freeWorkspaces.pop_back();
+            return workspace;
+        }
+
+        void ReleaseWorkspace(TraversalWorkspace* workspace)
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_freeWorkspaces.push_back(workspace);
+        }
+
+        inline bool IsValidNode(int id) const
+        {
+            return id >= 0 && (size_t)id < m_graph->GetNrNodes();
+        }
+
+        static void RunPathGroup(void* arg)
+        {
+            PathGroup* group = static_cast<PathGroup*>(arg);
+            AsyncQueryEngine* engine = group->engine;
+            {
+                // From here on new queries from this source start a new group
+                std::lock_guard<std::mutex> guard(engine->m_lock);
+                engine->m_pendingPaths.erase(group->source);
+            }
+
+            TraversalWorkspace* workspace = engine->AcquireWorkspace();
+            PathGroupVisitor visitor(group);
+            engine->m_graph->BFS(&visitor, *workspace);
+
+            for(size_t queryIt = 0; queryIt < group->queries.size(); ++queryIt)
+            {
+                PathState& query = group->queries[queryIt];
+                if(query->isCancelled.load(std::memory_order_relaxed))
+                {
+                    query->Finish(QueryStatus_Cancelled);
+                    continue;
+                }
+
+                PathQueryResult& result = query->result;
+                result.found = workspace->GetPath(group->destinations[queryIt], result.path);
+                query->Finish(QueryStatus_Done);
+            }
+
+            engine->ReleaseWorkspace(workspace);
+            delete group;
+        }
+
+        static void RunDistances(void* arg)
+        {
+            DistancesTask* task = static_cast<DistancesTask*>(arg);
+            AsyncQueryEngine* engine = task->engine;
+            TraversalWorkspace* workspace = engine->AcquireWorkspace();
+            CancellableVisitor visitor(task->source, &task->query->isCancelled);
+            engine->m_graph->BFS(&visitor, *workspace);
+
+            if(task->query->isCancelled.load(std::memory_order_relaxed))
+            {
+                task->query->Finish(QueryStatus_Cancelled);
+            }
+            else
+            {
+                size_t nrNodes = engine->m_graph->GetNrNodes();
+                std::vector<int>& distances = task->query->result;
+                distances.resize(nrNodes);
+                for(size_t nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                    distances[nodeIt] = workspace->GetDistance(nodeIt);
+                task->query->Finish(QueryStatus_Done);
+            }
+
+            engine->ReleaseWorkspace(workspace);
+            delete task;
+        }
+
+        static void RunComponents(void* arg)
+        {
+            ComponentsTask* task = static_cast<ComponentsTask*>(arg);
+            AsyncQueryEngine* engine = task->engine;
+            TraversalWorkspace* workspace = engine->AcquireWorkspace();
+            size_t nrNodes = engine->m_graph->GetNrNodes();
+            ComponentsQueryResult& result = task->query->result;
+            result.componentIds.assign(nrNodes, INVALID_ID);
+
+            // Components are the BFS trees, same as the ones Graph::BFS reports
+            CancellableVisitor visitor(0, &task->query->isCancelled);
+            workspace->Reset(nrNodes);
+            bool isCancelled = false;
+            for(size_t nodeIt = 0; nodeIt < nrNodes && !isCancelled; ++nodeIt)
+            {
+                if(workspace->IsVisited(nodeIt) || !IsNodeVisible(*engine->m_graph, nodeIt))
+                    continue;
+                isCancelled = VisitBFSComponent(*engine->m_graph, nodeIt, &visitor, *workspace) == NodeAction_Abort;
+                const std::vector<int>& componentNodes = workspace->queue;
+                for(size_t queueIt = 0; queueIt < componentNodes.size(); ++queueIt)
+                    result.componentIds[componentNodes[queueIt]] = result.nrComponents;
+                ++result.nrComponents;
+            }
+
+            if(isCancelled)
+            {
+                result = ComponentsQueryResult();
+                task->query->Finish(QueryStatus_Cancelled);
+            }
+            else
+            {
+                task->query->Finish(QueryStatus_Done);
+            }
+
+            engine->ReleaseWorkspace(workspace);
+            delete task;
+        }
+
+    public:
+        explicit AsyncQueryEngine(const GraphType* graph) :
+            m_graph(graph),
+            m_scheduler(&PTaskScheduler::GetScheduler()) {}
+
+        AsyncQueryEngine(const GraphType* graph, PTaskScheduler* scheduler) :
+            m_graph(graph),
+            m_scheduler(scheduler) {}
+
+        ~AsyncQueryEngine()
+        {
+            WaitAll();
+            for(size_t workspaceIt = 0; workspaceIt < m_freeWorkspaces.size(); ++workspaceIt)
+                delete m_freeWorkspaces[workspaceIt];
+        }
+
+        // Blocks until every submitted query has finished
+        void WaitAll() { m_scheduler->Wait(m_tasks); }
+
+        // Queries with an id outside of the graph are done right away and
+        // find no path
+        PathFuture ShortestPath(int source, int destination)
+        {
+            PathState query(new QueryState<PathQueryResult>());
+            if(!IsValidNode(source) || !IsValidNode(destination))
+            {
+                query->Finish(QueryStatus_Done);
+                return PathFuture(query);
+            }
+
+            PathGroup* newGroup = NULL;
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                typename std::map<int, PathGroup*>::iterator groupIt = m_pendingPaths.find(source);
+                PathGroup* group = NULL;
+                if(groupIt != m_pendingPaths.end())
+                {
+                    group = groupIt->second;
+                }
+                else
+                {
+                    newGroup = group = new PathGroup();
+                    group->engine = this;
+                    group->source = source;
+                    m_pendingPaths[source] = group;
+                }
+                group->destinations.push_back(destination);
+                group->queries.push_back(query);
+            }
+
+            if(newGroup)
+                m_scheduler->Spawn(m_tasks, RunPathGroup, newGroup);
+            return PathFuture(query);
+        }
+
+        // BFS hop distance from source to every node, -1 for unreachable
+        // nodes. Nothing is reachable from a source outside of the graph
+        DistancesFuture Distances(int source)
+        {
+            if(!IsValidNode(source))
+            {
+                DistancesState query(new QueryState< std::vector<int> >());
+                query->result.assign(m_graph->GetNrNodes(), -1);
+                query->Finish(QueryStatus_Done);
+                return DistancesFuture(query);
+            }
+
+            DistancesTask* task = new DistancesTask();
+            task->engine = this;
+            task->source = source;
+            task->query.reset(new QueryState< std::vector<int> >());
+            DistancesFuture future(task->query);
+            m_scheduler->Spawn(m_tasks, RunDistances, task);
+            return future;
+        }
+
+        ComponentsFuture Components()
+        {
+            ComponentsTask* task = new ComponentsTask();
+            task->engine = this;
+            task->query.reset(new QueryState<ComponentsQueryResult>());
+            ComponentsFuture future(task->query);
+            m_scheduler->Spawn(m_tasks, RunComponents, task);
+            return future;
+        }
+    };
+
+    typedef AsyncQueryEngine<int> IntAsyncQueryEngine;
+    typedef AsyncQueryEngine<float> FloatAsyncQueryEngine;
+}
+
+#endif
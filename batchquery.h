@@ -0,0 +1,188 @@
+#ifndef KWGRAPH_BATCH_QUERY_H
+#define KWGRAPH_BATCH_QUERY_H
+
+#include <mutex>
+#include "graphview.h"
+
+namespace KWGraph
+{
+    struct PathQuery
+    {
+        PathQuery() : source(INVALID_ID), destination(INVALID_ID) {}
+        PathQuery(int source, int destination) : source(source), destination(destination) {}
+        int source;
+        int destination;
+    };
+
+    // Answers batches of shortest path queries with one BFS per distinct
+    // source instead of one per query. The sources are processed in parallel
+    // on the task scheduler and the traversal workspaces are kept between
+    // batches so a steady stream of batches doesn't allocate per BFS.
+    // GraphType can also be a GraphView, a hidden node is on no path.
+    // NOTE: The graph must not be modified while a batch is running
+    template <typename T, typename GraphType = Graph<T> >
+    class BatchQueryEngine
+    {
+    private:
+        // Stops the BFS as soon as every destination of the group was reached
+        class DestinationsVisitor : public GraphVisitor<T>
+        {
+        private:
+            const std::vector<int>* m_destinations;
+            size_t                  m_nrFound;
+        public:
+            DestinationsVisitor(int source, const std::vector<int>* destinations) :
+                GraphVisitor<T>(NULL, source),
+                m_destinations(destinations),
+                m_nrFound(0) {}
+
+            virtual NodeAction OnNodeProcess(const Node<T>& node)
+            {
+                if(std::binary_search(m_destinations->begin(), m_destinations->end(), node.id))
+                {
+                    if(++m_nrFound == m_destinations->size())
+                        return NodeAction_Abort;
+                }
+                return NodeAction_Continue;
+            }
+        };
+
+        struct SourceGroup
+        {
+            // Range in m_queryOrder with the queries of this source
+            int begin;
+            int end;
+        };
+
+        const GraphType*                    m_graph;
+        std::mutex                          m_workspaceLock;
+        std::vector<TraversalWorkspace*>    m_freeWorkspaces;
+        // Per batch state, sorted by source
+        std::vector< std::pair<int, int> >  m_queryOrder;
+        std::vector<SourceGroup>            m_groups;
+        const std::vector<PathQuery>*       m_queries;
+        std::vector<PathQueryResult>*       m_results;
+
+        BatchQueryEngine(const BatchQueryEngine&);
+        BatchQueryEngine& operator=(const BatchQueryEngine&);
+
+        TraversalWorkspace* AcquireWorkspace()
+        {
+            std::lock_guard<std::mutex> guard(m_workspaceLock);
+            if(m_freeWorkspaces.empty())
+                return new TraversalWorkspace();
+            TraversalWorkspace* workspace = m_freeWorkspaces.back();
+            m_freeWorkspaces.pop_back();
+            return workspace;
+        }
+
+        void ReleaseWorkspace(TraversalWorkspace* workspace)
+        {
+            std::lock_guard<std::mutex> guard(m_workspaceLock);
+            m_freeWorkspaces.push_back(workspace);
+        }
+
+        void RunGroups(int begin, int end)
+        {
+            TraversalWorkspace* workspace = AcquireWorkspace();
+            std::vector<int> destinations;
+            for(int groupIt = begin; groupIt < end; ++groupIt)
+            {
+                const SourceGroup& group = m_groups[groupIt];
+                int source = m_queryOrder[group.begin].first;
+
+                destinations.clear();
+                for(int queryIt = group.begin; queryIt < group.end; ++queryIt)
+                {
+                    const PathQuery& query = (*m_queries)[m_queryOrder[queryIt].second];
+                    destinations.push_back(query.destination);
+                }
+                std::sort(destinations.begin(), destinations.end());
+                destinations.erase(std::unique(destinations.begin(), destinations.end()),
+                                   destinations.end());
+
+                DestinationsVisitor visitor(source, &destinations);
+                m_graph->BFS(&visitor, *workspace);
+
+                for(int queryIt = group.begin; queryIt < group.end; ++queryIt)
+                {
+                    int queryId = m_queryOrder[queryIt].second;
+                    PathQueryResult& result = (*m_results)[queryId];
+                    result.found = workspace->GetPath((*m_queries)[queryId].destination, result.path);
+                }
+            }
+            ReleaseWorkspace(workspace);
+        }
+
+        static void RunGroupRange(void* arg, int begin, int end)
+        {
+            static_cast<BatchQueryEngine*>(arg)->RunGroups(begin, end);
+        }
+
+    public:
+        explicit BatchQueryEngine(const GraphType* graph) :
+            m_graph(graph),
+            m_queries(NULL),
+            m_results(NULL) {}
+
+        ~BatchQueryEngine()
+        {
+            for(size_t workspaceIt = 0; workspaceIt < m_freeWorkspaces.size(); ++workspaceIt)
+                delete m_freeWorkspaces[workspaceIt];
+        }
+
+        // results[i] receives the path of queries[i], found is false when
+        // either id is outside of the graph. Not reentrant, use one engine
+        // per thread that submits batches
+        void ShortestPaths(const std::vector<PathQuery>& queries,
+                           std::vector<PathQueryResult>& results)
+        {
+            results.clear();
+            results.resize(queries.size());
+            if(queries.empty() || m_graph->GetNrNodes() == 0)
+                return;
+
+            // Queries with an id outside of the graph keep their empty
+            // result and never start a BFS
+            size_t nrNodes = m_graph->GetNrNodes();
+            m_queryOrder.clear();
+            for(size_t queryIt = 0; queryIt < queries.size(); ++queryIt)
+            {
+                const PathQuery& query = queries[queryIt];
+                if(query.source < 0 || query.destination < 0 ||
+                   (size_t)query.source >= nrNodes || (size_t)query.destination >= nrNodes)
+                    continue;
+                m_queryOrder.push_back(std::make_pair(query.source, (int)queryIt));
+            }
+            std::sort(m_queryOrder.begin(), m_queryOrder.end());
+
+            m_groups.clear();
+            for(size_t queryIt = 0; queryIt < m_queryOrder.size(); ++queryIt)
+            {
+                if(queryIt == 0 || m_queryOrder[queryIt].first != m_queryOrder[queryIt - 1].first)
+                {
+                    SourceGroup group;
+                    group.begin = queryIt;
+                    m_groups.push_back(group);
+                }
+                m_groups.back().end = queryIt + 1;
+            }
+
+            if(m_groups.empty())
+                return;
+
+            m_queries = &queries;
+            m_results = &results;
+            // Every group is a full BFS so even a single group is worth
+            // stealing, the ranges are split down to one group
+            PParallelFor(0, (int)m_groups.size(), 1, RunGroupRange, this);
+            m_queries = NULL;
+            m_results = NULL;
+        }
+    };
+
+    typedef BatchQueryEngine<int> IntBatchQueryEngine;
+    typedef BatchQueryEngine<float> FloatBatchQueryEngine;
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef KWGRAPH_BICONNECTED_H
+#define KWGRAPH_BICONNECTED_H
+
+#include "adjacency.h"
+
+namespace KWGraph
+{
+    // Result of FindBiconnectedComponents, everything in flat arrays
+    struct BiconnectedComponents
+    {
+        // Nodes whose removal disconnects their component, sorted
+        std::vector<int>                    articulationPoints;
+        // Edges whose removal disconnects their component, smaller id first
+        std::vector< std::pair<int, int> >  bridges;
+        // Edges of component i are componentEdges[edgeOffsets[i]] ..
+        // componentEdges[edgeOffsets[i + 1]]
+        std::vector<int>                    edgeOffsets;
+        std::vector< std::pair<int, int> >  componentEdges;
+        // Same layout for the nodes, articulation points show up in every
+        // component they join
+        std::vector<int>                    nodeOffsets;
+        std::vector<int>                    componentNodes;
+
+        inline int GetNrComponents() const { return edgeOffsets.empty() ? 0 : (int)edgeOffsets.size() - 1; }
+    };
+
+    namespace
+    {
+        struct BiconnectedFrame
+        {
+            int node;
+            int parent;
+            // Next slot of node in the adjacency targets
+            int nextSlot;
+        };
+    }
+
+    // Hopcroft-Tarjan with an explicit DFS stack, so the graph depth only
+    // costs heap memory. Edges are treated as undirected, see
+    // SymmetricAdjacency, which also means parallel edges count as one
+    template <typename T>
+    void FindBiconnectedComponents(const SymmetricAdjacency<T>& adjacency, BiconnectedComponents& components)
+    {
+        int nrNodes = static_cast<int>(adjacency.GetNrNodes());
+        components.articulationPoints.clear();
+        components.bridges.clear();
+        components.edgeOffsets.assign(1, 0);
+        components.componentEdges.clear();
+        components.nodeOffsets.assign(1, 0);
+        components.componentNodes.clear();
+
+        // Discovery time and the earliest discovery time reachable through
+        // the subtree plus one back edge
+        std::vector<int> discovery(nrNodes, -1);
+        std::vector<int> low(nrNodes, 0);
+        std::vector<bool> isArticulation(nrNodes, false);
+        // Last component a node was added to, to list it only once
+        std::vector<int> lastComponent(nrNodes, -1);
+        std::vector<BiconnectedFrame> stack;
+        std::vector< std::pair<int, int> > edgeStack;
+        int time = 0;
+
+        for(int rootIt = 0; rootIt < nrNodes; ++rootIt)
+        {
+            if(discovery[rootIt] != -1)
+                continue;
+            discovery[rootIt] = low[rootIt] = time++;
+            BiconnectedFrame rootFrame = { rootIt, -1, adjacency.offsets[rootIt] };
+            stack.push_back(rootFrame);
+            int nrRootChildren = 0;
+
+            while(!stack.empty())
+            {
+                BiconnectedFrame& frame = stack.back();
+                int crNodeId = frame.node;
+                if(frame.nextSlot < adjacency.offsets[crNodeId + 1])
+                {
+                    int neighbor = adjacency.targets[frame.nextSlot++];
+                    if(neighbor == frame.parent)
+                        continue;
+                    if(discovery[neighbor] == -1)
+                    {
+                        edgeStack.push_back(std::make_pair(crNodeId, neighbor));
+                        discovery[neighbor] = low[neighbor] = time++;
+                        if(crNodeId == rootIt)
+                            ++nrRootChildren;
+                        // frame is invalidated by the push
+                        BiconnectedFrame childFrame = { neighbor, crNodeId, adjacency.offsets[neighbor] };
+                        stack.push_back(childFrame);
+                    }
+                    else if(discovery[neighbor] < discovery[crNodeId])
+                    {
+                        edgeStack.push_back(std::make_pair(crNodeId, neighbor));
+                        low[crNodeId] = std::min(low[crNodeId], discovery[neighbor]);
+                    }
+                    continue;
+                }
+
+                int parent = frame.parent;
+                stack.pop_back();
+                if(parent == -1)
+                    continue;
+
+                low[parent] = std::min(low[parent], low[crNodeId]);
+                if(low[crNodeId] > discovery[parent])
+                    components.bridges.push_back(std::make_pair(std::min(parent, crNodeId), std::max(parent, crNodeId)));
+                if(low[crNodeId] < discovery[parent])
+                    continue;
+
+                // parent separates the subtree of crNodeId, the edges pushed
+                // since (parent, crNodeId) make up one component
+                if(parent != rootIt)
+                    isArticulation[parent] = true;
+                int componentId = components.GetNrComponents();
+                std::pair<int, int> edge;
+                do
+                {
+                    edge = edgeStack.back();
+                    edgeStack.pop_back();
+                    components.componentEdges.push_back(edge);
+                    for(int endIt = 0; endIt < 2; ++endIt)
+                    {
+                        int nodeId = endIt ? edge.second : edge.first;
+                        if(lastComponent[nodeId] == componentId)
+                            continue;
+                        lastComponent[nodeId] = componentId;
+                        components.componentNodes.push_back(nodeId);
+                    }
+                }
+                while(edge.first != parent || edge.second != crNodeId);
+                components.edgeOffsets.push_back((int)components.componentEdges.size());
+                components.nodeOffsets.push_back((int)components.componentNodes.size());
+            }
+
+            if(nrRootChildren > 1)
+                isArticulation[rootIt] = true;
+        }
+
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+        {
+            if(isArticulation[nodeIt])
+                components.articulationPoints.push_back(nodeIt);
+        }
+    }
+
+    template <typename T>
+    void FindBiconnectedComponents(const Graph<T>& graph, BiconnectedComponents& components)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        FindBiconnectedComponents(adjacency, components);
+    }
+
+    template <typename T>
+    void FindBiconnectedComponents(const GraphView<T>& graph, BiconnectedComponents& components)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        FindBiconnectedComponents(adjacency, components);
+    }
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include <memory>
+#include <thread>
+#include "binarylogger.h"
+
+namespace {
+std::unique_ptr<BinaryLogger> binaryLoggerInstance;
+
+uint64_t alignRecordSize(uint64_t size) {
+	return (size + 7) & ~uint64_t(7);
+}
+}
+
+BinaryLogger::BinaryLogger() :
+	m_writeOffset(0),
+	m_droppedRecords(0),
+	m_currentLevel(LogLevel_Debug),
+	m_isOpen(false),
+	m_nrWriters(0) {
+	m_file.data = NULL;
+	m_file.size = 0;
+	m_file.handle = -1;
+	memset(m_formatLevels, 0, sizeof(m_formatLevels));
+}
+
+BinaryLogger::~BinaryLogger() {
+	close();
+}
+
+BinaryLogger& BinaryLogger::getBinaryLogger() {
+	static std::once_flag instanceFlag;
+	std::call_once(instanceFlag, []() { binaryLoggerInstance.reset(new BinaryLogger()); });
+	return *binaryLoggerInstance.get();
+}
+
+bool BinaryLogger::open(const char* path, size_t capacity) {
+	std::lock_guard<std::mutex> lock(m_formatLock);
+	if(m_isOpen)
+		return false;
+
+	if(capacity < sizeof(BinaryLogFileHeader))
+		capacity = sizeof(BinaryLogFileHeader);
+	if(PMapFile(path, capacity, m_file) != 0)
+		return false;
+
+	BinaryLogFileHeader* header = static_cast<BinaryLogFileHeader*>(m_file.data);
+	memcpy(header->magic, BINARY_LOG_MAGIC, sizeof(header->magic));
+	header->capacity = capacity;
+	m_writeOffset.store(sizeof(BinaryLogFileHeader), std::memory_order_relaxed);
+	m_isOpen.store(true);
+
+	for(size_t formatIt = 0; formatIt < m_formats.size(); ++formatIt)
+		writeFormat(static_cast<int>(formatIt));
+	return true;
+}
+
+void BinaryLogger::close() {
+	std::lock_guard<std::mutex> lock(m_formatLock);
+	if(!m_isOpen.load())
+		return;
+
+	// New writers see the file closed from here on, the ones that already
+	// reserved space may still be copying into the mapping
+	m_isOpen.store(false);
+	while(m_nrWriters.load(std::memory_order_acquire) != 0)
+		std::this_thread::yield();
+	uint64_t usedSize = m_writeOffset.load(std::memory_order_acquire);
+	if(usedSize > m_file.size)
+		usedSize = m_file.size;
+	PUnmapFile(m_file, usedSize);
+}
+
+char* BinaryLogger::beginWrite(uint64_t size) {
+	m_nrWriters.fetch_add(1);
+	if(!m_isOpen.load()) {
+		m_nrWriters.fetch_sub(1, std::memory_order_release);
+		m_droppedRecords.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	uint64_t offset = m_writeOffset.fetch_add(size, std::memory_order_relaxed);
+	if(offset + size > m_file.size) {
+		m_nrWriters.fetch_sub(1, std::memory_order_release);
+		m_droppedRecords.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+	return static_cast<char*>(m_file.data) + offset;
+}
+
+void BinaryLogger::writeFormat(int formatId) {
+	const FormatDescriptor& descriptor = m_formats[formatId];
+	uint64_t length = alignRecordSize(descriptor.format.size() + 1);
+	char* record = beginWrite(sizeof(BinaryLogFormatRecord) + length);
+	if(record == NULL) {
+		Logger::getLogger().error("Binary log is full, format records are being dropped\n");
+		return;
+	}
+
+	BinaryLogFormatRecord* formatRecord = reinterpret_cast<BinaryLogFormatRecord*>(record);
+	formatRecord->level = static_cast<uint16_t>(descriptor.level);
+	formatRecord->formatId = static_cast<uint32_t>(formatId);
+	formatRecord->length = length;
+	memcpy(formatRecord + 1, descriptor.format.c_str(), descriptor.format.size() + 1);
+	reinterpret_cast<std::atomic<uint16_t>*>(&formatRecord->kind)->store(
+		BinaryLogRecordKind_Format, std::memory_order_release);
+	endWrite();
+}
+
+int BinaryLogger::registerFormat(LogLevel level, const char* format) {
+	std::lock_guard<std::mutex> lock(m_formatLock);
+	if(m_formats.size() >= static_cast<size_t>(m_maxFormats)) {
+		Logger::getLogger().error("Too many binary log formats registered\n");
+		return -1;
+	}
+
+	int formatId = static_cast<int>(m_formats.size());
+	FormatDescriptor descriptor;
+	descriptor.format = format;
+	descriptor.level = level;
+	m_formats.push_back(descriptor);
+	m_formatLevels[formatId] = static_cast<unsigned char>(level);
+
+	if(m_isOpen.load())
+		writeFormat(formatId);
+	return formatId;
+}
@@ -0,0 +1,158 @@
+#ifndef BINARY_LOGGER_H
+#define BINARY_LOGGER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+#include "logger.h"
+#include "platforms/platform.h"
+
+// The binary log is a memory mapped file made out of 8 byte aligned records.
+// Every call site registers its printf style format once, which is written to
+// the file as a format record. After that each event only stores the format id,
+// a timestamp and its raw arguments, the text is rendered later by logdecoder.
+// Arguments are stored in 8 byte slots, integers are widened to 64 bits and
+// floating point values to double. The decoder picks the type of each slot
+// from the conversion specifier in the format and ignores length modifiers.
+// Strings and pointers can't be logged since they mean nothing outside of the
+// process that wrote them. A '*' width or precision takes its own int slot
+// like printf does.
+// log can be called from any thread, also while another one calls close:
+// close waits for the writers that already got space in the file before it
+// unmaps it, the ones that come later drop their record.
+
+static const char BINARY_LOG_MAGIC[8] = {'K', 'W', 'B', 'L', 'O', 'G', '0', '1'};
+
+enum BinaryLogRecordKind {
+	BinaryLogRecordKind_None = 0,
+	BinaryLogRecordKind_Format = 1,
+	BinaryLogRecordKind_Event = 2
+};
+
+struct BinaryLogFileHeader {
+	char     magic[8];
+	uint64_t capacity;
+};
+
+// kind is written last so a reader never sees a half written record
+struct BinaryLogFormatRecord {
+	uint16_t kind;
+	uint16_t level;
+	uint32_t formatId;
+	// Length of the format including the terminator, padded to 8 bytes
+	uint64_t length;
+};
+
+struct BinaryLogEventRecord {
+	uint16_t kind;
+	uint16_t nrArgs;
+	uint32_t formatId;
+	uint64_t timestamp;
+};
+
+class BinaryLogger {
+private:
+	static const int m_maxFormats = 4096;
+
+	struct FormatDescriptor {
+		std::string format;
+		LogLevel    level;
+	};
+
+	PMappedFile                 m_file;
+	std::atomic<uint64_t>       m_writeOffset;
+	std::atomic<uint64_t>       m_droppedRecords;
+	std::mutex                  m_formatLock;
+	std::vector<FormatDescriptor> m_formats;
+	unsigned char               m_formatLevels[m_maxFormats];
+	LogLevel                    m_currentLevel;
+	// Writers bump m_nrWriters before they look at m_isOpen and close clears
+	// m_isOpen before it waits for m_nrWriters to drain. Both sides need a
+	// store followed by a load of the other variable to be seen in order, so
+	// these two use the default sequentially consistent ordering
+	std::atomic<bool>           m_isOpen;
+	std::atomic<int>            m_nrWriters;
+
+	// Returns space for a record of the given size or NULL if the record is
+	// dropped. Every non NULL result must be followed by endWrite once the
+	// record is complete
+	char* beginWrite(uint64_t size);
+	void endWrite() { m_nrWriters.fetch_sub(1, std::memory_order_release); }
+	void writeFormat(int formatId);
+
+	template <typename Arg>
+	static uint64_t packArg(Arg arg, std::true_type /*isFloat*/) {
+		double value = static_cast<double>(arg);
+		uint64_t slot;
+		memcpy(&slot, &value, sizeof(slot));
+		return slot;
+	}
+
+	template <typename Arg>
+	static uint64_t packArg(Arg arg, std::false_type /*isFloat*/) {
+		return static_cast<uint64_t>(static_cast<int64_t>(arg));
+	}
+
+	static void packArgs(uint64_t* /*slots*/) {}
+
+	template <typename Arg, typename... Args>
+	static void packArgs(uint64_t* slots, Arg arg, Args... args) {
+		*slots = packArg(arg, typename std::is_floating_point<Arg>::type());
+		packArgs(slots + 1, args...);
+	}
+
+public:
+	BinaryLogger();
+	~BinaryLogger();
+	static BinaryLogger& getBinaryLogger();
+
+	// Maps a file of the given capacity. Formats registered before the call
+	// are written at the start of the file. Returns false on failure, in which
+	// case every event is dropped.
+	bool open(const char* path, size_t capacity);
+	// Waits for the records being written to finish, then unmaps the file
+	void close();
+	// Registers a call site format and returns its id, meant to be called
+	// once per call site, see KW_BINARY_LOG
+	int registerFormat(LogLevel level, const char* format);
+	void setLoggingLevel(LogLevel level) { m_currentLevel = level; }
+	// Events that didn't fit in the file or were logged while it was closed
+	uint64_t getDroppedRecords() const { return m_droppedRecords.load(std::memory_order_relaxed); }
+
+	template <typename... Args>
+	void log(int formatId, Args... args) {
+		// Same filter as Logger, only levels above the current one are kept
+		if(formatId < 0 || m_formatLevels[formatId] <= m_currentLevel)
+			return;
+
+		const uint64_t nrArgs = sizeof...(Args);
+		const uint64_t recordSize = sizeof(BinaryLogEventRecord) + nrArgs * sizeof(uint64_t);
+		char* record = beginWrite(recordSize);
+		if(record == NULL)
+			return;
+
+		BinaryLogEventRecord* event = reinterpret_cast<BinaryLogEventRecord*>(record);
+		event->nrArgs = static_cast<uint16_t>(nrArgs);
+		event->formatId = static_cast<uint32_t>(formatId);
+		event->timestamp = PGetTimestamp();
+		packArgs(reinterpret_cast<uint64_t*>(event + 1), args...);
+		reinterpret_cast<std::atomic<uint16_t>*>(&event->kind)->store(
+			BinaryLogRecordKind_Event, std::memory_order_release);
+		endWrite();
+	}
+};
+
+// Registers the format the first time the call site is reached and records
+// the raw arguments on every call
+#define KW_BINARY_LOG(level, format, ...)                                      \
+	do {                                                                       \
+		static const int kwBinaryLogFormatId =                                 \
+			BinaryLogger::getBinaryLogger().registerFormat(level, format);     \
+		BinaryLogger::getBinaryLogger().log(kwBinaryLogFormatId, ##__VA_ARGS__); \
+	} while(0)
+
+#endif // BINARY_LOGGER_H
@@ -0,0 +1,340 @@
+#ifndef KWGRAPH_CENTRALITY_H
+#define KWGRAPH_CENTRALITY_H
+
+#include <mutex>
+#include <random>
+#include "graphview.h"
+
+namespace KWGraph
+{
+    // Betweenness centrality with Brandes' algorithm: one shortest path
+    // search per source counts the shortest paths to every node, then the
+    // nodes are walked back in reverse settle order to add up how much of
+    // each source's paths go through them. Edges are followed the way the
+    // graph stores them, so a pair connected both ways is counted once from
+    // each end, halve the scores to get the usual undirected values.
+    //
+    // Sources run in parallel on the task scheduler. Every task takes a
+    // workspace from a pool, with its own score accumulator, and the
+    // accumulators are summed at the end. The pool is kept between calls so
+    // a source costs no allocation once the workspaces have grown.
+    // GraphType can also be a GraphView, the searches then only see the
+    // visible nodes and edges.
+    // NOTE: The graph must not be modified while a computation is running
+    template <typename T, typename GraphType = Graph<T> >
+    class BetweennessEngine
+    {
+    private:
+        struct Workspace
+        {
+            // Visited stamps, hop distances and the settle order (queue)
+            TraversalWorkspace      traversal;
+            std::vector<double>     pathCounts;
+            std::vector<double>     dependencies;
+            // Only used by the weighted search
+            std::vector<T>          distances;
+            std::vector<unsigned int> settled;
+            std::vector< std::pair<T, int> > heap;
+            // Scores gathered by the sources this workspace ran
+            std::vector<double>     scores;
+        };
+
+        const GraphType*        m_graph;
+        bool                    m_isWeighted;
+        std::mutex              m_workspaceLock;
+        std::vector<Workspace*> m_freeWorkspaces;
+        std::vector<Workspace*> m_workspaces;
+        // Per call state
+        std::vector<int>        m_sources;
+
+        BetweennessEngine(const BetweennessEngine&);
+        BetweennessEngine& operator=(const BetweennessEngine&);
+
+        Workspace* AcquireWorkspace()
+        {
+            std::lock_guard<std::mutex> guard(m_workspaceLock);
+            if(m_freeWorkspaces.empty())
+            {
+                m_workspaces.push_back(new Workspace());
+                return m_workspaces.back();
+            }
+            Workspace* workspace = m_freeWorkspaces.back();
+            m_freeWorkspaces.pop_back();
+            return workspace;
+        }
+
+        void ReleaseWorkspace(Workspace* workspace)
+        {
+            std::lock_guard<std::mutex> guard(m_workspaceLock);
+            m_freeWorkspaces.push_back(workspace);
+        }
+
+        // Fills the settle order and path counts, hop distances are kept in
+        // the traversal workspace
+        void CountHopPaths(Workspace& workspace, int source)
+        {
+            TraversalWorkspace& traversal = workspace.traversal;
+            traversal.Visit(source, ROOT_ID, 0);
+            traversal.queue.push_back(source);
+            workspace.pathCounts[source] = 1.0;
+            for(size_t queueIt = 0; queueIt < traversal.queue.size(); ++queueIt)
+            {
+                int crNodeId = traversal.queue[queueIt];
+                int nextDistance = traversal.distances[crNodeId] + 1;
+                NeighborRange<T> neighbors = m_graph->Neighbors(crNodeId);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    int neighbor = edgeIt.GetDestination();
+                    if(!traversal.IsVisited(neighbor))
+                    {
+                        traversal.Visit(neighbor, crNodeId, nextDistance);
+                        traversal.queue.push_back(neighbor);
+                        workspace.pathCounts[neighbor] = 0.0;
+                    }
+                    if(traversal.distances[neighbor] == nextDistance)
+                        workspace.pathCounts[neighbor] += workspace.pathCounts[crNodeId];
+                }
+            }
+        }
+
+        // Dijkstra version of CountHopPaths, weights have to be positive
+        void CountWeightedPaths(Workspace& workspace, int source)
+        {
+            TraversalWorkspace& traversal = workspace.traversal;
+            std::greater< std::pair<T, int> > isFarther;
+            workspace.heap.clear();
+            traversal.Visit(source, ROOT_ID, 0);
+            workspace.distances[source] = T(0);
+            workspace.pathCounts[source] = 1.0;
+            workspace.heap.push_back(std::make_pair(T(0), source));
+            while(!workspace.heap.empty())
+            {
+                std::pop_heap(workspace.heap.begin(), workspace.heap.end(), isFarther);
+                std::pair<T, int> top = workspace.heap.back();
+                workspace.heap.pop_back();
+                int crNodeId = top.second;
+                if(workspace.settled[crNodeId] == traversal.visitStamp ||
+                   workspace.distances[crNodeId] < top.first)
+                    continue;
+                workspace.settled[crNodeId] = traversal.visitStamp;
+                traversal.queue.push_back(crNodeId);
+
+                NeighborRange<T> neighbors = m_graph->Neighbors(crNodeId);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    NeighborView<T> edge = *edgeIt;
+                    T distance = workspace.distances[crNodeId] + edge.weight;
+                    if(!traversal.IsVisited(edge.destination) || distance < workspace.distances[edge.destination])
+                    {
+                        traversal.Visit(edge.destination, crNodeId, 0);
+                        workspace.distances[edge.destination] = distance;
+                        workspace.pathCounts[edge.destination] = workspace.pathCounts[crNodeId];
+                        workspace.heap.push_back(std::make_pair(distance, edge.destination));
+                        std::push_heap(workspace.heap.begin(), workspace.heap.end(), isFarther);
+                    }
+                    else if(!(workspace.distances[edge.destination] < distance))
+                        workspace.pathCounts[edge.destination] += workspace.pathCounts[crNodeId];
+                }
+            }
+        }
+
+        inline bool IsOnShortestPath(const Workspace& workspace, int node, const NeighborView<T>& edge) const
+        {
+            const TraversalWorkspace& traversal = workspace.traversal;
+            if(!m_isWeighted)
+                return traversal.distances[edge.destination] == traversal.distances[node] + 1;
+            T distance = workspace.distances[node] + edge.weight;
+            return workspace.settled[edge.destination] == traversal.visitStamp &&
+                   !(workspace.distances[edge.destination] < distance) &&
+                   !(distance < workspace.distances[edge.destination]);
+        }
+
+        void AccumulateSource(Workspace& workspace, int source)
+        {
+            TraversalWorkspace& traversal = workspace.traversal;
+            traversal.Reset(m_graph->GetNrNodes());
+            if(m_isWeighted)
+            {
+                // The settled stamps follow the traversal ones, which start
+                // over at 1 after a resize or a wrap around
+                if(traversal.visitStamp == 1 || workspace.settled.size() != traversal.visited.size())
+                    workspace.settled.assign(traversal.visited.size(), 0);
+                CountWeightedPaths(workspace, source);
+            }
+            else
+                CountHopPaths(workspace, source);
+
+            // Every node is done before the ones it is reached from
+            for(size_t orderIt = traversal.queue.size(); orderIt > 0; --orderIt)
+            {
+                int crNodeId = traversal.queue[orderIt - 1];
+                double dependency = 0.0;
+                NeighborRange<T> neighbors = m_graph->Neighbors(crNodeId);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    NeighborView<T> edge = *edgeIt;
+                    if(!traversal.IsVisited(edge.destination) || !IsOnShortestPath(workspace, crNodeId, edge))
+                        continue;
+                    dependency += workspace.pathCounts[crNodeId] / workspace.pathCounts[edge.destination] *
+                                  (1.0 + workspace.dependencies[edge.destination]);
+                }
+                workspace.dependencies[crNodeId] = dependency;
+                if(crNodeId != source)
+                    workspace.scores[crNodeId] += dependency;
+            }
+        }
+
+        void RunSources(int begin, int end)
+        {
+            Workspace* workspace = AcquireWorkspace();
+            size_t nrNodes = m_graph->GetNrNodes();
+            if(workspace->pathCounts.size() != nrNodes)
+            {
+                workspace->pathCounts.resize(nrNodes);
+                workspace->dependencies.resize(nrNodes);
+                workspace->distances.resize(nrNodes);
+            }
+            // Only workspaces made during this call are still empty
+            if(workspace->scores.size() != nrNodes)
+                workspace->scores.assign(nrNodes, 0.0);
+            for(int sourceIt = begin; sourceIt < end; ++sourceIt)
+                AccumulateSource(*workspace, m_sources[sourceIt]);
+            ReleaseWorkspace(workspace);
+        }
+
+        static void RunSourceRange(void* arg, int begin, int end)
+        {
+            static_cast<BetweennessEngine*>(arg)->RunSources(begin, end);
+        }
+
+        struct MergeData
+        {
+            const std::vector<Workspace*>*  workspaces;
+            std::vector<double>*            centrality;
+            double                          scale;
+        };
+
+        static void MergeScores(void* arg, int begin, int end)
+        {
+            MergeData* data = static_cast<MergeData*>(arg);
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                double score = 0.0;
+                for(size_t workspaceIt = 0; workspaceIt < data->workspaces->size(); ++workspaceIt)
+                    score += (*data->workspaces)[workspaceIt]->scores[nodeIt];
+                (*data->centrality)[nodeIt] = score * data->scale;
+            }
+        }
+
+        void Run(std::vector<double>& centrality, double scale)
+        {
+            int nrNodes = static_cast<int>(m_graph->GetNrNodes());
+            centrality.assign(nrNodes, 0.0);
+            if(nrNodes == 0 || m_sources.empty())
+                return;
+
+            for(size_t workspaceIt = 0; workspaceIt < m_workspaces.size(); ++workspaceIt)
+                m_workspaces[workspaceIt]->scores.assign(nrNodes, 0.0);
+            // Sources differ a lot in cost so keep the ranges small
+            PParallelFor(0, (int)m_sources.size(), 1, RunSourceRange, this);
+
+            MergeData data;
+            data.workspaces = &m_workspaces;
+            data.centrality = &centrality;
+            data.scale = scale;
+            PParallelFor(0, nrNodes, 0, MergeScores, &data);
+        }
+
+    public:
+        explicit BetweennessEngine(const GraphType* graph) :
+            m_graph(graph),
+            m_isWeighted(false) {}
+
+        // With isWeighted the shortest paths follow the edge weights instead
+        // of the hop count
+        BetweennessEngine(const GraphType* graph, bool isWeighted) :
+            m_graph(graph),
+            m_isWeighted(isWeighted) {}
+
+        ~BetweennessEngine()
+        {
+            for(size_t workspaceIt = 0; workspaceIt < m_workspaces.size(); ++workspaceIt)
+                delete m_workspaces[workspaceIt];
+        }
+
+        // Exact scores, one search from every node. Not reentrant
+        void Compute(std::vector<double>& centrality)
+        {
+            int nrNodes = static_cast<int>(m_graph->GetNrNodes());
+            m_sources.resize(nrNodes);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                m_sources[nodeIt] = nodeIt;
+            Run(centrality, 1.0);
+        }
+
+        // Estimate from nrSamples distinct sources picked at random, scaled by
+        // nrNodes / nrSamples so it is on the same scale as the exact scores.
+        // The same seed picks the same sources
+        void Compute(int nrSamples, unsigned int seed, std::vector<double>& centrality)
+        {
+            int nrNodes = static_cast<int>(m_graph->GetNrNodes());
+            if(nrSamples >= nrNodes)
+            {
+                Compute(centrality);
+                return;
+            }
+
+            // Partial Fisher-Yates shuffle
+            std::mt19937 generator(seed);
+            std::vector<int> candidates(nrNodes);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                candidates[nodeIt] = nodeIt;
+            m_sources.resize(std::max(nrSamples, 0));
+            for(int sampleIt = 0; sampleIt < (int)m_sources.size(); ++sampleIt)
+            {
+                std::uniform_int_distribution<int> pick(sampleIt, nrNodes - 1);
+                std::swap(candidates[sampleIt], candidates[pick(generator)]);
+                m_sources[sampleIt] = candidates[sampleIt];
+            }
+            Run(centrality, m_sources.empty() ? 0.0 : (double)nrNodes / m_sources.size());
+        }
+    };
+
+    template <typename T>
+    void BetweennessCentrality(const Graph<T>& graph, std::vector<double>& centrality)
+    {
+        BetweennessEngine<T> engine(&graph);
+        engine.Compute(centrality);
+    }
+
+    template <typename T>
+    void BetweennessCentrality(const GraphView<T>& graph, std::vector<double>& centrality)
+    {
+        BetweennessEngine< T, GraphView<T> > engine(&graph);
+        engine.Compute(centrality);
+    }
+
+    template <typename T>
+    void BetweennessCentrality(const Graph<T>& graph, int nrSamples, unsigned int seed,
+                               std::vector<double>& centrality)
+    {
+        BetweennessEngine<T> engine(&graph);
+        engine.Compute(nrSamples, seed, centrality);
+    }
+
+    template <typename T>
+    void BetweennessCentrality(const GraphView<T>& graph, int nrSamples, unsigned int seed,
+                               std::vector<double>& centrality)
+    {
+        BetweennessEngine< T, GraphView<T> > engine(&graph);
+        engine.Compute(nrSamples, seed, centrality);
+    }
+
+    typedef BetweennessEngine<int> IntBetweennessEngine;
+    typedef BetweennessEngine<float> FloatBetweennessEngine;
+}
+
+#endif
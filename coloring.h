@@ -0,0 +1,169 @@
+#ifndef KWGRAPH_COLORING_H
+#define KWGRAPH_COLORING_H
+
+#include <atomic>
+#include "adjacency.h"
+
+namespace KWGraph
+{
+    // Speculative parallel greedy coloring (Gebremedhin and Manne). The nodes
+    // waiting for a color are colored in parallel, each taking the smallest
+    // color none of its neighbors has right now. Neighbors colored at the
+    // same time can end up with the same color, so a second parallel pass
+    // looks for such conflicts and queues the lower ranked node of each pair
+    // for the next round. Nodes are ranked by degree, largest first, which
+    // tends to need fewer colors. Edges are treated as undirected, see
+    // SymmetricAdjacency, and no two neighbors share a color in the result.
+
+    namespace
+    {
+        template <typename T>
+        struct ColoringData
+        {
+            const SymmetricAdjacency<T>*    adjacency;
+            std::vector< std::atomic<int> >* colors;
+            // Position of every node in the degree order
+            const std::vector<int>*         ranks;
+            const std::vector<int>*         worklist;
+            std::vector<unsigned char>*     isConflicted;
+        };
+
+        template <typename T>
+        static void ColorNodes(void* userData, int begin, int end)
+        {
+            ColoringData<T>* data = static_cast<ColoringData<T>*>(userData);
+            const SymmetricAdjacency<T>& adjacency = *data->adjacency;
+            std::vector< std::atomic<int> >& colors = *data->colors;
+            // forbidden[c] holds the last node that saw a neighbor with color
+            // c, this way it never needs clearing
+            std::vector<int> forbidden;
+            for(int workIt = begin; workIt < end; ++workIt)
+            {
+                int nodeId = (*data->worklist)[workIt];
+                const int* neighbors = adjacency.GetNeighbors(nodeId);
+                int degree = adjacency.GetDegree(nodeId);
+                if(forbidden.size() < (size_t)degree + 1)
+                    forbidden.resize(degree + 1, -1);
+
+                for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+                {
+                    int color = colors[neighbors[neighborIt]].load(std::memory_order_relaxed);
+                    // A node never needs a color above its degree
+                    if(color >= 0 && color <= degree)
+                        forbidden[color] = nodeId;
+                }
+                int color = 0;
+                while(forbidden[color] == nodeId)
+                    ++color;
+                colors[nodeId].store(color, std::memory_order_relaxed);
+            }
+        }
+
+        template <typename T>
+        static void FindConflicts(void* userData, int begin, int end)
+        {
+            ColoringData<T>* data = static_cast<ColoringData<T>*>(userData);
+            const SymmetricAdjacency<T>& adjacency = *data->adjacency;
+            std::vector< std::atomic<int> >& colors = *data->colors;
+            const std::vector<int>& ranks = *data->ranks;
+            for(int workIt = begin; workIt < end; ++workIt)
+            {
+                int nodeId = (*data->worklist)[workIt];
+                const int* neighbors = adjacency.GetNeighbors(nodeId);
+                int degree = adjacency.GetDegree(nodeId);
+                int color = colors[nodeId].load(std::memory_order_relaxed);
+                unsigned char isConflicted = 0;
+                for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+                {
+                    int neighbor = neighbors[neighborIt];
+                    if(colors[neighbor].load(std::memory_order_relaxed) == color && ranks[neighbor] < ranks[nodeId])
+                    {
+                        isConflicted = 1;
+                        break;
+                    }
+                }
+                (*data->isConflicted)[workIt] = isConflicted;
+            }
+        }
+    }
+
+    // Stores a color in [0, nrColors) for every node and returns nrColors
+    template <typename T>
+    int ColorGraph(const SymmetricAdjacency<T>& adjacency, std::vector<int>& colors)
+    {
+        int nrNodes = static_cast<int>(adjacency.GetNrNodes());
+        colors.resize(nrNodes);
+        if(nrNodes == 0)
+            return 0;
+
+        // Counting sort by degree, largest first
+        int maxDegree = 0;
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            maxDegree = std::max(maxDegree, adjacency.GetDegree(nodeIt));
+        std::vector<int> degreeStart(maxDegree + 2, 0);
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            ++degreeStart[maxDegree - adjacency.GetDegree(nodeIt) + 1];
+        for(int degreeIt = 0; degreeIt <= maxDegree; ++degreeIt)
+            degreeStart[degreeIt + 1] += degreeStart[degreeIt];
+        std::vector<int> worklist(nrNodes);
+        std::vector<int> ranks(nrNodes);
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+        {
+            int rank = degreeStart[maxDegree - adjacency.GetDegree(nodeIt)]++;
+            ranks[nodeIt] = rank;
+            worklist[rank] = nodeIt;
+        }
+
+        std::vector< std::atomic<int> > nodeColors(nrNodes);
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            nodeColors[nodeIt].store(-1, std::memory_order_relaxed);
+        std::vector<unsigned char> isConflicted(nrNodes);
+
+        ColoringData<T> data;
+        data.adjacency = &adjacency;
+        data.colors = &nodeColors;
+        data.ranks = &ranks;
+        data.worklist = &worklist;
+        data.isConflicted = &isConflicted;
+        while(!worklist.empty())
+        {
+            int nrWork = static_cast<int>(worklist.size());
+            PParallelFor(0, nrWork, 0, ColorNodes<T>, &data);
+            PParallelFor(0, nrWork, 0, FindConflicts<T>, &data);
+
+            int nrConflicted = 0;
+            for(int workIt = 0; workIt < nrWork; ++workIt)
+            {
+                if(isConflicted[workIt])
+                    worklist[nrConflicted++] = worklist[workIt];
+            }
+            worklist.resize(nrConflicted);
+        }
+
+        int nrColors = 0;
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+        {
+            colors[nodeIt] = nodeColors[nodeIt].load(std::memory_order_relaxed);
+            nrColors = std::max(nrColors, colors[nodeIt] + 1);
+        }
+        return nrColors;
+    }
+
+    template <typename T>
+    int ColorGraph(const Graph<T>& graph, std::vector<int>& colors)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        return ColorGraph(adjacency, colors);
+    }
+
+    template <typename T>
+    int ColorGraph(const GraphView<T>& graph, std::vector<int>& colors)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        return ColorGraph(adjacency, colors);
+    }
+}
+
+#endif
@@ -0,0 +1,499 @@
+#ifndef KWGRAPH_COMMUNITY_H
+#define KWGRAPH_COMMUNITY_H
+
+#include <atomic>
+#include "adjacency.h"
+
+namespace KWGraph
+{
+    // Community detection treats the graph as undirected and weighted, see
+    // SymmetricAdjacency. Both algorithms return one community id per node,
+    // numbered from 0 with no holes.
+
+    namespace
+    {
+        // Renumbers the ids to 0..k-1 in order of first appearance and
+        // returns k
+        static int CompactIds(std::vector<int>& ids)
+        {
+            std::vector<int> newIds(ids.size(), -1);
+            int nrIds = 0;
+            for(size_t idIt = 0; idIt < ids.size(); ++idIt)
+            {
+                int& newId = newIds[ids[idIt]];
+                if(newId == -1)
+                    newId = nrIds++;
+                ids[idIt] = newId;
+            }
+            return nrIds;
+        }
+
+        // Adds up the weight of (id, weight) pairs with the same id, the
+        // pairs end up sorted by id
+        static void MergeWeights(std::vector< std::pair<int, double> >& weights)
+        {
+            if(weights.empty())
+                return;
+            std::sort(weights.begin(), weights.end());
+            size_t nrMerged = 0;
+            for(size_t weightIt = 1; weightIt < weights.size(); ++weightIt)
+            {
+                if(weights[weightIt].first == weights[nrMerged].first)
+                    weights[nrMerged].second += weights[weightIt].second;
+                else
+                    weights[++nrMerged] = weights[weightIt];
+            }
+            weights.resize(nrMerged + 1);
+        }
+
+        template <typename T>
+        struct LabelPropagationData
+        {
+            const SymmetricAdjacency<T>*    adjacency;
+            std::vector< std::atomic<int> >* labels;
+            std::atomic<int>*               nrChanged;
+        };
+
+        // Every node takes the label with the most edge weight around it,
+        // ties go to the smallest label so the labels can settle. Labels are
+        // updated in place, the neighbors running at the same time may see
+        // either value
+        template <typename T>
+        static void PropagateLabels(void* userData, int begin, int end)
+        {
+            LabelPropagationData<T>* data = static_cast<LabelPropagationData<T>*>(userData);
+            const SymmetricAdjacency<T>& adjacency = *data->adjacency;
+            std::vector< std::atomic<int> >& labels = *data->labels;
+            std::vector< std::pair<int, double> > labelWeights;
+            int nrChanged = 0;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                const int* neighbors = adjacency.GetNeighbors(nodeIt);
+                const T* weights = adjacency.GetWeights(nodeIt);
+                int degree = adjacency.GetDegree(nodeIt);
+                if(degree == 0)
+                    continue;
+
+                labelWeights.clear();
+                for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+                {
+                    int label = labels[neighbors[neighborIt]].load(std::memory_order_relaxed);
+                    labelWeights.push_back(std::make_pair(label, (double)weights[neighborIt]));
+                }
+                MergeWeights(labelWeights);
+
+                int oldLabel = labels[nodeIt].load(std::memory_order_relaxed);
+                int bestLabel = oldLabel;
+                double bestWeight = -1.0;
+                for(size_t labelIt = 0; labelIt < labelWeights.size(); ++labelIt)
+                {
+                    if(labelWeights[labelIt].second > bestWeight)
+                    {
+                        bestWeight = labelWeights[labelIt].second;
+                        bestLabel = labelWeights[labelIt].first;
+                    }
+                }
+                if(bestLabel != oldLabel)
+                {
+                    labels[nodeIt].store(bestLabel, std::memory_order_relaxed);
+                    ++nrChanged;
+                }
+            }
+            if(nrChanged)
+                data->nrChanged->fetch_add(nrChanged, std::memory_order_relaxed);
+        }
+    }
+
+    // Parallel label propagation. Stops when a round changes less than
+    // 1 / 1000 of the labels or after maxIterations rounds. Returns the
+    // number of communities
+    template <typename T>
+    int LabelPropagation(const SymmetricAdjacency<T>& adjacency, int maxIterations, std::vector<int>& communities)
+    {
+        int nrNodes = static_cast<int>(adjacency.GetNrNodes());
+        communities.resize(nrNodes);
+        if(nrNodes == 0)
+            return 0;
+
+        std::vector< std::atomic<int> > labels(nrNodes);
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            labels[nodeIt].store(nodeIt, std::memory_order_relaxed);
+
+        std::atomic<int> nrChanged(0);
+        LabelPropagationData<T> data;
+        data.adjacency = &adjacency;
+        data.labels = &labels;
+        data.nrChanged = &nrChanged;
+        for(int iterationIt = 0; iterationIt < maxIterations; ++iterationIt)
+        {
+            nrChanged.store(0);
+            PParallelFor(0, nrNodes, 0, PropagateLabels<T>, &data);
+            if(nrChanged.load() <= nrNodes / 1000)
+                break;
+        }
+
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            communities[nodeIt] = labels[nodeIt].load(std::memory_order_relaxed);
+        return CompactIds(communities);
+    }
+
+    template <typename T>
+    int LabelPropagation(const Graph<T>& graph, std::vector<int>& communities)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        return LabelPropagation(adjacency, 20, communities);
+    }
+
+    template <typename T>
+    int LabelPropagation(const GraphView<T>& graph, std::vector<int>& communities)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        return LabelPropagation(adjacency, 20, communities);
+    }
+
+    namespace
+    {
+        // One level of Louvain: the adjacency of the level graph plus the
+        // weight of the edges folded into every node by the coarsening
+        template <typename T>
+        struct LouvainLevel
+        {
+            SymmetricAdjacency<T>   adjacency;
+            std::vector<double>     loops;
+            // Sum of the weights around every node, loops count twice
+            std::vector<double>     degrees;
+            // Twice the total edge weight
+            double                  totalWeight;
+        };
+
+        template <typename T>
+        struct LocalMovingData
+        {
+            const LouvainLevel<T>*  level;
+            const std::vector<int>* communities;
+            const std::vector<double>* communityDegrees;
+            const std::vector<int>* communitySizes;
+            std::vector<int>*       nextCommunities;
+        };
+
+        // Picks the community with the best modularity gain for every node,
+        // against the communities of the previous round. The gain of moving
+        // a node out of its community and into C is
+        //   weight(node, C) - degree(node) * degree(C) / totalWeight
+        // up to a constant factor. A node alone in its community only moves
+        // to another lone node with a smaller id, otherwise pairs of lone
+        // nodes keep swapping with each other
+        template <typename T>
+        static void MoveNodes(void* userData, int begin, int end)
+        {
+            LocalMovingData<T>* data = static_cast<LocalMovingData<T>*>(userData);
+            const LouvainLevel<T>& level = *data->level;
+            const std::vector<int>& communities = *data->communities;
+            const std::vector<double>& communityDegrees = *data->communityDegrees;
+            std::vector< std::pair<int, double> > communityWeights;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                const int* neighbors = level.adjacency.GetNeighbors(nodeIt);
+                const T* weights = level.adjacency.GetWeights(nodeIt);
+                int degree = level.adjacency.GetDegree(nodeIt);
+                int community = communities[nodeIt];
+
+                communityWeights.clear();
+                communityWeights.push_back(std::make_pair(community, 0.0));
+                for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+                {
+                    communityWeights.push_back(std::make_pair(communities[neighbors[neighborIt]],
+                                                              (double)weights[neighborIt]));
+                }
+                MergeWeights(communityWeights);
+
+                double nodeDegree = level.degrees[nodeIt];
+                double scale = nodeDegree / level.totalWeight;
+                double ownWeight = std::lower_bound(communityWeights.begin(), communityWeights.end(),
+                                                    std::make_pair(community, -1.0))->second;
+                double bestGain = ownWeight - scale * (communityDegrees[community] - nodeDegree);
+                int bestCommunity = community;
+                bool isAlone = (*data->communitySizes)[community] == 1;
+                for(size_t communityIt = 0; communityIt < communityWeights.size(); ++communityIt)
+                {
+                    int candidate = communityWeights[communityIt].first;
+                    if(candidate == community)
+                        continue;
+                    if(isAlone && candidate > community && (*data->communitySizes)[candidate] == 1)
+                        continue;
+                    double gain = communityWeights[communityIt].second - scale * communityDegrees[candidate];
+                    if(gain > bestGain)
+                    {
+                        bestGain = gain;
+                        bestCommunity = candidate;
+                    }
+                }
+                (*data->nextCommunities)[nodeIt] = bestCommunity;
+            }
+        }
+
+        template <typename T>
+        static double GetModularity(const LouvainLevel<T>& level, const std::vector<int>& communities,
+                                    const std::vector<double>& internalWeights,
+                                    const std::vector<double>& communityDegrees)
+        {
+            if(level.totalWeight <= 0.0)
+                return 0.0;
+            double internalWeight = 0.0;
+            for(size_t nodeIt = 0; nodeIt < communities.size(); ++nodeIt)
+                internalWeight += internalWeights[nodeIt] + 2.0 * level.loops[nodeIt];
+            double expectedWeight = 0.0;
+            for(size_t communityIt = 0; communityIt < communityDegrees.size(); ++communityIt)
+                expectedWeight += communityDegrees[communityIt] * communityDegrees[communityIt];
+            return internalWeight / level.totalWeight - expectedWeight / (level.totalWeight * level.totalWeight);
+        }
+
+        template <typename T>
+        struct InternalWeightData
+        {
+            const LouvainLevel<T>*  level;
+            const std::vector<int>* communities;
+            std::vector<double>*    internalWeights;
+        };
+
+        template <typename T>
+        static void GetInternalWeights(void* userData, int begin, int end)
+        {
+            InternalWeightData<T>* data = static_cast<InternalWeightData<T>*>(userData);
+            const SymmetricAdjacency<T>& adjacency = data->level->adjacency;
+            const std::vector<int>& communities = *data->communities;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                const int* neighbors = adjacency.GetNeighbors(nodeIt);
+                const T* weights = adjacency.GetWeights(nodeIt);
+                int degree = adjacency.GetDegree(nodeIt);
+                double weight = 0.0;
+                for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+                {
+                    if(communities[neighbors[neighborIt]] == communities[nodeIt])
+                        weight += weights[neighborIt];
+                }
+                (*data->internalWeights)[nodeIt] = weight;
+            }
+        }
+
+        // Local moving phase: rounds of parallel moves until the modularity
+        // stops going up. Returns the modularity of the communities
+        template <typename T>
+        static double MoveToCommunities(const LouvainLevel<T>& level, std::vector<int>& communities)
+        {
+            int nrNodes = static_cast<int>(level.adjacency.GetNrNodes());
+            communities.resize(nrNodes);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                communities[nodeIt] = nodeIt;
+
+            std::vector<double> communityDegrees(level.degrees);
+            std::vector<int> communitySizes(nrNodes, 1);
+            std::vector<int> nextCommunities(nrNodes);
+            std::vector<double> internalWeights(nrNodes, 0.0);
+            double modularity = GetModularity(level, communities, internalWeights, communityDegrees);
+
+            LocalMovingData<T> data;
+            data.level = &level;
+            data.communities = &communities;
+            data.communityDegrees = &communityDegrees;
+            data.communitySizes = &communitySizes;
+            data.nextCommunities = &nextCommunities;
+
+            InternalWeightData<T> internalData;
+            internalData.level = &level;
+            internalData.communities = &nextCommunities;
+            internalData.internalWeights = &internalWeights;
+
+            std::vector<double> nextDegrees(nrNodes);
+            for(int roundIt = 0; roundIt < 100; ++roundIt)
+            {
+                PParallelFor(0, nrNodes, 0, MoveNodes<T>, &data);
+
+                std::fill(nextDegrees.begin(), nextDegrees.end(), 0.0);
+                for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                    nextDegrees[nextCommunities[nodeIt]] += level.degrees[nodeIt];
+                PParallelFor(0, nrNodes, 0, GetInternalWeights<T>, &internalData);
+                double nextModularity = GetModularity(level, nextCommunities, internalWeights, nextDegrees);
+
+                // The moves were all picked against the old communities so
+                // together they can make things worse, keep the best round
+                if(nextModularity - modularity < 1e-7)
+                    break;
+                modularity = nextModularity;
+                communities.swap(nextCommunities);
+                communityDegrees.swap(nextDegrees);
+                std::fill(communitySizes.begin(), communitySizes.end(), 0);
+                for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                    ++communitySizes[communities[nodeIt]];
+            }
+            return modularity;
+        }
+
+        template <typename T, typename GraphType>
+        static void InitLouvainLevel(const GraphType& graph, bool hasLoops, LouvainLevel<T>& level)
+        {
+            BuildSymmetricAdjacency(graph, level.adjacency);
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            level.loops.assign(nrNodes, 0.0);
+            level.degrees.resize(nrNodes);
+            level.totalWeight = 0.0;
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                if(hasLoops)
+                    level.loops[nodeIt] = graph.GetNodes()[nodeIt].weight;
+                double degree = 2.0 * level.loops[nodeIt];
+                const T* weights = level.adjacency.GetWeights(nodeIt);
+                for(int neighborIt = 0; neighborIt < level.adjacency.GetDegree(nodeIt); ++neighborIt)
+                    degree += weights[neighborIt];
+                level.degrees[nodeIt] = degree;
+                level.totalWeight += degree;
+            }
+        }
+
+        template <typename T>
+        struct CoarsenData
+        {
+            const LouvainLevel<T>*  level;
+            const std::vector<int>* communities;
+            // Members of community c are members[memberOffsets[c]] ..
+            // members[memberOffsets[c + 1]]
+            const std::vector<int>* memberOffsets;
+            const std::vector<int>* members;
+            // Edges to the communities with a larger id, and the weight
+            // inside of every community
+            std::vector< std::vector< std::pair<int, double> > >* communityEdges;
+            std::vector<double>*    communityLoops;
+        };
+
+        template <typename T>
+        static void CoarsenCommunities(void* userData, int begin, int end)
+        {
+            CoarsenData<T>* data = static_cast<CoarsenData<T>*>(userData);
+            const LouvainLevel<T>& level = *data->level;
+            const std::vector<int>& communities = *data->communities;
+            for(int communityIt = begin; communityIt < end; ++communityIt)
+            {
+                std::vector< std::pair<int, double> >& edges = (*data->communityEdges)[communityIt];
+                double loop = 0.0;
+                for(int memberIt = (*data->memberOffsets)[communityIt];
+                    memberIt < (*data->memberOffsets)[communityIt + 1]; ++memberIt)
+                {
+                    int member = (*data->members)[memberIt];
+                    loop += level.loops[member];
+                    const int* neighbors = level.adjacency.GetNeighbors(member);
+                    const T* weights = level.adjacency.GetWeights(member);
+                    for(int neighborIt = 0; neighborIt < level.adjacency.GetDegree(member); ++neighborIt)
+                    {
+                        int neighborCommunity = communities[neighbors[neighborIt]];
+                        // Edges inside the community are seen from both ends
+                        if(neighborCommunity == communityIt)
+                            loop += 0.5 * weights[neighborIt];
+                        else if(neighborCommunity > communityIt)
+                            edges.push_back(std::make_pair(neighborCommunity, (double)weights[neighborIt]));
+                    }
+                }
+                MergeWeights(edges);
+                (*data->communityLoops)[communityIt] = loop;
+            }
+        }
+
+        // Builds the graph of the next level, one node per community with
+        // the weight inside the community as the node weight and one edge
+        // per pair of connected communities with their total weight
+        template <typename T>
+        static void CoarsenGraph(const LouvainLevel<T>& level, const std::vector<int>& communities,
+                                 int nrCommunities, Graph<T>& coarseGraph)
+        {
+            int nrNodes = static_cast<int>(communities.size());
+            std::vector<int> memberOffsets(nrCommunities + 1, 0);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                ++memberOffsets[communities[nodeIt] + 1];
+            for(int communityIt = 0; communityIt < nrCommunities; ++communityIt)
+                memberOffsets[communityIt + 1] += memberOffsets[communityIt];
+            std::vector<int> members(nrNodes);
+            std::vector<int> fill(memberOffsets.begin(), memberOffsets.end() - 1);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                members[fill[communities[nodeIt]]++] = nodeIt;
+
+            std::vector< std::vector< std::pair<int, double> > > communityEdges(nrCommunities);
+            std::vector<double> communityLoops(nrCommunities);
+            CoarsenData<T> data;
+            data.level = &level;
+            data.communities = &communities;
+            data.memberOffsets = &memberOffsets;
+            data.members = &members;
+            data.communityEdges = &communityEdges;
+            data.communityLoops = &communityLoops;
+            PParallelFor(0, nrCommunities, 0, CoarsenCommunities<T>, &data);
+
+            coarseGraph = Graph<T>();
+            for(int communityIt = 0; communityIt < nrCommunities; ++communityIt)
+                coarseGraph.AddNode(T(communityLoops[communityIt]));
+            for(int communityIt = 0; communityIt < nrCommunities; ++communityIt)
+            {
+                const std::vector< std::pair<int, double> >& edges = communityEdges[communityIt];
+                for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt)
+                    coarseGraph.AddListEdge(communityIt, edges[edgeIt].first, T(edges[edgeIt].second), false);
+            }
+        }
+
+        // Only the first level runs on the caller's graph or view, the
+        // coarse levels are plain graphs
+        template <typename T, typename GraphType>
+        static double RunLouvain(const GraphType& graph, std::vector<int>& communities)
+        {
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            communities.resize(nrNodes);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                communities[nodeIt] = nodeIt;
+            if(nrNodes == 0)
+                return 0.0;
+
+            Graph<T> coarseGraph;
+            LouvainLevel<T> level;
+            InitLouvainLevel(graph, false, level);
+            std::vector<int> levelCommunities;
+            double modularity = 0.0;
+            while(true)
+            {
+                modularity = MoveToCommunities(level, levelCommunities);
+                int nrLevelNodes = static_cast<int>(levelCommunities.size());
+                int nrCommunities = CompactIds(levelCommunities);
+                for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                    communities[nodeIt] = levelCommunities[communities[nodeIt]];
+                if(nrCommunities == nrLevelNodes)
+                    break;
+
+                Graph<T> nextGraph;
+                CoarsenGraph(level, levelCommunities, nrCommunities, nextGraph);
+                std::swap(coarseGraph, nextGraph);
+                InitLouvainLevel(coarseGraph, true, level);
+            }
+            return modularity;
+        }
+    }
+
+    // Louvain modularity optimization. Every level moves nodes between
+    // communities in parallel rounds, then folds each community into a node
+    // of a new compact graph and starts over on it, until a level doesn't
+    // merge anything. Returns the modularity of the final communities.
+    // Weights should not be negative, and with integer weights the coarse
+    // graphs round the folded loop weights down to whole values
+    template <typename T>
+    double Louvain(const Graph<T>& graph, std::vector<int>& communities)
+    {
+        return RunLouvain<T>(graph, communities);
+    }
+
+    // Hidden nodes have no edges so each one ends up alone in a community
+    template <typename T>
+    double Louvain(const GraphView<T>& graph, std::vector<int>& communities)
+    {
+        return RunLouvain<T>(graph, communities);
+    }
+}
+
+#endif
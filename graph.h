@@ -12,6 +12,7 @@
 #    include <cstdio>
 #    include <cstdlib>
 #    include <ctime>
+#    include <stdint.h>
 
 #    if defined(__linux__) || defined(__APPLE__)
 #        include <sys/time.h>
@@ -42,7 +43,7 @@ namespace KWGraph
     {
         StorageType_None = 0,
         StorageType_AdjacencyList = 1 << 0,
-        StorageType_AdjacencyMatrix = 1 << 0
+        StorageType_AdjacencyMatrix = 1 << 1
     };
 
     enum DFSOrder
@@ -64,6 +65,30 @@ namespace KWGraph
     template <typename T>
     class GraphVisitor;
 
+    template <typename T>
+    class Graph;
+
+    // The traversal ranges also run over a GraphView
+    template <typename T, typename GraphType = Graph<T> >
+    class BFSNodeRange;
+
+    template <typename T, typename GraphType = Graph<T> >
+    class DFSNodeRange;
+
+    struct TraversalWorkspace;
+
+    // The visitor traversals that only read the graph, shared with GraphView
+    template <typename T, typename GraphType>
+    void VisitBFS(const GraphType& graph, int source, GraphVisitor<T>* visitor, TraversalWorkspace& workspace);
+
+    template <typename T, typename GraphType>
+    void VisitDFS(const GraphType& graph, int source, GraphVisitor<T>* visitor, DFSOrder order,
+                  TraversalWorkspace& workspace);
+
+    template <typename T, typename GraphType>
+    NodeAction VisitBFSComponent(const GraphType& graph, int source, GraphVisitor<T>* visitor,
+                                 TraversalWorkspace& workspace);
+
     template <typename T>
     struct Node
     {
@@ -119,9 +144,8 @@ namespace KWGraph
             srand(seed);
         }
         template <typename T>
-        static void* CreateGraphEdges(void* userData)
+        static void CreateNodeEdges(EdgeCreateData<T>* data)
         {
-            EdgeCreateData<T>* data = static_cast<EdgeCreateData<T>*>(userData);
             //make edges in a local copy to avoid false sharing
             std::set<int> connections;
             std::vector< Edge<T> > outEdges;
@@ -132,7 +156,7 @@ namespace KWGraph
                 if(connections.find(connectionNodeId) != connections.end())
                     continue;
                 Edge<T> newEdge;
-                newEdge.weight = T(rand()/(float)RAND_MAX) * data->weightScale;
+                newEdge.weight = T(rand() / (float)RAND_MAX * data->weightScale);
                 newEdge.destination = connectionNodeId;
                 newEdge.source = data->node->id;
                 outEdges.push_back(newEdge);
@@ -141,8 +165,335 @@ namespace KWGraph
             }
             data->edges = outEdges;
         }
+
+        // Task scheduler range function, userData points to the create data
+        // of all the nodes
+        template <typename T>
+        static void CreateGraphEdges(void* userData, int begin, int end)
+        {
+            EdgeCreateData<T>* nodeData = static_cast<EdgeCreateData<T>*>(userData);
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+                CreateNodeEdges(&nodeData[nodeIt]);
+        }
+    }
+
+    // Traversal state kept outside of the graph so several traversals can run
+    // on the same graph at once and reuse their allocations between runs
+    struct TraversalWorkspace
+    {
+        TraversalWorkspace() : visitStamp(0) {}
+
+        std::vector<int>            parents;
+        std::vector<int>            distances;
+        // A node counts as visited when its stamp matches visitStamp, this
+        // way resetting the workspace doesn't need to touch every node
+        std::vector<unsigned int>   visited;
+        std::vector<int>            queue;
+        unsigned int                visitStamp;
+
+        void Reset(size_t nrNodes)
+        {
+            if(visited.size() != nrNodes)
+            {
+                parents.resize(nrNodes);
+                distances.resize(nrNodes);
+                visited.assign(nrNodes, 0);
+                visitStamp = 0;
+            }
+            ++visitStamp;
+            if(visitStamp == 0)
+            {
+                std::fill(visited.begin(), visited.end(), 0);
+                visitStamp = 1;
+            }
+            queue.clear();
+        }
+
+        inline bool IsVisited(int id) const { return visited[id] == visitStamp; }
+        inline void Visit(int id, int parent, int distance)
+        {
+            visited[id] = visitStamp;
+            parents[id] = parent;
+            distances[id] = distance;
+        }
+        inline int GetParent(int id) const { return IsVisited(id) ? parents[id] : INVALID_ID; }
+        inline int GetDistance(int id) const { return IsVisited(id) ? distances[id] : -1; }
+
+        // Follows the parents from destination back to the traversal root and
+        // stores the path from the root to destination. Returns false if the
+        // destination wasn't reached
+        bool GetPath(int destination, std::vector<int>& path) const
+        {
+            path.clear();
+            if(!IsVisited(destination))
+                return false;
+
+            path.resize(distances[destination] + 1);
+            int crNodeId = destination;
+            for(size_t pathIt = path.size(); pathIt > 0; --pathIt)
+            {
+                path[pathIt - 1] = crNodeId;
+                crNodeId = parents[crNodeId];
+            }
+            return true;
+        }
+    };
+
+    struct PathQueryResult
+    {
+        PathQueryResult() : found(false) {}
+        // Node ids from the source to the destination, empty if there is
+        // no path
+        std::vector<int> path;
+        bool             found;
+    };
+
+    template <typename T>
+    struct NeighborView
+    {
+        int destination;
+        T   weight;
+        // Index in the edge list, INVALID_ID when the graph only has a matrix
+        int edgeId;
+    };
+
+    static inline bool IsBitSet(const uint64_t* bits, size_t index)
+    {
+        return (bits[index >> 6] >> (index & 63)) & 1;
     }
 
+    // Hides nodes and edges from a NeighborRange, see GraphView. A set bit
+    // means visible and a NULL mask hides nothing. Edges are keyed by their
+    // id in the edge list, or by their matrix index for matrix only graphs
+    template <typename T>
+    struct NeighborFilter
+    {
+        NeighborFilter() : nodeBits(NULL), edgeBits(NULL), matrix(NULL) {}
+        const uint64_t* nodeBits;
+        const uint64_t* edgeBits;
+        // First matrix entry, turns a row pointer back into matrix indices
+        const T*        matrix;
+    };
+
+    // Allocation free view over the neighbors of a node. It reads straight
+    // from the adjacency list or, for graphs that only keep a matrix, from
+    // the node's matrix row where a zero weight means there is no edge. A
+    // filter skips hidden edges, which only costs a NULL check without one
+    template <typename T>
+    class NeighborRange
+    {
+    public:
+        class Iterator
+        {
+        private:
+            // List storage walks edgeIds, matrix storage walks row
+            const int*      m_edgeIds;
+            const Edge<T>*  m_edges;
+            const T*        m_row;
+            int             m_column;
+            int             m_nrColumns;
+            const NeighborFilter<T>* m_filter;
+            // Only set with a filter, so skipping stops at the end of a list
+            const int*      m_edgeIdsEnd;
+
+            void SkipEmptyColumns()
+            {
+                while(m_column < m_nrColumns && m_row[m_column] == T(0))
+                    ++m_column;
+            }
+
+            bool IsHidden() const
+            {
+                if(m_filter->nodeBits && !IsBitSet(m_filter->nodeBits, GetDestination()))
+                    return true;
+                if(!m_filter->edgeBits)
+                    return false;
+                size_t edgeKey = m_row ? (size_t)(m_row - m_filter->matrix) + m_column : (size_t)*m_edgeIds;
+                return !IsBitSet(m_filter->edgeBits, edgeKey);
+            }
+
+            void SkipHidden()
+            {
+                if(m_row)
+                {
+                    while(m_column < m_nrColumns && IsHidden())
+                    {
+                        ++m_column;
+                        SkipEmptyColumns();
+                    }
+                }
+                else
+                {
+                    while(m_edgeIds != m_edgeIdsEnd && IsHidden())
+                        ++m_edgeIds;
+                }
+            }
+        public:
+            Iterator() : m_edgeIds(NULL), m_edges(NULL), m_row(NULL), m_column(0), m_nrColumns(0),
+                         m_filter(NULL), m_edgeIdsEnd(NULL) {}
+            Iterator(const int* edgeIds, const Edge<T>* edges) :
+                m_edgeIds(edgeIds), m_edges(edges), m_row(NULL), m_column(0), m_nrColumns(0),
+                m_filter(NULL), m_edgeIdsEnd(NULL) {}
+            Iterator(const T* row, int column, int nrColumns) :
+                m_edgeIds(NULL), m_edges(NULL), m_row(row), m_column(column), m_nrColumns(nrColumns),
+                m_filter(NULL), m_edgeIdsEnd(NULL)
+            {
+                SkipEmptyColumns();
+            }
+            Iterator(const int* edgeIds, const int* edgeIdsEnd, const Edge<T>* edges, const NeighborFilter<T>* filter) :
+                m_edgeIds(edgeIds), m_edges(edges), m_row(NULL), m_column(0), m_nrColumns(0),
+                m_filter(filter), m_edgeIdsEnd(edgeIdsEnd)
+            {
+                SkipHidden();
+            }
+            Iterator(const T* row, int column, int nrColumns, const NeighborFilter<T>* filter) :
+                m_edgeIds(NULL), m_edges(NULL), m_row(row), m_column(column), m_nrColumns(nrColumns),
+                m_filter(filter), m_edgeIdsEnd(NULL)
+            {
+                SkipEmptyColumns();
+                SkipHidden();
+            }
+
+            inline NeighborView<T> operator*() const
+            {
+                NeighborView<T> view;
+                if(m_row)
+                {
+                    view.destination = m_column;
+                    view.weight = m_row[m_column];
+                    view.edgeId = INVALID_ID;
+                }
+                else
+                {
+                    const Edge<T>& edge = m_edges[*m_edgeIds];
+                    view.destination = edge.destination;
+                    view.weight = edge.weight;
+                    view.edgeId = *m_edgeIds;
+                }
+                return view;
+            }
+
+            // Cheaper than going through the view when only the id is needed
+            inline int GetDestination() const
+            {
+                return m_row ? m_column : m_edges[*m_edgeIds].destination;
+            }
+
+            inline Iterator& operator++()
+            {
+                if(m_row)
+                {
+                    ++m_column;
+                    SkipEmptyColumns();
+                }
+                else
+                {
+                    ++m_edgeIds;
+                }
+                if(m_filter)
+                    SkipHidden();
+                return *this;
+            }
+
+            inline bool operator==(const Iterator& other) const
+            {
+                return m_edgeIds == other.m_edgeIds && m_column == other.m_column;
+            }
+            inline bool operator!=(const Iterator& other) const { return !(*this == other); }
+        };
+
+        // Empty range
+        NeighborRange() : m_size(0), m_isMatrix(false) {}
+
+        static NeighborRange FromList(const std::vector<int>& edgeIds, const Edge<T>* edges)
+        {
+            NeighborRange range;
+            const int* firstEdge = edgeIds.empty() ? NULL : &edgeIds[0];
+            range.m_begin = Iterator(firstEdge, edges);
+            range.m_end = Iterator(firstEdge + edgeIds.size(), edges);
+            range.m_size = edgeIds.size();
+            return range;
+        }
+
+        static NeighborRange FromMatrixRow(const T* row, int nrColumns)
+        {
+            NeighborRange range;
+            range.m_isMatrix = true;
+            range.m_begin = Iterator(row, 0, nrColumns);
+            range.m_end = Iterator(row, nrColumns, nrColumns);
+            range.m_size = 0;
+            for(int columnIt = 0; columnIt < nrColumns; ++columnIt)
+                range.m_size += (row[columnIt] != T(0));
+            return range;
+        }
+
+        // The filtered ranges count their visible edges when they are made
+        static NeighborRange FromList(const std::vector<int>& edgeIds, const Edge<T>* edges,
+                                      const NeighborFilter<T>* filter)
+        {
+            NeighborRange range;
+            const int* firstEdge = edgeIds.empty() ? NULL : &edgeIds[0];
+            const int* lastEdge = firstEdge + edgeIds.size();
+            range.m_begin = Iterator(firstEdge, lastEdge, edges, filter);
+            range.m_end = Iterator(lastEdge, edges);
+            range.CountVisible();
+            return range;
+        }
+
+        static NeighborRange FromMatrixRow(const T* row, int nrColumns, const NeighborFilter<T>* filter)
+        {
+            NeighborRange range;
+            range.m_isMatrix = true;
+            range.m_begin = Iterator(row, 0, nrColumns, filter);
+            range.m_end = Iterator(row, nrColumns, nrColumns);
+            range.CountVisible();
+            return range;
+        }
+
+        // Filtered ranges whose number of visible edges is already known
+        static NeighborRange FromList(const std::vector<int>& edgeIds, const Edge<T>* edges,
+                                      const NeighborFilter<T>* filter, size_t size)
+        {
+            NeighborRange range;
+            const int* firstEdge = edgeIds.empty() ? NULL : &edgeIds[0];
+            const int* lastEdge = firstEdge + edgeIds.size();
+            range.m_begin = Iterator(firstEdge, lastEdge, edges, filter);
+            range.m_end = Iterator(lastEdge, edges);
+            range.m_size = size;
+            return range;
+        }
+
+        static NeighborRange FromMatrixRow(const T* row, int nrColumns, const NeighborFilter<T>* filter, size_t size)
+        {
+            NeighborRange range;
+            range.m_isMatrix = true;
+            range.m_begin = Iterator(row, 0, nrColumns, filter);
+            range.m_end = Iterator(row, nrColumns, nrColumns);
+            range.m_size = size;
+            return range;
+        }
+
+        inline Iterator begin() const { return m_begin; }
+        inline Iterator end() const { return m_end; }
+        // O(1) for lists, matrix rows and filtered ranges are counted when
+        // the range is made unless their size was passed in
+        inline size_t size() const { return m_size; }
+        inline bool empty() const { return m_begin == m_end; }
+        inline bool IsMatrixRow() const { return m_isMatrix; }
+    private:
+        Iterator    m_begin;
+        Iterator    m_end;
+        size_t      m_size;
+        bool        m_isMatrix;
+
+        void CountVisible()
+        {
+            m_size = 0;
+            for(Iterator edgeIt = m_begin; edgeIt != m_end; ++edgeIt)
+                ++m_size;
+        }
+    };
+
     // A general purpose representation for a graph, supports adjacency matrices
     // and adjacency lists for storage
     // NOTE: Most functions are overloaded on purpose to avoid the evils of 
@@ -158,9 +509,17 @@ namespace KWGraph
         std::vector< Node<T> >  m_nodes;
         std::vector< Edge<T> >  m_edges;
         StorageType             m_storageType;
+        // Bumped by every change to the nodes or edges so caches built on top
+        // of the graph can tell when they went stale
+        unsigned int            m_version;
         
         static const int m_maxSparseConnections = 10;
-        static const float m_denseEdgeChance = 0.8f;
+        static const float m_denseEdgeChance;
+
+        static inline int GetVisitorSource(GraphVisitor<T>* visitor)
+        {
+            return (visitor && visitor->GetVisitSource() > 0) ? visitor->GetVisitSource() : 0;
+        }
 
         void InvalidateParents()
         {
@@ -184,12 +543,15 @@ namespace KWGraph
             if(!isDirected)
                 reserveSize *= 2;
             m_edges.reserve(reserveSize);
+            Invalidate();
         }
 
     public:
         typedef std::vector< Edge<T> > EdgeVector;
         typedef std::vector< Node<T> > NodeVector;
 
+        Graph() : m_storageType(StorageType_None), m_version(0) {}
+
         // We want to keep both an adjacency matrix and a adjacency list 
         // For instance this way we can compare different implementations
         // for a certain algorithm
@@ -203,6 +565,10 @@ namespace KWGraph
 
         inline size_t GetNrNodes() const { return m_nodes.size(); }
         inline size_t GetNrEdges() const { return m_edges.size(); }
+        // Changes made through the non const GetNodes/GetEdges aren't tracked,
+        // call Invalidate after editing the storage directly
+        inline unsigned int GetVersion() const { return m_version; }
+        inline void Invalidate() { ++m_version; }
 
         inline int GetMatrixIndex(int row, int col) const
         {
@@ -210,19 +576,39 @@ namespace KWGraph
             return row * nrNodes + col;
         }
 
+        // The one way algorithms should walk the edges of a node, see
+        // NeighborRange. The matrix is only used when it's the sole storage
+        inline NeighborRange<T> Neighbors(int id) const
+        {
+            bool useMatrix = (m_storageType == StorageType_AdjacencyMatrix) &&
+                             m_matrix.size() == m_nodes.size() * m_nodes.size();
+            if(useMatrix)
+            {
+                int nrNodes = static_cast<int>(m_nodes.size());
+                return NeighborRange<T>::FromMatrixRow(&m_matrix[GetMatrixIndex(id, 0)], nrNodes);
+            }
+            const Edge<T>* edges = m_edges.empty() ? NULL : &m_edges[0];
+            return NeighborRange<T>::FromList(m_nodes[id].edges, edges);
+        }
+
+        inline StorageType GetStorageType() const { return m_storageType; }
+
         void AddNode(T weight)
         {
             Node<T> newNode;
             newNode.weight = weight;
+            newNode.id = static_cast<int>(m_nodes.size());
 
             //TODO handle errors in case the vector cannot resize        
             m_nodes.push_back(newNode);
+            Invalidate();
         }
 
         void AddNode(const Node<T>& node)
         {
             //TODO handle errors in case the vector cannot resize
             m_nodes.push_back(node);
+            Invalidate();
         }
 
         void AddListEdge(Node<T>& source, Node<T>& destination, T weight, bool directed)
@@ -259,6 +645,7 @@ namespace KWGraph
                 m_edges.push_back(newEdge);
                 m_nodes[destId].edges.push_back(edgeId);
             }
+            Invalidate();
         }
 
         void AddListEdge(int sourceId, int destId, T weight)
@@ -283,18 +670,15 @@ namespace KWGraph
             if(m_matrix.size() != expectedSize)
                 AllocAdjacencyMatrix();
         
-            size_t nrNodes = m_nodes.size();
-            int srcRow = static_cast<int>(sourceId / (float)nrNodes);
-            int dstRow = static_cast<int>(destId / (float)nrNodes);
-            int srcCol = sourceId % nrNodes;
-            int dstCol = destId % nrNodes;
-            int srcToDstIndex = GetMatrixIndex(srcRow, dstCol);
+            // Row i holds the outgoing edges of node i
+            int srcToDstIndex = GetMatrixIndex(sourceId, destId);
             m_matrix[srcToDstIndex] = weight;
             if(directed)
             {
-                int dstToSrcIndex = GetMatrixIndex(dstRow, srcCol);
+                int dstToSrcIndex = GetMatrixIndex(destId, sourceId);
                 m_matrix[dstToSrcIndex] = weight;
             }
+            Invalidate();
         }
 
         void AddMatrixEdge(Node<T>& src, Node<T>& dest, T weight, bool directed)
@@ -382,7 +766,7 @@ namespace KWGraph
             for(size_t nodeIt = 0; nodeIt < size; ++nodeIt)
             {
                 Node<T>& newNode = m_nodes[nodeIt];            
-                newNode.weight = T(rand() / (float)RAND_MAX) * weightScale;
+                newNode.weight = T(rand() / (float)RAND_MAX * weightScale);
                 for(size_t edgeIt = 0; edgeIt < size; ++edgeIt)
                 {
                     float randomChance = rand() / (float)RAND_MAX;        
@@ -390,7 +774,7 @@ namespace KWGraph
                     {
                         if(!isCyclic && edgeIt == nodeIt)
                             continue;
-                        T edgeWeight = T(rand() / (float)RAND_MAX) * weightScale;
+                        T edgeWeight = T(rand() / (float)RAND_MAX * weightScale);
                         AddEdge(nodeIt, edgeIt, edgeWeight, isDirected);
                     }
                 }
@@ -398,7 +782,7 @@ namespace KWGraph
                 if(isConnected && newNode.edges.size() == 0)
                 {
                     int connectionIndex = rand() % size;
-                    T edgeWeight = T(rand() / (float)RAND_MAX) * weightScale;
+                    T edgeWeight = T(rand() / (float)RAND_MAX * weightScale);
 
                     while(!isCyclic && connectionIndex == nodeIt)
                         connectionIndex = rand() % size;
@@ -422,10 +806,7 @@ namespace KWGraph
                                           : m_denseEdgeChance;
             const int nrConnections = edgeChance * size;
             InitGraphStorage(size, edgeChance, isDirected);
-            std::vector<PThreadID> threads;
             std::vector< EdgeCreateData<T> > edgeData;
-            threads.resize(nrThreads);
-            int crThreadId = 0;
             edgeData.resize(size);
             for(size_t nodeIt = 0; nodeIt < size; ++nodeIt)
             {
@@ -435,14 +816,14 @@ namespace KWGraph
                 data.nrConnections = nrConnections;
                 data.weightScale = weightScale;
                 data.directed = isDirected;
-
-                PWaitOnThread(threads[crThreadId], NULL);
-                PStartThread((void*)&edgeData[nodeIt], CreateGraphEdges<T>, threads[crThreadId]);
-
-                crThreadId = (crThreadId + 1) % nrThreads;
             }
-            for(size_t threadIt = 0; threadIt < nrThreads; ++threadIt)
-                PWaitOnThread(threads[crThreadId], NULL);
+
+            // The pool threads are persistent so nrThreads only decides how
+            // finely the nodes are split between them
+            int nrRanges = (nrThreads > 0) ? nrThreads * 8 : 8;
+            int grainSize = (size + nrRanges - 1) / nrRanges;
+            if(size > 0)
+                PParallelFor(0, size, grainSize, CreateGraphEdges<T>, &edgeData[0]);
 
             for(size_t nodeIt = 0; nodeIt < size; ++nodeIt)
             {
@@ -454,6 +835,7 @@ namespace KWGraph
                     data.node->edges.push_back(edgeId);
                 }
             }
+            Invalidate();
 
         }
         void BFSAddNextComponentNode(GraphVisitor<T>* visitor, 
@@ -549,11 +931,11 @@ namespace KWGraph
                     }
                 }
 
-                for(size_t edgeIt = 0; edgeIt < crNode->edges.size(); ++edgeIt)
+                NeighborRange<T> neighbors = Neighbors(crNode->id);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin(); 
+                    edgeIt != neighbors.end(); ++edgeIt)
                 {
-                    int edgeIdx = crNode->edges[edgeIt];
-                    Edge<T>& crEdge = m_edges[edgeIdx];
-                    Node<T>& nextNode = m_nodes[crEdge.destination];
+                    Node<T>& nextNode = m_nodes[edgeIt.GetDestination()];
                     if(nextNode.parent == INVALID_ID)
                         nextNode.parent = crNode->id;
                     visitQueue.push(&nextNode);
@@ -579,6 +961,58 @@ namespace KWGraph
             }
         }
 
+        // Visits the nodes reachable from source that aren't already visited
+        // in the workspace. Parents and distances are written to the workspace
+        // instead of the nodes so the graph is left untouched
+        NodeAction BFSComponent(int source, GraphVisitor<T>* visitor, 
+                                TraversalWorkspace& workspace) const
+        {
+            return VisitBFSComponent<T>(*this, source, visitor, workspace);
+        }
+
+        // Single component BFS from the visitor source that only reads the
+        // graph, so it can run concurrently with other traversals as long as
+        // each one has its own workspace
+        void BFS(GraphVisitor<T>* visitor, TraversalWorkspace& workspace) const
+        {
+            VisitBFS<T>(*this, GetVisitorSource(visitor), visitor, workspace);
+        }
+
+        // Same for DFS, the workspace distances are the depths in the DFS
+        // tree. It keeps its own stack like DFSRange
+        void DFS(GraphVisitor<T>* visitor, DFSOrder order, TraversalWorkspace& workspace) const
+        {
+            VisitDFS<T>(*this, GetVisitorSource(visitor), visitor, order, workspace);
+        }
+
+        // Pull style traversals, the next node is only discovered when the
+        // loop asks for it so breaking out of the loop stops the traversal:
+        //     for(const Node<T>& node : graph.BFSRange(src))
+        // The range owns the traversal state, keep it alive while iterating.
+        // Like BFS with a workspace they only visit the component of source
+        // and leave the graph untouched
+        BFSNodeRange<T> BFSRange(int source) const
+        {
+            return BFSNodeRange<T>(this, source, NULL);
+        }
+
+        BFSNodeRange<T> BFSRange(int source, TraversalWorkspace& workspace) const
+        {
+            return BFSNodeRange<T>(this, source, &workspace);
+        }
+
+        // Pre order DFS that keeps its own stack, so deep graphs can't
+        // overflow the call stack like DFSStep can
+        DFSNodeRange<T> DFSRange(int source) const
+        {
+            return DFSNodeRange<T>(this, source, NULL);
+        }
+
+        DFSNodeRange<T> DFSRange(int source, TraversalWorkspace& workspace) const
+        {
+            return DFSNodeRange<T>(this, source, &workspace);
+        }
+
         NodeAction DFSStep(Node<T>& node, GraphVisitor<T>* visitor, 
                      std::vector<bool>& visited, DFSOrder order, int parent)
         {
@@ -605,11 +1039,11 @@ namespace KWGraph
                     return action;
             }
         
-            for(size_t edgeIt = 0; edgeIt < node.edges.size() && !skipChildren; ++edgeIt)
+            NeighborRange<T> neighbors = Neighbors(node.id);
+            for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin(); 
+                edgeIt != neighbors.end() && !skipChildren; ++edgeIt)
             {
-                int edgeIdx = node.edges[edgeIt];
-                Edge<T>& edge = m_edges[edgeIdx];
-                Node<T>& nextNode = m_nodes[edge.destination];
+                Node<T>& nextNode = m_nodes[edgeIt.GetDestination()];
                 NodeAction action = DFSStep(nextNode, visitor, visited, order, node.id);
                 if(action == NodeAction_Abort)
                     return action;
@@ -629,6 +1063,7 @@ namespace KWGraph
                 if(action == NodeAction_Abort)
                     return action;
             }
+            return NodeAction_Continue;
         }
 
         void DFS(GraphVisitor<T>* visitor, DFSOrder order)
@@ -682,6 +1117,10 @@ namespace KWGraph
         }
     };
 
+    // Non integral static members can't be initialized in the class
+    template <typename T>
+    const float Graph<T>::m_denseEdgeChance = 0.8f;
+
     template<typename T>
     class GraphVisitor
     {
@@ -726,6 +1165,459 @@ namespace KWGraph
         };
     };
 
+    namespace
+    {
+        template <typename T>
+        struct DFSVisitFrame
+        {
+            int                                     nodeId;
+            typename NeighborRange<T>::Iterator     nextEdge;
+            typename NeighborRange<T>::Iterator     endEdge;
+        };
+
+        // The first half of DFSStep, the node goes on the stack only when
+        // the visitor wants its children
+        template <typename T, typename GraphType>
+        static NodeAction EnterDFSNode(const GraphType& graph, int nodeId, int parent, int depth,
+                                       GraphVisitor<T>* visitor, DFSOrder order, TraversalWorkspace& workspace,
+                                       std::vector< DFSVisitFrame<T> >& stack)
+        {
+            workspace.Visit(nodeId, parent, depth);
+            if(visitor)
+            {
+                const Node<T>& node = graph.GetNodes()[nodeId];
+                NodeAction action = visitor->OnBeginNodeProcess(node);
+                if(action != NodeAction_Continue)
+                    return action;
+                if(order == DFSOrder_PreOrder)
+                {
+                    action = visitor->OnNodeProcess(node);
+                    if(action != NodeAction_Continue)
+                        return action;
+                }
+            }
+            NeighborRange<T> neighbors = graph.Neighbors(nodeId);
+            DFSVisitFrame<T> frame;
+            frame.nodeId = nodeId;
+            frame.nextEdge = neighbors.begin();
+            frame.endEdge = neighbors.end();
+            stack.push_back(frame);
+            return NodeAction_Continue;
+        }
+
+        template <typename T, typename GraphType>
+        static NodeAction VisitDFSComponent(const GraphType& graph, int source, GraphVisitor<T>* visitor,
+                                            DFSOrder order, TraversalWorkspace& workspace)
+        {
+            if(workspace.IsVisited(source))
+                return NodeAction_Continue;
+            std::vector< DFSVisitFrame<T> > stack;
+            if(EnterDFSNode(graph, source, ROOT_ID, 0, visitor, order, workspace, stack) == NodeAction_Abort)
+                return NodeAction_Abort;
+            while(!stack.empty())
+            {
+                DFSVisitFrame<T>& frame = stack.back();
+                if(frame.nextEdge != frame.endEdge)
+                {
+                    int crNodeId = frame.nodeId;
+                    int nextId = frame.nextEdge.GetDestination();
+                    ++frame.nextEdge;
+                    NodeAction action = NodeAction_Continue;
+                    if(!workspace.IsVisited(nextId))
+                        action = EnterDFSNode(graph, nextId, crNodeId, workspace.distances[crNodeId] + 1,
+                                              visitor, order, workspace, stack);
+                    else if(visitor)
+                        action = visitor->OnNodeAlreadyVisited(graph.GetNodes()[nextId]);
+                    if(action == NodeAction_Abort)
+                        return action;
+                    continue;
+                }
+
+                const Node<T>& node = graph.GetNodes()[frame.nodeId];
+                stack.pop_back();
+                if(visitor)
+                {
+                    if(order == DFSOrder_PostOrder && visitor->OnNodeProcess(node) == NodeAction_Abort)
+                        return NodeAction_Abort;
+                    if(visitor->OnEndNodeProcess(node) == NodeAction_Abort)
+                        return NodeAction_Abort;
+                }
+            }
+            return NodeAction_Continue;
+        }
+    }
+
+    template <typename T, typename GraphType>
+    NodeAction VisitBFSComponent(const GraphType& graph, int source, GraphVisitor<T>* visitor,
+                                 TraversalWorkspace& workspace)
+    {
+        const std::vector< Node<T> >& nodes = graph.GetNodes();
+        std::vector<int>& visitQueue = workspace.queue;
+        visitQueue.clear();
+        if(workspace.IsVisited(source))
+            return NodeAction_Continue;
+
+        workspace.Visit(source, ROOT_ID, 0);
+        visitQueue.push_back(source);
+        // The queue is a flat vector that is never popped, which saves
+        // the allocations std::queue does per chunk
+        for(size_t queueIt = 0; queueIt < visitQueue.size(); ++queueIt)
+        {
+            const Node<T>& crNode = nodes[visitQueue[queueIt]];
+            if(visitor)
+            {
+                NodeAction action = visitor->OnBeginNodeProcess(crNode);
+                if(action == NodeAction_Abort)
+                    return action;
+                if(action == NodeAction_SkipChildren)
+                    continue;
+
+                action = visitor->OnNodeProcess(crNode);
+                if(action == NodeAction_Abort)
+                    return action;
+                if(action == NodeAction_SkipChildren)
+                    continue;
+            }
+
+            int nextDistance = workspace.distances[crNode.id] + 1;
+            NeighborRange<T> neighbors = graph.Neighbors(crNode.id);
+            for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin(); 
+                edgeIt != neighbors.end(); ++edgeIt)
+            {
+                int nextId = edgeIt.GetDestination();
+                if(workspace.IsVisited(nextId))
+                {
+                    if(visitor)
+                    {
+                        NodeAction action = visitor->OnNodeAlreadyVisited(nodes[nextId]);
+                        if(action == NodeAction_Abort)
+                            return action;
+                    }
+                    continue;
+                }
+                workspace.Visit(nextId, crNode.id, nextDistance);
+                visitQueue.push_back(nextId);
+            }
+
+            if(visitor)
+            {
+                NodeAction action = visitor->OnEndNodeProcess(crNode);
+                if(action == NodeAction_Abort)
+                    return action;
+            }
+        }
+        return NodeAction_Continue;
+    }
+
+    // One component from source wrapped in the visit events. An INVALID_ID
+    // source, like a hidden node of a view, visits no node
+    template <typename T, typename GraphType>
+    void VisitBFS(const GraphType& graph, int source, GraphVisitor<T>* visitor, TraversalWorkspace& workspace)
+    {
+        size_t nrNodes = graph.GetNrNodes();
+        if(nrNodes == 0)
+            return;
+
+        workspace.Reset(nrNodes);
+        if(visitor)
+        {
+            visitor->OnStartVisit();
+            visitor->OnStartComponentVisit();
+        }
+        if(source != INVALID_ID)
+            VisitBFSComponent(graph, source, visitor, workspace);
+        if(visitor)
+        {
+            visitor->OnEndComponentVisit();
+            visitor->OnEndVisit();
+        }
+    }
+
+    template <typename T, typename GraphType>
+    void VisitDFS(const GraphType& graph, int source, GraphVisitor<T>* visitor, DFSOrder order,
+                  TraversalWorkspace& workspace)
+    {
+        size_t nrNodes = graph.GetNrNodes();
+        if(nrNodes == 0)
+            return;
+
+        workspace.Reset(nrNodes);
+        if(visitor)
+        {
+            visitor->OnStartVisit();
+            visitor->OnStartComponentVisit();
+        }
+        if(source != INVALID_ID)
+            VisitDFSComponent(graph, source, visitor, order, workspace);
+        if(visitor)
+        {
+            visitor->OnEndComponentVisit();
+            visitor->OnEndVisit();
+        }
+    }
+
+    // Shared iterator for the traversal ranges, the range keeps all of the
+    // state so the iterator is just a handle to it
+    template <typename T, typename Range>
+    class NodeRangeIterator
+    {
+    private:
+        Range* m_range;
+    public:
+        NodeRangeIterator() : m_range(NULL) {}
+        explicit NodeRangeIterator(Range* range) : m_range(range) {}
+
+        inline const Node<T>& operator*() const { return m_range->GetCurrent(); }
+        inline const Node<T>* operator->() const { return &m_range->GetCurrent(); }
+        inline NodeRangeIterator& operator++()
+        {
+            m_range->Advance();
+            return *this;
+        }
+
+        // Only compares against the end of the range
+        inline bool operator==(const NodeRangeIterator& other) const
+        {
+            bool isDone = (m_range == NULL) || m_range->IsDone();
+            bool isOtherDone = (other.m_range == NULL) || other.m_range->IsDone();
+            return isDone == isOtherDone;
+        }
+        inline bool operator!=(const NodeRangeIterator& other) const { return !(*this == other); }
+
+        // Parent of the current node in the traversal tree, ROOT_ID for source
+        inline int GetParent() const { return m_range->GetWorkspace().parents[m_range->GetCurrent().id]; }
+        // BFS level or DFS depth of the current node
+        inline int GetDistance() const { return m_range->GetWorkspace().distances[m_range->GetCurrent().id]; }
+        // Same as returning NodeAction_SkipChildren from a visitor
+        inline void SkipChildren() { m_range->SkipChildren(); }
+    };
+
+    template <typename T, typename GraphType>
+    class BFSNodeRange
+    {
+    private:
+        const GraphType*    m_graph;
+        // NULL when the range uses m_ownWorkspace
+        TraversalWorkspace* m_workspace;
+        TraversalWorkspace  m_ownWorkspace;
+        int                 m_source;
+        size_t              m_position;
+        bool                m_skipChildren;
+    public:
+        typedef NodeRangeIterator< T, BFSNodeRange<T, GraphType> > Iterator;
+
+        // Nothing is allocated until begin so copying a fresh range is cheap
+        BFSNodeRange(const GraphType* graph, int source, TraversalWorkspace* workspace) :
+            m_graph(graph),
+            m_workspace(workspace),
+            m_source(source),
+            m_position(0),
+            m_skipChildren(false) {}
+
+        Iterator begin()
+        {
+            TraversalWorkspace& workspace = GetWorkspace();
+            workspace.Reset(m_graph->GetNrNodes());
+            m_position = 0;
+            m_skipChildren = false;
+            if(m_source >= 0 && (size_t)m_source < m_graph->GetNrNodes())
+            {
+                workspace.Visit(m_source, ROOT_ID, 0);
+                workspace.queue.push_back(m_source);
+            }
+            return Iterator(this);
+        }
+
+        Iterator end() { return Iterator(); }
+
+        inline TraversalWorkspace& GetWorkspace() { return m_workspace ? *m_workspace : m_ownWorkspace; }
+        inline bool IsDone() { return m_position >= GetWorkspace().queue.size(); }
+        inline const Node<T>& GetCurrent() { return m_graph->GetNodes()[GetWorkspace().queue[m_position]]; }
+        inline void SkipChildren() { m_skipChildren = true; }
+
+        // The children of the current node are only queued when moving past it
+        void Advance()
+        {
+            TraversalWorkspace& workspace = GetWorkspace();
+            if(!m_skipChildren)
+            {
+                const Node<T>& crNode = GetCurrent();
+                int nextDistance = workspace.distances[crNode.id] + 1;
+                NeighborRange<T> neighbors = m_graph->Neighbors(crNode.id);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin(); 
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    int nextId = edgeIt.GetDestination();
+                    if(workspace.IsVisited(nextId))
+                        continue;
+                    workspace.Visit(nextId, crNode.id, nextDistance);
+                    workspace.queue.push_back(nextId);
+                }
+            }
+            m_skipChildren = false;
+            ++m_position;
+        }
+    };
+
+    template <typename T, typename GraphType>
+    class DFSNodeRange
+    {
+    private:
+        struct StackEntry
+        {
+            int                                     nodeId;
+            typename NeighborRange<T>::Iterator     nextEdge;
+            typename NeighborRange<T>::Iterator     endEdge;
+        };
+
+        StackEntry MakeEntry(int nodeId) const
+        {
+            NeighborRange<T> neighbors = m_graph->Neighbors(nodeId);
+            StackEntry entry;
+            entry.nodeId = nodeId;
+            entry.nextEdge = neighbors.begin();
+            entry.endEdge = neighbors.end();
+            return entry;
+        }
+
+        const GraphType*        m_graph;
+        TraversalWorkspace*     m_workspace;
+        TraversalWorkspace      m_ownWorkspace;
+        std::vector<StackEntry> m_stack;
+        int                     m_source;
+        int                     m_current;
+    public:
+        typedef NodeRangeIterator< T, DFSNodeRange<T, GraphType> > Iterator;
+
+        DFSNodeRange(const GraphType* graph, int source, TraversalWorkspace* workspace) :
+            m_graph(graph),
+            m_workspace(workspace),
+            m_source(source),
+            m_current(INVALID_ID) {}
+
+        Iterator begin()
+        {
+            TraversalWorkspace& workspace = GetWorkspace();
+            workspace.Reset(m_graph->GetNrNodes());
+            m_stack.clear();
+            m_current = INVALID_ID;
+            if(m_source >= 0 && (size_t)m_source < m_graph->GetNrNodes())
+            {
+                workspace.Visit(m_source, ROOT_ID, 0);
+                m_stack.push_back(MakeEntry(m_source));
+                m_current = m_source;
+            }
+            return Iterator(this);
+        }
+
+        Iterator end() { return Iterator(); }
+
+        inline TraversalWorkspace& GetWorkspace() { return m_workspace ? *m_workspace : m_ownWorkspace; }
+        inline bool IsDone() const { return m_current == INVALID_ID; }
+        inline const Node<T>& GetCurrent() { return m_graph->GetNodes()[m_current]; }
+        inline void SkipChildren()
+        {
+            if(!m_stack.empty() && m_stack.back().nodeId == m_current)
+                m_stack.pop_back();
+        }
+
+        // Descends into the next unvisited child, backtracking as needed
+        void Advance()
+        {
+            TraversalWorkspace& workspace = GetWorkspace();
+            m_current = INVALID_ID;
+            while(!m_stack.empty())
+            {
+                StackEntry& top = m_stack.back();
+                if(top.nextEdge == top.endEdge)
+                {
+                    m_stack.pop_back();
+                    continue;
+                }
+
+                int nextId = top.nextEdge.GetDestination();
+                ++top.nextEdge;
+                if(workspace.IsVisited(nextId))
+                    continue;
+
+                workspace.Visit(nextId, top.nodeId, workspace.distances[top.nodeId] + 1);
+                m_stack.push_back(MakeEntry(nextId));
+                m_current = nextId;
+                return;
+            }
+        }
+    };
+
+    // Wraps a traversal range and only hands out the nodes that pass the
+    // predicate. Filtered out nodes are still traversed through
+    template <typename T, typename Range, typename Predicate>
+    class FilteredNodeRange
+    {
+    private:
+        Range       m_range;
+        Predicate   m_predicate;
+    public:
+        class Iterator
+        {
+        private:
+            typename Range::Iterator    m_it;
+            typename Range::Iterator    m_end;
+            const Predicate*            m_predicate;
+
+            void SkipRejected()
+            {
+                while(m_it != m_end && !(*m_predicate)(*m_it))
+                    ++m_it;
+            }
+        public:
+            Iterator() : m_predicate(NULL) {}
+            Iterator(typename Range::Iterator it, typename Range::Iterator end, const Predicate* predicate) :
+                m_it(it), m_end(end), m_predicate(predicate)
+            {
+                SkipRejected();
+            }
+
+            inline const Node<T>& operator*() const { return *m_it; }
+            inline const Node<T>* operator->() const { return &*m_it; }
+            inline Iterator& operator++()
+            {
+                ++m_it;
+                SkipRejected();
+                return *this;
+            }
+            inline bool operator==(const Iterator& other) const { return m_it == other.m_it; }
+            inline bool operator!=(const Iterator& other) const { return m_it != other.m_it; }
+            inline int GetParent() const { return m_it.GetParent(); }
+            inline int GetDistance() const { return m_it.GetDistance(); }
+            inline void SkipChildren() { m_it.SkipChildren(); }
+        };
+
+        FilteredNodeRange(const Range& range, const Predicate& predicate) :
+            m_range(range), m_predicate(predicate) {}
+
+        Iterator begin()
+        {
+            typename Range::Iterator rangeBegin = m_range.begin();
+            return Iterator(rangeBegin, m_range.end(), &m_predicate);
+        }
+
+        Iterator end() { return Iterator(m_range.end(), m_range.end(), &m_predicate); }
+    };
+
+    template <typename T, typename GraphType, typename Predicate>
+    FilteredNodeRange<T, BFSNodeRange<T, GraphType>, Predicate> FilterNodes(const BFSNodeRange<T, GraphType>& range,
+                                                                            const Predicate& predicate)
+    {
+        return FilteredNodeRange<T, BFSNodeRange<T, GraphType>, Predicate>(range, predicate);
+    }
+
+    template <typename T, typename GraphType, typename Predicate>
+    FilteredNodeRange<T, DFSNodeRange<T, GraphType>, Predicate> FilterNodes(const DFSNodeRange<T, GraphType>& range,
+                                                                            const Predicate& predicate)
+    {
+        return FilteredNodeRange<T, DFSNodeRange<T, GraphType>, Predicate>(range, predicate);
+    }
+
     typedef Node<int> IntNode;
     typedef Node<float> FloatNode;
     typedef Graph<int> IntGraph;
@@ -783,7 +1675,7 @@ namespace KWGraph
     
         static inline float GetSeconds(ProfileDataType time)
         {
-            return time * 0.0000001f;
+            return time * 0.000001f;
         }
 #elif defined(_WIN32)
 #       include <Mmsystem.h>
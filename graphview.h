@@ -0,0 +1,346 @@
+#ifndef KWGRAPH_GRAPHVIEW_H
+#define KWGRAPH_GRAPHVIEW_H
+
+#include <atomic>
+#include <mutex>
+#include "graph.h"
+
+namespace KWGraph
+{
+    // Edge predicate for GraphView::FilterEdges, keeps the edges that weigh
+    // at least minWeight
+    template <typename T>
+    struct MinEdgeWeight
+    {
+        explicit MinEdgeWeight(T weight) : minWeight(weight) {}
+        inline bool operator()(const Edge<T>& edge) const { return !(edge.weight < minWeight); }
+        T minWeight;
+    };
+
+    namespace
+    {
+        template <typename T, typename Predicate>
+        struct ViewMaskData
+        {
+            const Graph<T>*         graph;
+            const Predicate*        predicate;
+            std::vector<uint64_t>*  bits;
+            // Matrix only graphs key their edges by matrix index
+            bool                    useMatrix;
+        };
+
+        // A range of mask words, so no two threads ever write the same word
+        template <typename T, typename Predicate>
+        static void FilterNodeWords(void* userData, int begin, int end)
+        {
+            ViewMaskData<T, Predicate>* data = static_cast<ViewMaskData<T, Predicate>*>(userData);
+            const std::vector< Node<T> >& nodes = data->graph->GetNodes();
+            for(int wordIt = begin; wordIt < end; ++wordIt)
+            {
+                uint64_t& word = (*data->bits)[wordIt];
+                size_t first = (size_t)wordIt * 64;
+                size_t last = std::min(first + 64, nodes.size());
+                for(size_t nodeIt = first; nodeIt < last; ++nodeIt)
+                {
+                    if(!(*data->predicate)(nodes[nodeIt]))
+                        word &= ~(uint64_t(1) << (nodeIt - first));
+                }
+            }
+        }
+
+        template <typename T, typename Predicate>
+        static void FilterEdgeWords(void* userData, int begin, int end)
+        {
+            ViewMaskData<T, Predicate>* data = static_cast<ViewMaskData<T, Predicate>*>(userData);
+            const std::vector< Edge<T> >& edges = data->graph->GetEdges();
+            const std::vector<T>& matrix = data->graph->GetAdjacencyMatrix();
+            size_t nrNodes = data->graph->GetNrNodes();
+            size_t nrKeys = data->useMatrix ? matrix.size() : edges.size();
+            Edge<T> matrixEdge;
+            for(int wordIt = begin; wordIt < end; ++wordIt)
+            {
+                uint64_t& word = (*data->bits)[wordIt];
+                size_t first = (size_t)wordIt * 64;
+                size_t last = std::min(first + 64, nrKeys);
+                for(size_t keyIt = first; keyIt < last; ++keyIt)
+                {
+                    const Edge<T>* edge = &matrixEdge;
+                    if(!data->useMatrix)
+                    {
+                        edge = &edges[keyIt];
+                    }
+                    else if(matrix[keyIt] == T(0))
+                    {
+                        // Zero entries aren't edges, their bits don't matter
+                        continue;
+                    }
+                    else
+                    {
+                        matrixEdge.source = (int)(keyIt / nrNodes);
+                        matrixEdge.destination = (int)(keyIt % nrNodes);
+                        matrixEdge.weight = matrix[keyIt];
+                    }
+                    if(!(*data->predicate)(*edge))
+                        word &= ~(uint64_t(1) << (keyIt - first));
+                }
+            }
+        }
+    }
+
+    // Masks nodes and edges of a graph without copying it, so the same
+    // analytics can run on many filtered variants. Hidden nodes keep their
+    // ids but have no edges in or out, the view has the same number of
+    // nodes as the graph. It walks like a graph (GetNrNodes, Neighbors,
+    // BFSRange, DFSRange) and the algorithm entry points take it wherever
+    // they take a graph. Filters compose, every call hides some more and
+    // ShowAll starts over.
+    // Edges are keyed by their id in the edge list, or by their matrix index
+    // when the graph only keeps a matrix, the same as Neighbors picks them.
+    // NOTE: Call ShowAll after adding nodes or edges to the graph, the
+    // masks are sized when they are reset
+    template <typename T>
+    class GraphView
+    {
+    private:
+        const Graph<T>*         m_graph;
+        // A set bit means visible
+        std::vector<uint64_t>   m_nodeBits;
+        std::vector<uint64_t>   m_edgeBits;
+        // Without anything hidden Neighbors hands out the plain ranges
+        bool                    m_isNodeFiltered;
+        bool                    m_isEdgeFiltered;
+        NeighborFilter<T>       m_filter;
+        // Bumped by every change to the masks
+        unsigned int            m_maskVersion;
+        // Visible out degrees, counted by the first filtered Neighbors call
+        // after the masks change so hiding nodes one at a time doesn't
+        // recount them every time
+        mutable std::vector<int>    m_degrees;
+        mutable std::atomic<bool>   m_isDegreeValid;
+        mutable std::mutex          m_degreeLock;
+
+        GraphView(const GraphView&);
+        GraphView& operator=(const GraphView&);
+
+        inline bool UsesMatrix() const
+        {
+            return m_graph->GetStorageType() == StorageType_AdjacencyMatrix &&
+                   m_graph->GetAdjacencyMatrix().size() == m_graph->GetNrNodes() * m_graph->GetNrNodes();
+        }
+
+        inline size_t GetNrEdgeKeys() const
+        {
+            return UsesMatrix() ? m_graph->GetAdjacencyMatrix().size() : m_graph->GetNrEdges();
+        }
+
+        static inline void SetBit(std::vector<uint64_t>& bits, size_t index, bool isSet)
+        {
+            if(isSet)
+                bits[index >> 6] |= uint64_t(1) << (index & 63);
+            else
+                bits[index >> 6] &= ~(uint64_t(1) << (index & 63));
+        }
+
+        inline int GetVisibleSource(int source) const
+        {
+            bool isValid = source >= 0 && (size_t)source < m_graph->GetNrNodes();
+            return isValid && IsNodeVisible(source) ? source : INVALID_ID;
+        }
+
+        void UpdateFilter()
+        {
+            ++m_maskVersion;
+            m_filter.nodeBits = m_isNodeFiltered ? m_nodeBits.data() : NULL;
+            m_filter.edgeBits = m_isEdgeFiltered ? m_edgeBits.data() : NULL;
+            m_filter.matrix = UsesMatrix() ? m_graph->GetAdjacencyMatrix().data() : NULL;
+            m_isDegreeValid.store(false, std::memory_order_relaxed);
+        }
+
+        // Neighbors can be called from several threads, the first one in
+        // counts for all of them
+        void CountDegrees() const
+        {
+            std::lock_guard<std::mutex> guard(m_degreeLock);
+            if(m_isDegreeValid.load(std::memory_order_relaxed))
+                return;
+            int nrNodes = static_cast<int>(m_graph->GetNrNodes());
+            const Edge<T>* edges = m_graph->GetEdges().empty() ? NULL : &m_graph->GetEdges()[0];
+            m_degrees.assign(nrNodes, 0);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                if(!IsNodeVisible(nodeIt))
+                    continue;
+                if(m_filter.matrix)
+                {
+                    m_degrees[nodeIt] = (int)NeighborRange<T>::FromMatrixRow(m_filter.matrix + m_graph->GetMatrixIndex(nodeIt, 0),
+                                                                             nrNodes, &m_filter).size();
+                }
+                else
+                {
+                    m_degrees[nodeIt] = (int)NeighborRange<T>::FromList(m_graph->GetNodes()[nodeIt].edges, edges,
+                                                                        &m_filter).size();
+                }
+            }
+            m_isDegreeValid.store(true, std::memory_order_release);
+        }
+
+    public:
+        explicit GraphView(const Graph<T>* graph) :
+            m_graph(graph),
+            m_isNodeFiltered(false),
+            m_isEdgeFiltered(false),
+            m_maskVersion(0),
+            m_isDegreeValid(false)
+        {
+            ShowAll();
+        }
+
+        void ShowAll()
+        {
+            m_nodeBits.assign((m_graph->GetNrNodes() + 63) / 64, ~uint64_t(0));
+            m_edgeBits.assign((GetNrEdgeKeys() + 63) / 64, ~uint64_t(0));
+            m_isNodeFiltered = false;
+            m_isEdgeFiltered = false;
+            UpdateFilter();
+        }
+
+        void SetNodeVisible(int id, bool isVisible)
+        {
+            SetBit(m_nodeBits, id, isVisible);
+            m_isNodeFiltered = true;
+            UpdateFilter();
+        }
+
+        // edgeKey is an edge id, or a matrix index for matrix only graphs
+        void SetEdgeVisible(size_t edgeKey, bool isVisible)
+        {
+            SetBit(m_edgeBits, edgeKey, isVisible);
+            m_isEdgeFiltered = true;
+            UpdateFilter();
+        }
+
+        // Hides the nodes for which predicate(const Node<T>&) is false
+        template <typename Predicate>
+        void FilterNodes(const Predicate& predicate)
+        {
+            ViewMaskData<T, Predicate> data;
+            data.graph = m_graph;
+            data.predicate = &predicate;
+            data.bits = &m_nodeBits;
+            data.useMatrix = false;
+            if(!m_nodeBits.empty())
+                PParallelFor(0, (int)m_nodeBits.size(), 0, FilterNodeWords<T, Predicate>, &data);
+            m_isNodeFiltered = true;
+            UpdateFilter();
+        }
+
+        // Hides the edges for which predicate(const Edge<T>&) is false. For
+        // matrix only graphs the edge is made up from the matrix entry
+        template <typename Predicate>
+        void FilterEdges(const Predicate& predicate)
+        {
+            ViewMaskData<T, Predicate> data;
+            data.graph = m_graph;
+            data.predicate = &predicate;
+            data.bits = &m_edgeBits;
+            data.useMatrix = UsesMatrix();
+            if(!m_edgeBits.empty())
+                PParallelFor(0, (int)m_edgeBits.size(), 0, FilterEdgeWords<T, Predicate>, &data);
+            m_isEdgeFiltered = true;
+            UpdateFilter();
+        }
+
+        inline bool IsNodeVisible(int id) const { return IsBitSet(m_nodeBits.data(), id); }
+        inline bool IsEdgeVisible(size_t edgeKey) const { return IsBitSet(m_edgeBits.data(), edgeKey); }
+        // An entry of GetEdges that Neighbors hands out, for the algorithms
+        // that walk the edge list instead of the neighbors
+        inline bool IsListEdgeVisible(int edgeId) const
+        {
+            const Edge<T>& edge = m_graph->GetEdges()[edgeId];
+            return IsEdgeVisible(edgeId) && IsNodeVisible(edge.source) && IsNodeVisible(edge.destination);
+        }
+
+        inline const Graph<T>& GetGraph() const { return *m_graph; }
+        inline const std::vector< Node<T> >& GetNodes() const { return m_graph->GetNodes(); }
+        inline const std::vector< Edge<T> >& GetEdges() const { return m_graph->GetEdges(); }
+        inline size_t GetNrNodes() const { return m_graph->GetNrNodes(); }
+        // Changes with the graph version and with every change to the masks,
+        // so caches built on top of a view know when to rebuild
+        inline unsigned int GetVersion() const { return m_graph->GetVersion() + m_maskVersion; }
+
+        // Same as Graph::Neighbors minus the hidden edges and the edges to
+        // hidden nodes, a hidden node has none. size() is O(1), the visible
+        // degrees are counted once after the masks change
+        inline NeighborRange<T> Neighbors(int id) const
+        {
+            if(!m_isNodeFiltered && !m_isEdgeFiltered)
+                return m_graph->Neighbors(id);
+            if(!IsNodeVisible(id))
+                return NeighborRange<T>();
+            if(!m_isDegreeValid.load(std::memory_order_acquire))
+                CountDegrees();
+            if(m_filter.matrix)
+            {
+                int nrNodes = static_cast<int>(m_graph->GetNrNodes());
+                return NeighborRange<T>::FromMatrixRow(m_filter.matrix + m_graph->GetMatrixIndex(id, 0), nrNodes,
+                                                       &m_filter, m_degrees[id]);
+            }
+            const Edge<T>* edges = m_graph->GetEdges().empty() ? NULL : &m_graph->GetEdges()[0];
+            return NeighborRange<T>::FromList(m_graph->GetNodes()[id].edges, edges, &m_filter, m_degrees[id]);
+        }
+
+        // Traversals from a hidden source are empty
+        BFSNodeRange< T, GraphView<T> > BFSRange(int source) const
+        {
+            return BFSNodeRange< T, GraphView<T> >(this, GetVisibleSource(source), NULL);
+        }
+
+        BFSNodeRange< T, GraphView<T> > BFSRange(int source, TraversalWorkspace& workspace) const
+        {
+            return BFSNodeRange< T, GraphView<T> >(this, GetVisibleSource(source), &workspace);
+        }
+
+        DFSNodeRange< T, GraphView<T> > DFSRange(int source) const
+        {
+            return DFSNodeRange< T, GraphView<T> >(this, GetVisibleSource(source), NULL);
+        }
+
+        DFSNodeRange< T, GraphView<T> > DFSRange(int source, TraversalWorkspace& workspace) const
+        {
+            return DFSNodeRange< T, GraphView<T> >(this, GetVisibleSource(source), &workspace);
+        }
+
+        // The workspace visitor traversals of Graph, from the visitor source
+        // or node 0. A hidden source visits no node
+        void BFS(GraphVisitor<T>* visitor, TraversalWorkspace& workspace) const
+        {
+            int source = visitor ? std::max(visitor->GetVisitSource(), 0) : 0;
+            VisitBFS<T>(*this, GetVisibleSource(source), visitor, workspace);
+        }
+
+        void DFS(GraphVisitor<T>* visitor, DFSOrder order, TraversalWorkspace& workspace) const
+        {
+            int source = visitor ? std::max(visitor->GetVisitSource(), 0) : 0;
+            VisitDFS<T>(*this, GetVisibleSource(source), visitor, order, workspace);
+        }
+    };
+
+    // Lets the algorithms that walk GetEdges or every node id take a graph
+    // or a view
+    template <typename T>
+    inline bool IsListEdgeVisible(const Graph<T>& /*graph*/, int /*edgeId*/) { return true; }
+
+    template <typename T>
+    inline bool IsListEdgeVisible(const GraphView<T>& graph, int edgeId) { return graph.IsListEdgeVisible(edgeId); }
+
+    template <typename T>
+    inline bool IsNodeVisible(const Graph<T>& /*graph*/, int /*id*/) { return true; }
+
+    template <typename T>
+    inline bool IsNodeVisible(const GraphView<T>& graph, int id) { return graph.IsNodeVisible(id); }
+
+    typedef GraphView<int> IntGraphView;
+    typedef GraphView<float> FloatGraphView;
+}
+
+#endif
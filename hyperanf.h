@@ -0,0 +1,272 @@
+#ifndef KWGRAPH_HYPERANF_H
+#define KWGRAPH_HYPERANF_H
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include "graphview.h"
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+namespace KWGraph
+{
+    // Estimated neighborhood function of a graph, see
+    // ComputeNeighborhoodFunction
+    struct NeighborhoodFunction
+    {
+        // neighborhood[t] is the number of pairs (u, v) with v at most t hops
+        // from u, the pairs (u, u) included so neighborhood[0] is about the
+        // number of nodes. Hidden nodes of a view are in no pair. The last
+        // entry is where the counters stopped growing
+        std::vector<double> neighborhood;
+
+        // Interpolated number of hops within which fraction of the
+        // reachable pairs are
+        double GetEffectiveDiameter(double fraction) const
+        {
+            if(neighborhood.empty())
+                return 0.0;
+            double target = fraction * neighborhood.back();
+            for(size_t hopIt = 0; hopIt < neighborhood.size(); ++hopIt)
+            {
+                if(neighborhood[hopIt] < target)
+                    continue;
+                if(hopIt == 0)
+                    return 0.0;
+                double previous = neighborhood[hopIt - 1];
+                return (hopIt - 1) + (target - previous) / (neighborhood[hopIt] - previous);
+            }
+            return (double)(neighborhood.size() - 1);
+        }
+
+        double GetEffectiveDiameter() const { return GetEffectiveDiameter(0.9); }
+
+        // Mean distance between two different nodes, over the pairs where
+        // the second is reachable from the first
+        double GetAverageDistance() const
+        {
+            if(neighborhood.size() < 2)
+                return 0.0;
+            double distanceSum = 0.0;
+            for(size_t hopIt = 1; hopIt < neighborhood.size(); ++hopIt)
+                distanceSum += hopIt * std::max(neighborhood[hopIt] - neighborhood[hopIt - 1], 0.0);
+            double nrPairs = neighborhood.back() - neighborhood[0];
+            return nrPairs > 0.0 ? distanceSum / nrPairs : 0.0;
+        }
+    };
+
+    namespace
+    {
+        static inline uint64_t HashNodeId(uint64_t id)
+        {
+            uint64_t mixed = id + 0x9E3779B97F4A7C15ull;
+            mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ull;
+            mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBull;
+            return mixed ^ (mixed >> 31);
+        }
+
+        // registers = max(registers, other) byte by byte, 16 registers per
+        // SSE2 instruction, or 8 per word by comparing the bytes with their
+        // high bit set as a borrow guard (registers never reach 128)
+        static inline void MaxRegisters(uint8_t* registers, const uint8_t* other, int nrRegisters)
+        {
+#if defined(__SSE2__)
+            for(int registerIt = 0; registerIt < nrRegisters; registerIt += 16)
+            {
+                __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(registers + registerIt));
+                __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(other + registerIt));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(registers + registerIt), _mm_max_epu8(first, second));
+            }
+#else
+            const uint64_t highBits = 0x8080808080808080ull;
+            for(int registerIt = 0; registerIt < nrRegisters; registerIt += 8)
+            {
+                uint64_t first;
+                uint64_t second;
+                memcpy(&first, registers + registerIt, sizeof(first));
+                memcpy(&second, other + registerIt, sizeof(second));
+                // High bit of a byte is set where first >= second
+                uint64_t isFirst = ((first | highBits) - second) & highBits;
+                uint64_t mask = (isFirst >> 7) * 0xFF;
+                uint64_t result = (first & mask) | (second & ~mask);
+                memcpy(registers + registerIt, &result, sizeof(result));
+            }
+#endif
+        }
+
+        static inline double EstimateCount(const uint8_t* registers, int nrRegisters)
+        {
+            double inverseSum = 0.0;
+            int nrZeros = 0;
+            for(int registerIt = 0; registerIt < nrRegisters; ++registerIt)
+            {
+                inverseSum += 1.0 / (double)(uint64_t(1) << registers[registerIt]);
+                nrZeros += (registers[registerIt] == 0);
+            }
+            double alpha = 0.7213 / (1.0 + 1.079 / nrRegisters);
+            double estimate = alpha * nrRegisters * nrRegisters / inverseSum;
+            // Linear counting is better while most registers are empty
+            if(estimate <= 2.5 * nrRegisters && nrZeros > 0)
+                estimate = nrRegisters * std::log((double)nrRegisters / nrZeros);
+            return estimate;
+        }
+
+        template <typename T, typename GraphType>
+        struct AnfData
+        {
+            const GraphType*            graph;
+            const std::vector<uint8_t>* counters;
+            std::vector<uint8_t>*       nextCounters;
+            // Counters that changed in the last pass and in this one
+            const std::vector<bool>*    wasModified;
+            std::vector<char>*          isModified;
+            std::vector<double>*        estimates;
+            int                         nrRegisters;
+        };
+
+        // The ball of radius t + 1 around a node is its own ball of radius t
+        // joined with the ones of its out neighbors. If none of those
+        // changed in the last pass the counter can't change either
+        template <typename T, typename GraphType>
+        static void UnionNeighborCounters(void* userData, int begin, int end)
+        {
+            AnfData<T, GraphType>* data = static_cast<AnfData<T, GraphType>*>(userData);
+            int nrRegisters = data->nrRegisters;
+            const std::vector<bool>& wasModified = *data->wasModified;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                const uint8_t* counter = &(*data->counters)[(size_t)nodeIt * nrRegisters];
+                uint8_t* nextCounter = &(*data->nextCounters)[(size_t)nodeIt * nrRegisters];
+                memcpy(nextCounter, counter, nrRegisters);
+                (*data->isModified)[nodeIt] = 0;
+
+                NeighborRange<T> neighbors = data->graph->Neighbors(nodeIt);
+                bool isNeeded = false;
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin(); edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    int neighbor = edgeIt.GetDestination();
+                    if(!wasModified[neighbor])
+                        continue;
+                    MaxRegisters(nextCounter, &(*data->counters)[(size_t)neighbor * nrRegisters], nrRegisters);
+                    isNeeded = true;
+                }
+                if(!isNeeded || memcmp(nextCounter, counter, nrRegisters) == 0)
+                    continue;
+                (*data->isModified)[nodeIt] = 1;
+                (*data->estimates)[nodeIt] = EstimateCount(nextCounter, nrRegisters);
+            }
+        }
+
+        template <typename T, typename GraphType>
+        static void EstimateNeighborhood(const GraphType& graph, int log2Registers, NeighborhoodFunction& result)
+        {
+            result.neighborhood.clear();
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            if(nrNodes == 0)
+                return;
+            log2Registers = std::min(std::max(log2Registers, 4), 16);
+            int nrRegisters = 1 << log2Registers;
+
+            std::vector<uint8_t> counters((size_t)nrNodes * nrRegisters, 0);
+            std::vector<uint8_t> nextCounters(counters.size());
+            std::vector<double> estimates(nrNodes, 0.0);
+            std::vector<bool> wasModified(nrNodes, false);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                // A hidden node keeps an empty counter, it has no edges so
+                // nothing ever merges into it or takes from it
+                if(!IsNodeVisible(graph, nodeIt))
+                    continue;
+                wasModified[nodeIt] = true;
+                // The top bits pick the register, the rank is the position of
+                // the first set bit in the rest
+                uint64_t hash = HashNodeId(nodeIt);
+                int registerIt = (int)(hash >> (64 - log2Registers));
+                uint64_t rest = (hash << log2Registers) | (uint64_t(1) << (log2Registers - 1));
+#if defined(__GNUC__)
+                int rank = __builtin_clzll(rest) + 1;
+#else
+                int rank = 1;
+                while(!(rest & (uint64_t(1) << 63)))
+                {
+                    rest <<= 1;
+                    ++rank;
+                }
+#endif
+                counters[(size_t)nodeIt * nrRegisters + registerIt] = (uint8_t)rank;
+                estimates[nodeIt] = EstimateCount(&counters[(size_t)nodeIt * nrRegisters], nrRegisters);
+            }
+
+            double total = 0.0;
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                total += estimates[nodeIt];
+            result.neighborhood.push_back(total);
+
+            std::vector<char> isModified(nrNodes, 0);
+            AnfData<T, GraphType> data;
+            data.graph = &graph;
+            data.wasModified = &wasModified;
+            data.isModified = &isModified;
+            data.estimates = &estimates;
+            data.nrRegisters = nrRegisters;
+            for(;;)
+            {
+                data.counters = &counters;
+                data.nextCounters = &nextCounters;
+                PParallelFor(0, nrNodes, 0, UnionNeighborCounters<T, GraphType>, &data);
+
+                bool isAnyModified = false;
+                total = 0.0;
+                for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                {
+                    wasModified[nodeIt] = isModified[nodeIt] != 0;
+                    isAnyModified |= wasModified[nodeIt];
+                    total += estimates[nodeIt];
+                }
+                if(!isAnyModified)
+                    break;
+                // Keep the function monotone, the estimates are noisy but the
+                // real balls only grow
+                result.neighborhood.push_back(std::max(total, result.neighborhood.back()));
+                counters.swap(nextCounters);
+            }
+        }
+    }
+
+    // HyperANF (Boldi, Rosa, Vigna): every node keeps a HyperLogLog counter
+    // of the nodes within t hops along its out edges. One pass over the
+    // edges turns radius t into t + 1 by taking the register wise max of a
+    // node's counter with its neighbors' ones, and the sum of the counter
+    // estimates is the neighborhood function at t. Passes run until no
+    // counter changes, that is the diameter plus one passes, and only the
+    // nodes next to a counter that changed are merged again.
+    // Counters take 2^log2Registers bytes per node twice, log2Registers
+    // goes from 4 to 16. The relative error of one counter is about
+    // 1.04 / sqrt(2^log2Registers), the sum over the nodes does better
+    template <typename T>
+    void ComputeNeighborhoodFunction(const Graph<T>& graph, int log2Registers, NeighborhoodFunction& result)
+    {
+        EstimateNeighborhood<T>(graph, log2Registers, result);
+    }
+
+    template <typename T>
+    void ComputeNeighborhoodFunction(const GraphView<T>& graph, int log2Registers, NeighborhoodFunction& result)
+    {
+        EstimateNeighborhood<T>(graph, log2Registers, result);
+    }
+
+    template <typename T>
+    void ComputeNeighborhoodFunction(const Graph<T>& graph, NeighborhoodFunction& result)
+    {
+        ComputeNeighborhoodFunction(graph, 7, result);
+    }
+
+    template <typename T>
+    void ComputeNeighborhoodFunction(const GraphView<T>& graph, NeighborhoodFunction& result)
+    {
+        ComputeNeighborhoodFunction(graph, 7, result);
+    }
+}
+
+#endif
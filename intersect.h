@@ -0,0 +1,153 @@
+#ifndef KWGRAPH_INTERSECT_H
+#define KWGRAPH_INTERSECT_H
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#    include <immintrin.h>
+#endif
+
+namespace KWGraph
+{
+    static inline int PopCount32(unsigned int value)
+    {
+#if defined(__GNUC__)
+        return __builtin_popcount(value);
+#else
+        int count = 0;
+        for(; value; value &= value - 1)
+            ++count;
+        return count;
+#endif
+    }
+
+    static inline int PopCount64(unsigned long long value)
+    {
+#if defined(__GNUC__)
+        return __builtin_popcountll(value);
+#else
+        int count = 0;
+        for(; value; value &= value - 1)
+            ++count;
+        return count;
+#endif
+    }
+
+    // Use when only the size of the intersection is needed, the calls get
+    // inlined away
+    struct IgnoreMatches
+    {
+        inline void operator()(int) const {}
+    };
+
+    namespace
+    {
+        template <typename OnMatch>
+        static inline void ReportMatches(const int* block, unsigned int mask, OnMatch& onMatch)
+        {
+            while(mask)
+            {
+#if defined(__GNUC__)
+                int bit = __builtin_ctz(mask);
+#else
+                int bit = 0;
+                while(!(mask & (1u << bit)))
+                    ++bit;
+#endif
+                onMatch(block[bit]);
+                mask &= mask - 1;
+            }
+        }
+    }
+
+    // Counts the values two strictly increasing lists have in common and
+    // calls onMatch for each of them. Blocks of 8 (AVX2) or 4 (SSE2) values
+    // from both lists are compared all against all by rotating one of them,
+    // the block with the smaller last value is the one that moves on. The
+    // tails are merged the usual way
+    template <typename OnMatch>
+    static inline long long IntersectSorted(const int* first, int firstSize,
+                                            const int* second, int secondSize,
+                                            OnMatch& onMatch)
+    {
+        long long count = 0;
+        int firstIt = 0;
+        int secondIt = 0;
+
+#if defined(__AVX2__)
+        const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+        while(firstIt + 8 <= firstSize && secondIt + 8 <= secondSize)
+        {
+            __m256i firstBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + firstIt));
+            __m256i secondBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + secondIt));
+            __m256i matches = _mm256_cmpeq_epi32(firstBlock, secondBlock);
+            for(int rotationIt = 1; rotationIt < 8; ++rotationIt)
+            {
+                secondBlock = _mm256_permutevar8x32_epi32(secondBlock, rotate);
+                matches = _mm256_or_si256(matches, _mm256_cmpeq_epi32(firstBlock, secondBlock));
+            }
+            unsigned int mask = _mm256_movemask_ps(_mm256_castsi256_ps(matches));
+            count += PopCount32(mask);
+            ReportMatches(first + firstIt, mask, onMatch);
+
+            int firstLast = first[firstIt + 7];
+            int secondLast = second[secondIt + 7];
+            if(firstLast <= secondLast)
+                firstIt += 8;
+            if(secondLast <= firstLast)
+                secondIt += 8;
+        }
+#endif
+
+#if defined(__SSE2__)
+        while(firstIt + 4 <= firstSize && secondIt + 4 <= secondSize)
+        {
+            __m128i firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + firstIt));
+            __m128i secondBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + secondIt));
+            __m128i matches = _mm_cmpeq_epi32(firstBlock, secondBlock);
+            secondBlock = _mm_shuffle_epi32(secondBlock, _MM_SHUFFLE(0, 3, 2, 1));
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi32(firstBlock, secondBlock));
+            secondBlock = _mm_shuffle_epi32(secondBlock, _MM_SHUFFLE(0, 3, 2, 1));
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi32(firstBlock, secondBlock));
+            secondBlock = _mm_shuffle_epi32(secondBlock, _MM_SHUFFLE(0, 3, 2, 1));
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi32(firstBlock, secondBlock));
+            unsigned int mask = _mm_movemask_ps(_mm_castsi128_ps(matches));
+            count += PopCount32(mask);
+            ReportMatches(first + firstIt, mask, onMatch);
+
+            int firstLast = first[firstIt + 3];
+            int secondLast = second[secondIt + 3];
+            if(firstLast <= secondLast)
+                firstIt += 4;
+            if(secondLast <= firstLast)
+                secondIt += 4;
+        }
+#endif
+
+        while(firstIt < firstSize && secondIt < secondSize)
+        {
+            int firstValue = first[firstIt];
+            int secondValue = second[secondIt];
+            if(firstValue == secondValue)
+            {
+                ++count;
+                onMatch(firstValue);
+            }
+            // Branchless advance, the comparison outcome is close to random
+            // so a branch here would mispredict a lot
+            firstIt += (firstValue <= secondValue);
+            secondIt += (secondValue <= firstValue);
+        }
+        return count;
+    }
+
+    static inline long long IntersectSortedSize(const int* first, int firstSize,
+                                                const int* second, int secondSize)
+    {
+        IgnoreMatches ignore;
+        return IntersectSorted(first, firstSize, second, secondSize, ignore);
+    }
+}
+
+#endif
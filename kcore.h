@@ -0,0 +1,214 @@
+#ifndef KWGRAPH_KCORE_H
+#define KWGRAPH_KCORE_H
+
+#include <atomic>
+#include "adjacency.h"
+
+namespace KWGraph
+{
+    // The k-core is the largest subgraph where every node has at least k
+    // neighbors, the core number of a node is the largest k whose core still
+    // holds it. Edges are treated as undirected, see SymmetricAdjacency.
+
+    namespace
+    {
+        template <typename T>
+        struct CoreIterationData
+        {
+            const SymmetricAdjacency<T>*            adjacency;
+            std::vector< std::atomic<int> >*        coreness;
+            // Nodes that need a new h-index this round and the next one
+            std::vector< std::atomic<unsigned char> >* isDirty;
+            std::vector< std::atomic<unsigned char> >* isNextDirty;
+            std::atomic<int>*                       nrChanged;
+        };
+
+        // Every node takes the h-index of its neighbors' core estimates, the
+        // largest h such that h neighbors have an estimate of at least h.
+        // Starting from the degrees the estimates only go down and settle
+        // on the core numbers. Nodes read estimates that other workers are
+        // updating, which is fine since any mix of old and new values still
+        // converges, it just saves rounds
+        template <typename T>
+        static void UpdateCoreEstimates(void* userData, int begin, int end)
+        {
+            CoreIterationData<T>* data = static_cast<CoreIterationData<T>*>(userData);
+            const SymmetricAdjacency<T>& adjacency = *data->adjacency;
+            std::vector< std::atomic<int> >& coreness = *data->coreness;
+            std::vector<int> counts;
+            int nrChanged = 0;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                if(!(*data->isDirty)[nodeIt].load(std::memory_order_relaxed))
+                    continue;
+                (*data->isDirty)[nodeIt].store(0, std::memory_order_relaxed);
+
+                int estimate = coreness[nodeIt].load(std::memory_order_relaxed);
+                if(estimate == 0)
+                    continue;
+
+                const int* neighbors = adjacency.GetNeighbors(nodeIt);
+                int degree = adjacency.GetDegree(nodeIt);
+                counts.assign(estimate + 1, 0);
+                for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+                {
+                    int neighborEstimate = coreness[neighbors[neighborIt]].load(std::memory_order_relaxed);
+                    ++counts[std::min(neighborEstimate, estimate)];
+                }
+
+                int hIndex = estimate;
+                int nrAtLeast = counts[estimate];
+                while(hIndex > 0 && nrAtLeast < hIndex)
+                {
+                    --hIndex;
+                    nrAtLeast += counts[hIndex];
+                }
+
+                if(hIndex < estimate)
+                {
+                    coreness[nodeIt].store(hIndex, std::memory_order_relaxed);
+                    ++nrChanged;
+                    for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+                        (*data->isNextDirty)[neighbors[neighborIt]].store(1, std::memory_order_relaxed);
+                }
+            }
+            if(nrChanged)
+                data->nrChanged->fetch_add(nrChanged, std::memory_order_relaxed);
+        }
+    }
+
+    // Parallel h-index iteration (Lu et al.). Only the neighbors of nodes
+    // whose estimate dropped get recomputed in the following round
+    template <typename T>
+    void ComputeCoreNumbers(const SymmetricAdjacency<T>& adjacency, std::vector<int>& coreNumbers)
+    {
+        int nrNodes = static_cast<int>(adjacency.GetNrNodes());
+        coreNumbers.resize(nrNodes);
+        if(nrNodes == 0)
+            return;
+
+        std::vector< std::atomic<int> > coreness(nrNodes);
+        std::vector< std::atomic<unsigned char> > isDirty(nrNodes);
+        std::vector< std::atomic<unsigned char> > isNextDirty(nrNodes);
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+        {
+            coreness[nodeIt].store(adjacency.GetDegree(nodeIt), std::memory_order_relaxed);
+            isDirty[nodeIt].store(1, std::memory_order_relaxed);
+            isNextDirty[nodeIt].store(0, std::memory_order_relaxed);
+        }
+
+        std::atomic<int> nrChanged(0);
+        CoreIterationData<T> data;
+        data.adjacency = &adjacency;
+        data.coreness = &coreness;
+        data.isDirty = &isDirty;
+        data.isNextDirty = &isNextDirty;
+        data.nrChanged = &nrChanged;
+        do
+        {
+            nrChanged.store(0);
+            PParallelFor(0, nrNodes, 0, UpdateCoreEstimates<T>, &data);
+            std::swap(data.isDirty, data.isNextDirty);
+        }
+        while(nrChanged.load() > 0);
+
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            coreNumbers[nodeIt] = coreness[nodeIt].load(std::memory_order_relaxed);
+    }
+
+    // Serial bucket peeling (Batagelj and Zaversnik), O(nodes + edges).
+    // Repeatedly removes the node with the smallest remaining degree, its
+    // degree at the time is its core number
+    template <typename T>
+    void ComputeCoreNumbersPeeling(const SymmetricAdjacency<T>& adjacency, std::vector<int>& coreNumbers)
+    {
+        int nrNodes = static_cast<int>(adjacency.GetNrNodes());
+        coreNumbers.resize(nrNodes);
+        if(nrNodes == 0)
+            return;
+
+        int maxDegree = 0;
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+        {
+            coreNumbers[nodeIt] = adjacency.GetDegree(nodeIt);
+            maxDegree = std::max(maxDegree, coreNumbers[nodeIt]);
+        }
+
+        // Nodes sorted by degree, bucketStart[d] is where degree d starts
+        std::vector<int> bucketStart(maxDegree + 2, 0);
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            ++bucketStart[coreNumbers[nodeIt] + 1];
+        for(int degreeIt = 0; degreeIt <= maxDegree; ++degreeIt)
+            bucketStart[degreeIt + 1] += bucketStart[degreeIt];
+
+        std::vector<int> order(nrNodes);
+        std::vector<int> position(nrNodes);
+        std::vector<int> fill(bucketStart.begin(), bucketStart.end() - 1);
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+        {
+            position[nodeIt] = fill[coreNumbers[nodeIt]]++;
+            order[position[nodeIt]] = nodeIt;
+        }
+
+        for(int orderIt = 0; orderIt < nrNodes; ++orderIt)
+        {
+            int node = order[orderIt];
+            const int* neighbors = adjacency.GetNeighbors(node);
+            int degree = adjacency.GetDegree(node);
+            for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+            {
+                int neighbor = neighbors[neighborIt];
+                int neighborDegree = coreNumbers[neighbor];
+                if(neighborDegree <= coreNumbers[node])
+                    continue;
+
+                // Swap the neighbor with the first node of its bucket and
+                // shrink the bucket by one, which moves it a degree down
+                int firstPosition = bucketStart[neighborDegree];
+                int firstNode = order[firstPosition];
+                if(firstNode != neighbor)
+                {
+                    std::swap(order[firstPosition], order[position[neighbor]]);
+                    position[firstNode] = position[neighbor];
+                    position[neighbor] = firstPosition;
+                }
+                ++bucketStart[neighborDegree];
+                --coreNumbers[neighbor];
+            }
+        }
+    }
+
+    template <typename T>
+    void ComputeCoreNumbers(const Graph<T>& graph, std::vector<int>& coreNumbers)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        ComputeCoreNumbers(adjacency, coreNumbers);
+    }
+
+    template <typename T>
+    void ComputeCoreNumbers(const GraphView<T>& graph, std::vector<int>& coreNumbers)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        ComputeCoreNumbers(adjacency, coreNumbers);
+    }
+
+    template <typename T>
+    void ComputeCoreNumbersPeeling(const Graph<T>& graph, std::vector<int>& coreNumbers)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        ComputeCoreNumbersPeeling(adjacency, coreNumbers);
+    }
+
+    template <typename T>
+    void ComputeCoreNumbersPeeling(const GraphView<T>& graph, std::vector<int>& coreNumbers)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        ComputeCoreNumbersPeeling(adjacency, coreNumbers);
+    }
+}
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef KWGRAPH_KHOP_H
+#define KWGRAPH_KHOP_H
+
+#include "graphview.h"
+
+namespace KWGraph
+{
+    template <typename T>
+    struct KHopConfig
+    {
+        KHopConfig() :
+            maxHops(1),
+            maxWeight(T(0)),
+            isWeightLimited(false),
+            maxNodesPerHop(0) {}
+
+        // Nodes more than maxHops edges away from every seed are left out
+        int     maxHops;
+        // With isWeightLimited a node is only kept if some path of at most
+        // maxHops edges from a seed weighs at most maxWeight
+        T       maxWeight;
+        bool    isWeightLimited;
+        // At most this many new nodes per hop, in the order they are found.
+        // The ones over the cap are dropped for good. 0 means no cap
+        int     maxNodesPerHop;
+    };
+
+    template <typename T>
+    struct KHopNeighborhood
+    {
+        // Seeds first, then the nodes one hop away and so on
+        std::vector<int>    nodes;
+        // Hop i is nodes[hopOffsets[i]] .. nodes[hopOffsets[i + 1]], a node
+        // is on the first hop it was kept at
+        std::vector<int>    hopOffsets;
+        // Aligned with nodes, the lightest path weight within maxHops edges.
+        // Only filled when the config is weight limited
+        std::vector<T>      weights;
+
+        inline int GetNrHops() const { return hopOffsets.empty() ? 0 : (int)hopOffsets.size() - 1; }
+    };
+
+    // Bounded traversal around one or more seeds along the out edges, for
+    // ego networks and k-hop sampling. Without a weight budget it is a BFS
+    // that stops at maxHops. With one it runs maxHops Bellman-Ford rounds,
+    // each only relaxing the out edges of the nodes that got lighter in the
+    // previous round, so a node that is over budget at some hop can still
+    // come in later through a longer but lighter path. Per query state is
+    // stamped like TraversalWorkspace so a small neighborhood in a large
+    // graph costs nothing for the nodes it doesn't reach. GraphType can also
+    // be a GraphView, hidden nodes and edges are then never crossed.
+    // NOTE: Not thread safe, use one extractor per thread
+    template <typename T, typename GraphType = Graph<T> >
+    class KHopExtractor
+    {
+    private:
+        const GraphType*            m_graph;
+        // A node's state is valid when its stamp matches m_stamp
+        std::vector<unsigned int>   m_stamps;
+        unsigned int                m_stamp;
+        // Position in the result nodes, INVALID_ID for nodes dropped by
+        // the hop cap
+        std::vector<int>            m_slots;
+        std::vector<T>              m_weights;
+        // Round in which a node was last put on m_changed
+        std::vector<int>            m_changedRounds;
+        std::vector<int>            m_changed;
+        // Weights of m_changed when the round started, a node that gets
+        // lighter during a round must not pass that on in the same round
+        std::vector<T>              m_changedWeights;
+        std::vector<int>            m_nextChanged;
+
+        KHopExtractor(const KHopExtractor&);
+        KHopExtractor& operator=(const KHopExtractor&);
+
+        void NextStamp()
+        {
+            size_t nrNodes = m_graph->GetNrNodes();
+            if(m_stamps.size() != nrNodes)
+            {
+                m_stamps.assign(nrNodes, 0);
+                m_slots.resize(nrNodes);
+                m_weights.resize(nrNodes);
+                m_changedRounds.resize(nrNodes);
+                m_stamp = 0;
+            }
+            if(++m_stamp == 0)
+            {
+                std::fill(m_stamps.begin(), m_stamps.end(), 0);
+                m_stamp = 1;
+            }
+        }
+
+        inline bool IsReached(int id) const { return m_stamps[id] == m_stamp; }
+
+        inline void Reach(int id, int slot, T weight, int round)
+        {
+            m_stamps[id] = m_stamp;
+            m_slots[id] = slot;
+            m_weights[id] = weight;
+            m_changedRounds[id] = round;
+        }
+
+    public:
+        explicit KHopExtractor(const GraphType* graph) :
+            m_graph(graph),
+            m_stamp(0) {}
+
+        void Extract(const std::vector<int>& seeds, const KHopConfig<T>& config, KHopNeighborhood<T>& result)
+        {
+            result.nodes.clear();
+            result.hopOffsets.assign(1, 0);
+            result.weights.clear();
+            NextStamp();
+            m_changed.clear();
+
+            int nrNodes = static_cast<int>(m_graph->GetNrNodes());
+            for(size_t seedIt = 0; seedIt < seeds.size(); ++seedIt)
+            {
+                int seed = seeds[seedIt];
+                if(seed < 0 || seed >= nrNodes || IsReached(seed))
+                    continue;
+                Reach(seed, (int)result.nodes.size(), T(0), 0);
+                result.nodes.push_back(seed);
+                m_changed.push_back(seed);
+            }
+            result.hopOffsets.push_back((int)result.nodes.size());
+            if(result.nodes.empty())
+            {
+                result.hopOffsets.resize(1);
+                return;
+            }
+
+            for(int hopIt = 1; hopIt <= config.maxHops && !m_changed.empty(); ++hopIt)
+            {
+                int nrNewNodes = 0;
+                m_nextChanged.clear();
+                m_changedWeights.resize(m_changed.size());
+                for(size_t changedIt = 0; changedIt < m_changed.size(); ++changedIt)
+                    m_changedWeights[changedIt] = m_weights[m_changed[changedIt]];
+                for(size_t changedIt = 0; changedIt < m_changed.size(); ++changedIt)
+                {
+                    int crNodeId = m_changed[changedIt];
+                    T crWeight = m_changedWeights[changedIt];
+                    NeighborRange<T> neighbors = m_graph->Neighbors(crNodeId);
+                    for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                        edgeIt != neighbors.end(); ++edgeIt)
+                    {
+                        NeighborView<T> edge = *edgeIt;
+                        T weight = crWeight + edge.weight;
+                        if(config.isWeightLimited && config.maxWeight < weight)
+                            continue;
+                        if(IsReached(edge.destination))
+                        {
+                            // Only lighter paths matter and only with a budget
+                            int slot = m_slots[edge.destination];
+                            if(!config.isWeightLimited || slot == INVALID_ID || !(weight < m_weights[edge.destination]))
+                                continue;
+                            m_weights[edge.destination] = weight;
+                            if(m_changedRounds[edge.destination] != hopIt)
+                            {
+                                m_changedRounds[edge.destination] = hopIt;
+                                m_nextChanged.push_back(edge.destination);
+                            }
+                            continue;
+                        }
+
+                        if(config.maxNodesPerHop > 0 && nrNewNodes >= config.maxNodesPerHop)
+                        {
+                            Reach(edge.destination, INVALID_ID, weight, hopIt);
+                            continue;
+                        }
+                        ++nrNewNodes;
+                        Reach(edge.destination, (int)result.nodes.size(), weight, hopIt);
+                        result.nodes.push_back(edge.destination);
+                        m_nextChanged.push_back(edge.destination);
+                    }
+                }
+                result.hopOffsets.push_back((int)result.nodes.size());
+                m_changed.swap(m_nextChanged);
+            }
+            // Hops that found nothing new are trimmed
+            while(result.hopOffsets.size() > 2 &&
+                  result.hopOffsets[result.hopOffsets.size() - 1] == result.hopOffsets[result.hopOffsets.size() - 2])
+                result.hopOffsets.pop_back();
+
+            if(config.isWeightLimited)
+            {
+                result.weights.resize(result.nodes.size());
+                for(size_t nodeIt = 0; nodeIt < result.nodes.size(); ++nodeIt)
+                    result.weights[nodeIt] = m_weights[result.nodes[nodeIt]];
+            }
+        }
+
+        void Extract(int seed, const KHopConfig<T>& config, KHopNeighborhood<T>& result)
+        {
+            std::vector<int> seeds(1, seed);
+            Extract(seeds, config, result);
+        }
+
+        // Copies the subgraph induced by nodes into a new compact graph,
+        // node i of subgraph is nodes[i] with its weight and position. Every
+        // stored edge between two of the nodes is copied once with its
+        // direction, so an edge added in both directions stays that way.
+        // Duplicate and invalid ids in nodes are skipped
+        void ExtractSubgraph(const std::vector<int>& nodes, Graph<T>& subgraph)
+        {
+            NextStamp();
+            subgraph = Graph<T>();
+            int nrNodes = static_cast<int>(m_graph->GetNrNodes());
+            std::vector<int> kept;
+            for(size_t nodeIt = 0; nodeIt < nodes.size(); ++nodeIt)
+            {
+                int nodeId = nodes[nodeIt];
+                if(nodeId < 0 || nodeId >= nrNodes || IsReached(nodeId))
+                    continue;
+                Reach(nodeId, (int)kept.size(), T(0), 0);
+                kept.push_back(nodeId);
+
+                Node<T> node = m_graph->GetNodes()[nodeId];
+                node.id = static_cast<int>(subgraph.GetNrNodes());
+                node.edges.clear();
+                node.parent = INVALID_ID;
+                subgraph.AddNode(node);
+            }
+            for(size_t nodeIt = 0; nodeIt < kept.size(); ++nodeIt)
+            {
+                NeighborRange<T> neighbors = m_graph->Neighbors(kept[nodeIt]);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    NeighborView<T> edge = *edgeIt;
+                    if(IsReached(edge.destination))
+                        subgraph.AddListEdge((int)nodeIt, m_slots[edge.destination], edge.weight, false);
+                }
+            }
+        }
+
+        // The neighborhood and its induced subgraph in one go, subgraph node
+        // i is result.nodes[i]
+        void ExtractSubgraph(const std::vector<int>& seeds, const KHopConfig<T>& config,
+                             KHopNeighborhood<T>& result, Graph<T>& subgraph)
+        {
+            Extract(seeds, config, result);
+            ExtractSubgraph(result.nodes, subgraph);
+        }
+    };
+
+    typedef KHopExtractor<int> IntKHopExtractor;
+    typedef KHopExtractor<float> FloatKHopExtractor;
+}
+
+#endif
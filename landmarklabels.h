@@ -0,0 +1,388 @@
+#ifndef KWGRAPH_LANDMARK_LABELS_H
+#define KWGRAPH_LANDMARK_LABELS_H
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdint.h>
+#include "adjacency.h"
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+namespace KWGraph
+{
+    static const char LANDMARK_LABELS_MAGIC[8] = {'K', 'W', 'P', 'L', 'L', '0', '0', '1'};
+
+    // File layout: the header, then nrNodes + 1 int32 offsets, nrEntries
+    // int32 hubs and nrEntries int32 distances, in the byte order of the
+    // machine that wrote it
+    struct LandmarkLabelsFileHeader
+    {
+        char        magic[8];
+        uint64_t    nrNodes;
+        uint64_t    nrEntries;
+    };
+
+    namespace
+    {
+        // Shortest distance through a hub both labels share, INT_MAX if
+        // there is none. Hubs are strictly increasing, the blocks are
+        // compared all against all like IntersectSorted and the distances
+        // are only looked at for the few matches
+        static inline int MinLabelDistance(const int* firstHubs, const int* firstDistances, int firstSize,
+                                           const int* secondHubs, const int* secondDistances, int secondSize)
+        {
+            int best = INT_MAX;
+            int firstIt = 0;
+            int secondIt = 0;
+
+#if defined(__SSE2__)
+            while(firstIt + 4 <= firstSize && secondIt + 4 <= secondSize)
+            {
+                __m128i firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(firstHubs + firstIt));
+                __m128i secondBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secondHubs + secondIt));
+                __m128i matches = _mm_cmpeq_epi32(firstBlock, secondBlock);
+                secondBlock = _mm_shuffle_epi32(secondBlock, _MM_SHUFFLE(0, 3, 2, 1));
+                matches = _mm_or_si128(matches, _mm_cmpeq_epi32(firstBlock, secondBlock));
+                secondBlock = _mm_shuffle_epi32(secondBlock, _MM_SHUFFLE(0, 3, 2, 1));
+                matches = _mm_or_si128(matches, _mm_cmpeq_epi32(firstBlock, secondBlock));
+                secondBlock = _mm_shuffle_epi32(secondBlock, _MM_SHUFFLE(0, 3, 2, 1));
+                matches = _mm_or_si128(matches, _mm_cmpeq_epi32(firstBlock, secondBlock));
+                unsigned int mask = _mm_movemask_ps(_mm_castsi128_ps(matches));
+                while(mask)
+                {
+#if defined(__GNUC__)
+                    int bit = __builtin_ctz(mask);
+#else
+                    int bit = 0;
+                    while(!(mask & (1u << bit)))
+                        ++bit;
+#endif
+                    mask &= mask - 1;
+                    int hub = firstHubs[firstIt + bit];
+                    int secondSlot = secondIt;
+                    while(secondHubs[secondSlot] != hub)
+                        ++secondSlot;
+                    best = std::min(best, firstDistances[firstIt + bit] + secondDistances[secondSlot]);
+                }
+
+                int firstLast = firstHubs[firstIt + 3];
+                int secondLast = secondHubs[secondIt + 3];
+                if(firstLast <= secondLast)
+                    firstIt += 4;
+                if(secondLast <= firstLast)
+                    secondIt += 4;
+            }
+#endif
+
+            while(firstIt < firstSize && secondIt < secondSize)
+            {
+                int firstHub = firstHubs[firstIt];
+                int secondHub = secondHubs[secondIt];
+                if(firstHub == secondHub)
+                    best = std::min(best, firstDistances[firstIt] + secondDistances[secondIt]);
+                firstIt += (firstHub <= secondHub);
+                secondIt += (secondHub <= firstHub);
+            }
+            return best;
+        }
+
+        // Largest number of roots searched at the same time. Early roots
+        // prune the most, so batches grow with the number of roots done
+        static const int s_maxLabelBatch = 256;
+
+        struct LabelSearchWorkspace
+        {
+            // Distance from the root to every hub of its label, by hub rank
+            std::vector<int>    rootHubDistances;
+            std::vector<int>    distances;
+            std::vector<int>    queue;
+        };
+    }
+
+    // Exact distance oracle for unweighted graphs, pruned landmark labeling
+    // (Akiba, Iwata, Yoshida). Every node gets a label of (hub, distance)
+    // pairs such that for any two connected nodes some shortest path goes
+    // through a hub both labels share, so a query is a merge of two short
+    // sorted lists. Hubs are processed by decreasing degree and the BFS
+    // from a hub stops at nodes the labels built so far already answer.
+    // The BFS from a batch of hubs runs in parallel, each one only pruning
+    // against the labels of earlier batches. That adds a few entries
+    // compared to the sequential order but stays exact. Edges are
+    // treated as undirected and their weights ignored, see
+    // SymmetricAdjacency.
+    class PrunedLandmarkLabeling
+    {
+    private:
+        // Label of node i is m_hubs/m_distances[m_offsets[i]] .. [m_offsets[i + 1]],
+        // hubs are ranks and sorted
+        std::vector<int>    m_offsets;
+        std::vector<int>    m_hubs;
+        std::vector<int>    m_distances;
+
+        template <typename T>
+        struct BuildData
+        {
+            const SymmetricAdjacency<T>*            adjacency;
+            const std::vector<int>*                 order;
+            const std::vector< std::vector<int> >*  labelHubs;
+            const std::vector< std::vector<int> >*  labelDistances;
+            // Label entries found by the root with rank batchBegin + i, as
+            // (node, distance)
+            std::vector< std::vector< std::pair<int, int> > >* batchEntries;
+            int                                     batchBegin;
+
+            std::mutex                              workspaceLock;
+            std::vector<LabelSearchWorkspace*>      freeWorkspaces;
+        };
+
+        template <typename T>
+        static LabelSearchWorkspace* AcquireWorkspace(BuildData<T>* data)
+        {
+            std::lock_guard<std::mutex> guard(data->workspaceLock);
+            if(data->freeWorkspaces.empty())
+            {
+                int nrNodes = static_cast<int>(data->adjacency->GetNrNodes());
+                LabelSearchWorkspace* workspace = new LabelSearchWorkspace();
+                workspace->rootHubDistances.assign(nrNodes, INT_MAX);
+                workspace->distances.assign(nrNodes, -1);
+                return workspace;
+            }
+            LabelSearchWorkspace* workspace = data->freeWorkspaces.back();
+            data->freeWorkspaces.pop_back();
+            return workspace;
+        }
+
+        template <typename T>
+        static void ReleaseWorkspace(BuildData<T>* data, LabelSearchWorkspace* workspace)
+        {
+            std::lock_guard<std::mutex> guard(data->workspaceLock);
+            data->freeWorkspaces.push_back(workspace);
+        }
+
+        template <typename T>
+        static void PrunedSearch(BuildData<T>* data, int rank, LabelSearchWorkspace& workspace)
+        {
+            const SymmetricAdjacency<T>& adjacency = *data->adjacency;
+            const std::vector< std::vector<int> >& labelHubs = *data->labelHubs;
+            const std::vector< std::vector<int> >& labelDistances = *data->labelDistances;
+            std::vector< std::pair<int, int> >& entries = (*data->batchEntries)[rank - data->batchBegin];
+            int root = (*data->order)[rank];
+
+            const std::vector<int>& rootHubs = labelHubs[root];
+            for(size_t entryIt = 0; entryIt < rootHubs.size(); ++entryIt)
+                workspace.rootHubDistances[rootHubs[entryIt]] = labelDistances[root][entryIt];
+
+            workspace.queue.clear();
+            workspace.queue.push_back(root);
+            workspace.distances[root] = 0;
+            for(size_t queueIt = 0; queueIt < workspace.queue.size(); ++queueIt)
+            {
+                int crNodeId = workspace.queue[queueIt];
+                int distance = workspace.distances[crNodeId];
+                const std::vector<int>& hubs = labelHubs[crNodeId];
+                bool isCovered = false;
+                for(size_t entryIt = 0; entryIt < hubs.size() && !isCovered; ++entryIt)
+                {
+                    int rootDistance = workspace.rootHubDistances[hubs[entryIt]];
+                    isCovered = rootDistance != INT_MAX && rootDistance + labelDistances[crNodeId][entryIt] <= distance;
+                }
+                if(isCovered)
+                    continue;
+
+                entries.push_back(std::make_pair(crNodeId, distance));
+                const int* neighbors = adjacency.GetNeighbors(crNodeId);
+                for(int neighborIt = 0; neighborIt < adjacency.GetDegree(crNodeId); ++neighborIt)
+                {
+                    int neighbor = neighbors[neighborIt];
+                    if(workspace.distances[neighbor] != -1)
+                        continue;
+                    workspace.distances[neighbor] = distance + 1;
+                    workspace.queue.push_back(neighbor);
+                }
+            }
+
+            for(size_t queueIt = 0; queueIt < workspace.queue.size(); ++queueIt)
+                workspace.distances[workspace.queue[queueIt]] = -1;
+            for(size_t entryIt = 0; entryIt < rootHubs.size(); ++entryIt)
+                workspace.rootHubDistances[rootHubs[entryIt]] = INT_MAX;
+        }
+
+        template <typename T>
+        static void RunPrunedSearches(void* userData, int begin, int end)
+        {
+            BuildData<T>* data = static_cast<BuildData<T>*>(userData);
+            LabelSearchWorkspace* workspace = AcquireWorkspace(data);
+            for(int rankIt = begin; rankIt < end; ++rankIt)
+                PrunedSearch(data, rankIt, *workspace);
+            ReleaseWorkspace(data, workspace);
+        }
+
+    public:
+        PrunedLandmarkLabeling() {}
+
+        template <typename T>
+        void Build(const SymmetricAdjacency<T>& adjacency)
+        {
+            int nrNodes = static_cast<int>(adjacency.GetNrNodes());
+            std::vector<int> order(nrNodes);
+            std::vector< std::pair<int, int> > degrees(nrNodes);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                degrees[nodeIt] = std::make_pair(-adjacency.GetDegree(nodeIt), nodeIt);
+            std::sort(degrees.begin(), degrees.end());
+            for(int rankIt = 0; rankIt < nrNodes; ++rankIt)
+                order[rankIt] = degrees[rankIt].second;
+
+            std::vector< std::vector<int> > labelHubs(nrNodes);
+            std::vector< std::vector<int> > labelDistances(nrNodes);
+            std::vector< std::vector< std::pair<int, int> > > batchEntries;
+            BuildData<T> data;
+            data.adjacency = &adjacency;
+            data.order = &order;
+            data.labelHubs = &labelHubs;
+            data.labelDistances = &labelDistances;
+            data.batchEntries = &batchEntries;
+
+            int nrDone = 0;
+            while(nrDone < nrNodes)
+            {
+                int batchSize = std::min(nrNodes - nrDone, std::max(1, std::min(nrDone / 4, s_maxLabelBatch)));
+                batchEntries.assign(batchSize, std::vector< std::pair<int, int> >());
+                data.batchBegin = nrDone;
+                if(batchSize == 1)
+                    RunPrunedSearches<T>(&data, nrDone, nrDone + 1);
+                else
+                    PParallelFor(nrDone, nrDone + batchSize, 1, RunPrunedSearches<T>, &data);
+
+                // Ranks go up so the labels stay sorted
+                for(int batchIt = 0; batchIt < batchSize; ++batchIt)
+                {
+                    const std::vector< std::pair<int, int> >& entries = batchEntries[batchIt];
+                    for(size_t entryIt = 0; entryIt < entries.size(); ++entryIt)
+                    {
+                        labelHubs[entries[entryIt].first].push_back(nrDone + batchIt);
+                        labelDistances[entries[entryIt].first].push_back(entries[entryIt].second);
+                    }
+                }
+                nrDone += batchSize;
+            }
+            for(size_t workspaceIt = 0; workspaceIt < data.freeWorkspaces.size(); ++workspaceIt)
+                delete data.freeWorkspaces[workspaceIt];
+
+            m_offsets.assign(nrNodes + 1, 0);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                m_offsets[nodeIt + 1] = m_offsets[nodeIt] + (int)labelHubs[nodeIt].size();
+            m_hubs.resize(m_offsets[nrNodes]);
+            m_distances.resize(m_offsets[nrNodes]);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                std::copy(labelHubs[nodeIt].begin(), labelHubs[nodeIt].end(), m_hubs.begin() + m_offsets[nodeIt]);
+                std::copy(labelDistances[nodeIt].begin(), labelDistances[nodeIt].end(),
+                          m_distances.begin() + m_offsets[nodeIt]);
+            }
+        }
+
+        template <typename T>
+        void Build(const Graph<T>& graph)
+        {
+            SymmetricAdjacency<T> adjacency;
+            BuildSymmetricAdjacency(graph, adjacency);
+            Build(adjacency);
+        }
+
+        template <typename T>
+        void Build(const GraphView<T>& graph)
+        {
+            SymmetricAdjacency<T> adjacency;
+            BuildSymmetricAdjacency(graph, adjacency);
+            Build(adjacency);
+        }
+
+        inline int GetNrNodes() const { return m_offsets.empty() ? 0 : (int)m_offsets.size() - 1; }
+        inline size_t GetNrLabelEntries() const { return m_hubs.size(); }
+
+        // Number of edges on a shortest path, -1 if there is none. Safe to
+        // call from several threads
+        int GetDistance(int source, int destination) const
+        {
+            int nrNodes = GetNrNodes();
+            if(source < 0 || source >= nrNodes || destination < 0 || destination >= nrNodes)
+                return -1;
+            if(source == destination)
+                return 0;
+            int sourceBegin = m_offsets[source];
+            int destinationBegin = m_offsets[destination];
+            int distance = MinLabelDistance(m_hubs.data() + sourceBegin, m_distances.data() + sourceBegin,
+                                            m_offsets[source + 1] - sourceBegin,
+                                            m_hubs.data() + destinationBegin, m_distances.data() + destinationBegin,
+                                            m_offsets[destination + 1] - destinationBegin);
+            return distance == INT_MAX ? -1 : distance;
+        }
+
+        bool Save(const char* path) const
+        {
+            FILE* file = fopen(path, "wb");
+            if(file == NULL)
+                return false;
+            LandmarkLabelsFileHeader header;
+            memcpy(header.magic, LANDMARK_LABELS_MAGIC, sizeof(header.magic));
+            header.nrNodes = GetNrNodes();
+            header.nrEntries = m_hubs.size();
+            bool isWritten = fwrite(&header, sizeof(header), 1, file) == 1;
+            if(isWritten && !m_offsets.empty())
+                isWritten = fwrite(&m_offsets[0], sizeof(int), m_offsets.size(), file) == m_offsets.size();
+            if(isWritten && !m_hubs.empty())
+            {
+                isWritten = fwrite(&m_hubs[0], sizeof(int), m_hubs.size(), file) == m_hubs.size() &&
+                            fwrite(&m_distances[0], sizeof(int), m_distances.size(), file) == m_distances.size();
+            }
+            return fclose(file) == 0 && isWritten;
+        }
+
+        // Leaves the labeling empty and returns false if the file is not a
+        // complete index
+        bool Load(const char* path)
+        {
+            m_offsets.clear();
+            m_hubs.clear();
+            m_distances.clear();
+            FILE* file = fopen(path, "rb");
+            if(file == NULL)
+                return false;
+            LandmarkLabelsFileHeader header;
+            bool isRead = fread(&header, sizeof(header), 1, file) == 1 &&
+                          memcmp(header.magic, LANDMARK_LABELS_MAGIC, sizeof(header.magic)) == 0 &&
+                          header.nrNodes < (uint64_t)INT_MAX && header.nrEntries < (uint64_t)INT_MAX;
+            if(isRead && header.nrNodes > 0)
+            {
+                m_offsets.resize(header.nrNodes + 1);
+                isRead = fread(&m_offsets[0], sizeof(int), m_offsets.size(), file) == m_offsets.size();
+            }
+            if(isRead && header.nrEntries > 0)
+            {
+                m_hubs.resize(header.nrEntries);
+                m_distances.resize(header.nrEntries);
+                isRead = fread(&m_hubs[0], sizeof(int), m_hubs.size(), file) == m_hubs.size() &&
+                         fread(&m_distances[0], sizeof(int), m_distances.size(), file) == m_distances.size();
+            }
+            fclose(file);
+
+            // The offsets have to stay inside the entries for the queries
+            for(size_t offsetIt = 0; isRead && offsetIt + 1 < m_offsets.size(); ++offsetIt)
+                isRead = m_offsets[offsetIt] <= m_offsets[offsetIt + 1];
+            if(isRead && !m_offsets.empty())
+                isRead = m_offsets.front() == 0 && (uint64_t)m_offsets.back() == header.nrEntries;
+            if(!isRead)
+            {
+                m_offsets.clear();
+                m_hubs.clear();
+                m_distances.clear();
+            }
+            return isRead;
+        }
+    };
+}
+
+#endif
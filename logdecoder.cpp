@@ -0,0 +1,182 @@
+// Renders the binary logs written by BinaryLogger as text
+// Usage: logdecoder <binary log file>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "binarylogger.h"
+
+namespace {
+const char* getLogLevelMessage(uint16_t level){
+	switch(level) {
+		case LogLevel_Debug: return "DEBUG";
+		case LogLevel_Error: return "ERROR";
+		case LogLevel_Warn: return "WARN";
+		default: return "DEBUG";
+	}
+}
+
+struct DecodedFormat {
+	std::string format;
+	uint16_t    level;
+	bool        isValid;
+};
+
+bool isLengthModifier(char c) {
+	return c == 'h' || c == 'l' || c == 'L' || c == 'j' || c == 'z' || c == 't' || c == 'q';
+}
+
+// Appends one argument rendered with the conversion spec. The length modifiers
+// from the original format are replaced because the slots are always 64 bits
+void renderArg(std::string& out, std::string spec, char conversion, uint64_t slot) {
+	char buffer[128];
+	spec.push_back(conversion);
+	switch(conversion) {
+		case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': {
+			spec.insert(spec.size() - 1, "ll");
+			snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<long long>(slot));
+			break;
+		}
+		case 'c': {
+			snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<int>(slot));
+			break;
+		}
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+			double value;
+			memcpy(&value, &slot, sizeof(value));
+			snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+			break;
+		}
+		default: {
+			// Pointers and strings can't be resolved outside of the process
+			snprintf(buffer, sizeof(buffer), "<0x%llx>", static_cast<unsigned long long>(slot));
+			break;
+		}
+	}
+	out += buffer;
+}
+
+std::string renderEvent(const std::string& format, const uint64_t* slots, uint16_t nrArgs) {
+	std::string out;
+	uint16_t argIt = 0;
+	for(size_t charIt = 0; charIt < format.size(); ++charIt) {
+		char c = format[charIt];
+		if(c != '%') {
+			out.push_back(c);
+			continue;
+		}
+		if(charIt + 1 < format.size() && format[charIt + 1] == '%') {
+			out.push_back('%');
+			++charIt;
+			continue;
+		}
+
+		std::string spec = "%";
+		++charIt;
+		while(charIt < format.size() && strchr("-+ #0123456789.*", format[charIt])) {
+			if(format[charIt] != '*') {
+				spec.push_back(format[charIt]);
+			}
+			else {
+				// A '*' width or precision was logged as an int of its own
+				int value = argIt < nrArgs ? static_cast<int>(slots[argIt++]) : 0;
+				// printf ignores a negative precision, a negative width
+				// left justifies which the '-' in the spec does as well
+				if(value < 0 && spec[spec.size() - 1] == '.')
+					spec.erase(spec.size() - 1);
+				else
+					spec += std::to_string(value);
+			}
+			++charIt;
+		}
+		while(charIt < format.size() && isLengthModifier(format[charIt]))
+			++charIt;
+		if(charIt >= format.size())
+			break;
+
+		if(argIt < nrArgs)
+			renderArg(out, spec, format[charIt], slots[argIt++]);
+		else
+			out += "<missing>";
+	}
+	return out;
+}
+}
+
+int main(int argc, char** argv) {
+	if(argc < 2) {
+		printf("Usage: %s <binary log file>\n", argv[0]);
+		return 1;
+	}
+
+	FILE* logFile = fopen(argv[1], "rb");
+	if(logFile == NULL) {
+		printf("Failed to open %s\n", argv[1]);
+		return 1;
+	}
+	std::vector<char> contents;
+	char buffer[1 << 16];
+	size_t readSize;
+	while((readSize = fread(buffer, 1, sizeof(buffer), logFile)) > 0)
+		contents.insert(contents.end(), buffer, buffer + readSize);
+	fclose(logFile);
+
+	if(contents.size() < sizeof(BinaryLogFileHeader) ||
+	   memcmp(reinterpret_cast<const BinaryLogFileHeader*>(&contents[0])->magic, BINARY_LOG_MAGIC,
+			  sizeof(BINARY_LOG_MAGIC)) != 0) {
+		printf("%s is not a binary log\n", argv[1]);
+		return 1;
+	}
+
+	std::vector<DecodedFormat> formats;
+	size_t offset = sizeof(BinaryLogFileHeader);
+	while(offset + sizeof(uint64_t) * 2 <= contents.size()) {
+		const char* record = &contents[offset];
+		uint16_t kind;
+		memcpy(&kind, record, sizeof(kind));
+		if(kind == BinaryLogRecordKind_Format) {
+			BinaryLogFormatRecord formatRecord;
+			memcpy(&formatRecord, record, sizeof(formatRecord));
+			size_t recordSize = sizeof(formatRecord) + formatRecord.length;
+			if(offset + recordSize > contents.size())
+				break;
+			if(formatRecord.formatId >= formats.size())
+				formats.resize(formatRecord.formatId + 1);
+			DecodedFormat& format = formats[formatRecord.formatId];
+			format.format = record + sizeof(formatRecord);
+			format.level = formatRecord.level;
+			format.isValid = true;
+			offset += recordSize;
+		}
+		else if(kind == BinaryLogRecordKind_Event) {
+			BinaryLogEventRecord event;
+			memcpy(&event, record, sizeof(event));
+			size_t recordSize = sizeof(event) + event.nrArgs * sizeof(uint64_t);
+			if(offset + recordSize > contents.size())
+				break;
+			std::vector<uint64_t> slots(event.nrArgs);
+			if(event.nrArgs > 0)
+				memcpy(&slots[0], record + sizeof(event), event.nrArgs * sizeof(uint64_t));
+
+			unsigned long long seconds = event.timestamp / 1000000000ULL;
+			unsigned long long nanoseconds = event.timestamp % 1000000000ULL;
+			if(event.formatId < formats.size() && formats[event.formatId].isValid) {
+				const DecodedFormat& format = formats[event.formatId];
+				std::string text = renderEvent(format.format, slots.empty() ? NULL : &slots[0], event.nrArgs);
+				printf("[%llu.%09llu] %s: %s\n", seconds, nanoseconds,
+					   getLogLevelMessage(format.level), text.c_str());
+			}
+			else {
+				printf("[%llu.%09llu] unknown format %u\n", seconds, nanoseconds, event.formatId);
+			}
+			offset += recordSize;
+		}
+		else {
+			// Either the end of the used space or a record that was still being
+			// written when the process stopped, we can't know its size
+			break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,418 @@
+#ifndef KWGRAPH_MAX_FLOW_H
+#define KWGRAPH_MAX_FLOW_H
+
+#include <deque>
+#include "graphview.h"
+
+namespace KWGraph
+{
+    template <typename T>
+    struct MaxFlowResult
+    {
+        MaxFlowResult() : flowValue(0) {}
+        T                   flowValue;
+        // Flow sent along every edge of Graph::GetEdges(), in the direction
+        // of the edge
+        std::vector<T>      edgeFlows;
+        // Nodes the source can still reach in the residual network, the
+        // source side of a minimum cut
+        std::vector<bool>   isSourceSide;
+        // Saturated edges going from the source side to the sink side
+        std::vector<int>    cutEdgeIds;
+    };
+
+    // Max flow / min cut with FIFO push-relabel, using edge weights as
+    // capacities (negative weights count as 0). The residual network is
+    // built once and reused by every query, so asking for many source and
+    // sink pairs on the same graph only pays for the flow itself.
+    //
+    // The two edges AddListEdge creates for one call share a single pair of
+    // residual arcs, each starting with the edge capacity, instead of
+    // getting a zero capacity reverse arc each. Edges added on their own get
+    // a reverse arc of capacity 0.
+    //
+    // Labels are kept exact every so often with a global relabel, a reverse
+    // BFS from the sink (and then from the source for the nodes that can't
+    // reach the sink anymore). When no node is left on some label below
+    // nrNodes, the gap heuristic lifts every node above it past nrNodes
+    // since none of them can reach the sink. The nodes are kept in a list
+    // per label so the gap only touches the nodes it lifts. The excess that
+    // can't reach the sink flows back to the source in the same pass, so the
+    // result is a proper flow and not just a preflow.
+    // GraphType is a Graph<T> or a GraphView<T>, a view only adds its
+    // visible edges to the residual network.
+    template <typename T, typename GraphType = Graph<T> >
+    class MaxFlowNetwork
+    {
+    private:
+        const GraphType*    m_graph;
+        unsigned int        m_graphVersion;
+        int                 m_nrNodes;
+
+        // Residual arcs in CSR, the arcs leaving node i are
+        // m_offsets[i] .. m_offsets[i + 1]
+        std::vector<int>    m_offsets;
+        std::vector<int>    m_heads;
+        std::vector<int>    m_reverseArcs;
+        std::vector<T>      m_capacities;
+        // Edge the arc stands for, -1 for the zero capacity reverse arcs
+        std::vector<int>    m_arcEdges;
+
+        // Per query state
+        std::vector<T>      m_residuals;
+        std::vector<T>      m_excesses;
+        std::vector<int>    m_labels;
+        std::vector<int>    m_currentArcs;
+        // Doubly linked list of the nodes on every label below m_nrNodes,
+        // -1 ends a list
+        std::vector<int>    m_labelHeads;
+        std::vector<int>    m_nextOnLabel;
+        std::vector<int>    m_previousOnLabel;
+        // No list above it holds a node
+        int                 m_maxListLabel;
+        std::vector<bool>   m_isQueued;
+        std::deque<int>     m_activeNodes;
+        std::vector<int>    m_bfsQueue;
+        int                 m_source;
+        int                 m_sink;
+        size_t              m_relabelWork;
+
+        MaxFlowNetwork(const MaxFlowNetwork&);
+        MaxFlowNetwork& operator=(const MaxFlowNetwork&);
+
+        static inline bool IsEdgeTwin(const Edge<T>& edge, const Edge<T>& twin)
+        {
+            return edge.directed && twin.directed &&
+                   twin.source == edge.destination && twin.destination == edge.source &&
+                   !(twin.weight < edge.weight) && !(edge.weight < twin.weight);
+        }
+
+        static inline T GetCapacity(const Edge<T>& edge)
+        {
+            return edge.weight > T(0) ? edge.weight : T(0);
+        }
+
+        void BuildResidualNetwork()
+        {
+            const std::vector< Edge<T> >& edges = m_graph->GetEdges();
+            int nrEdges = static_cast<int>(edges.size());
+            m_nrNodes = static_cast<int>(m_graph->GetNrNodes());
+            m_graphVersion = m_graph->GetVersion();
+
+            // Edges that own an arc pair, with their twin or -1
+            std::vector< std::pair<int, int> > links;
+            links.reserve(nrEdges);
+            m_offsets.assign(m_nrNodes + 1, 0);
+            for(int edgeIt = 0; edgeIt < nrEdges; ++edgeIt)
+            {
+                const Edge<T>& edge = edges[edgeIt];
+                bool hasTwin = edgeIt + 1 < nrEdges && IsEdgeTwin(edge, edges[edgeIt + 1]);
+                // A view can hide one edge of a pair, the other one then
+                // gets a zero capacity reverse arc
+                bool isVisible = IsListEdgeVisible(*m_graph, edgeIt);
+                bool isTwinVisible = hasTwin && IsListEdgeVisible(*m_graph, edgeIt + 1);
+                if(edge.source != edge.destination && (isVisible || isTwinVisible))
+                {
+                    if(isVisible)
+                        links.push_back(std::make_pair(edgeIt, isTwinVisible ? edgeIt + 1 : -1));
+                    else
+                        links.push_back(std::make_pair(edgeIt + 1, -1));
+                    ++m_offsets[edge.source + 1];
+                    ++m_offsets[edge.destination + 1];
+                }
+                if(hasTwin)
+                    ++edgeIt;
+            }
+            for(int nodeIt = 0; nodeIt < m_nrNodes; ++nodeIt)
+                m_offsets[nodeIt + 1] += m_offsets[nodeIt];
+
+            int nrArcs = m_offsets[m_nrNodes];
+            m_heads.resize(nrArcs);
+            m_reverseArcs.resize(nrArcs);
+            m_capacities.resize(nrArcs);
+            m_arcEdges.resize(nrArcs);
+            std::vector<int> fill(m_offsets.begin(), m_offsets.end() - 1);
+            for(size_t linkIt = 0; linkIt < links.size(); ++linkIt)
+            {
+                const Edge<T>& edge = edges[links[linkIt].first];
+                int twinId = links[linkIt].second;
+                int forwardArc = fill[edge.source]++;
+                int backwardArc = fill[edge.destination]++;
+                m_heads[forwardArc] = edge.destination;
+                m_reverseArcs[forwardArc] = backwardArc;
+                m_capacities[forwardArc] = GetCapacity(edge);
+                m_arcEdges[forwardArc] = links[linkIt].first;
+                m_heads[backwardArc] = edge.source;
+                m_reverseArcs[backwardArc] = forwardArc;
+                m_capacities[backwardArc] = twinId == -1 ? T(0) : GetCapacity(edges[twinId]);
+                m_arcEdges[backwardArc] = twinId;
+            }
+        }
+
+        inline void Enqueue(int id)
+        {
+            if(id == m_source || id == m_sink || m_isQueued[id] || !(m_excesses[id] > T(0)))
+                return;
+            m_isQueued[id] = true;
+            m_activeNodes.push_back(id);
+        }
+
+        inline void AddToLabelList(int id)
+        {
+            int label = m_labels[id];
+            m_previousOnLabel[id] = -1;
+            m_nextOnLabel[id] = m_labelHeads[label];
+            if(m_labelHeads[label] != -1)
+                m_previousOnLabel[m_labelHeads[label]] = id;
+            m_labelHeads[label] = id;
+            m_maxListLabel = std::max(m_maxListLabel, label);
+        }
+
+        inline void RemoveFromLabelList(int id)
+        {
+            if(m_previousOnLabel[id] != -1)
+                m_nextOnLabel[m_previousOnLabel[id]] = m_nextOnLabel[id];
+            else
+                m_labelHeads[m_labels[id]] = m_nextOnLabel[id];
+            if(m_nextOnLabel[id] != -1)
+                m_previousOnLabel[m_nextOnLabel[id]] = m_previousOnLabel[id];
+        }
+
+        inline void SetLabel(int id, int label)
+        {
+            if(m_labels[id] < m_nrNodes)
+                RemoveFromLabelList(id);
+            m_labels[id] = label;
+            if(label < m_nrNodes)
+                AddToLabelList(id);
+        }
+
+        // Reverse BFS over the arcs with residual capacity left, starting
+        // from root and its label. Only touches nodes that are unlabeled
+        void LabelByDistance(int root, int unlabeled)
+        {
+            m_bfsQueue.clear();
+            m_bfsQueue.push_back(root);
+            for(size_t queueIt = 0; queueIt < m_bfsQueue.size(); ++queueIt)
+            {
+                int crNodeId = m_bfsQueue[queueIt];
+                int nextLabel = m_labels[crNodeId] + 1;
+                for(int arcIt = m_offsets[crNodeId]; arcIt < m_offsets[crNodeId + 1]; ++arcIt)
+                {
+                    int neighbor = m_heads[arcIt];
+                    if(m_labels[neighbor] != unlabeled || !(m_residuals[m_reverseArcs[arcIt]] > T(0)))
+                        continue;
+                    m_labels[neighbor] = nextLabel;
+                    m_bfsQueue.push_back(neighbor);
+                }
+            }
+        }
+
+        void GlobalRelabel()
+        {
+            int unlabeled = 2 * m_nrNodes;
+            std::fill(m_labels.begin(), m_labels.end(), unlabeled);
+            m_labels[m_sink] = 0;
+            m_labels[m_source] = m_nrNodes;
+            LabelByDistance(m_sink, unlabeled);
+            LabelByDistance(m_source, unlabeled);
+
+            std::fill(m_labelHeads.begin(), m_labelHeads.end(), -1);
+            m_maxListLabel = 0;
+            for(int nodeIt = 0; nodeIt < m_nrNodes; ++nodeIt)
+            {
+                if(m_labels[nodeIt] < m_nrNodes)
+                    AddToLabelList(nodeIt);
+                m_currentArcs[nodeIt] = m_offsets[nodeIt];
+            }
+            m_relabelWork = 0;
+        }
+
+        void Relabel(int id)
+        {
+            int oldLabel = m_labels[id];
+            int newLabel = 2 * m_nrNodes;
+            int firstArc = m_offsets[id];
+            for(int arcIt = m_offsets[id]; arcIt < m_offsets[id + 1]; ++arcIt)
+            {
+                if(m_residuals[arcIt] > T(0) && m_labels[m_heads[arcIt]] + 1 < newLabel)
+                {
+                    newLabel = m_labels[m_heads[arcIt]] + 1;
+                    firstArc = arcIt;
+                }
+            }
+            m_currentArcs[id] = firstArc;
+            m_relabelWork += 12 + (m_offsets[id + 1] - m_offsets[id]);
+
+            // Gap: nothing on oldLabel anymore, so nothing above it can
+            // reach the sink
+            if(oldLabel < m_nrNodes && m_labelHeads[oldLabel] == id && m_nextOnLabel[id] == -1)
+            {
+                for(int labelIt = oldLabel + 1; labelIt <= m_maxListLabel; ++labelIt)
+                {
+                    for(int nodeIt = m_labelHeads[labelIt]; nodeIt != -1; nodeIt = m_nextOnLabel[nodeIt])
+                    {
+                        m_labels[nodeIt] = m_nrNodes + 1;
+                        m_currentArcs[nodeIt] = m_offsets[nodeIt];
+                    }
+                    m_labelHeads[labelIt] = -1;
+                }
+                m_maxListLabel = oldLabel;
+                newLabel = std::max(newLabel, m_nrNodes + 1);
+            }
+            SetLabel(id, newLabel);
+        }
+
+        void Discharge(int id)
+        {
+            while(m_excesses[id] > T(0))
+            {
+                int arcIt = m_currentArcs[id];
+                if(arcIt == m_offsets[id + 1])
+                {
+                    Relabel(id);
+                    if(m_labels[id] >= 2 * m_nrNodes)
+                        break;
+                    continue;
+                }
+
+                int neighbor = m_heads[arcIt];
+                T residual = m_residuals[arcIt];
+                if(residual > T(0) && m_labels[id] == m_labels[neighbor] + 1)
+                {
+                    T pushed = std::min(residual, m_excesses[id]);
+                    m_residuals[arcIt] -= pushed;
+                    m_residuals[m_reverseArcs[arcIt]] += pushed;
+                    m_excesses[id] -= pushed;
+                    m_excesses[neighbor] += pushed;
+                    Enqueue(neighbor);
+                }
+                else
+                    m_currentArcs[id] = arcIt + 1;
+            }
+        }
+
+        void FillResult(MaxFlowResult<T>& result)
+        {
+            const std::vector< Edge<T> >& edges = m_graph->GetEdges();
+            result.flowValue = m_excesses[m_sink];
+            result.edgeFlows.assign(edges.size(), T(0));
+            for(int arcIt = 0; arcIt < m_offsets[m_nrNodes]; ++arcIt)
+            {
+                // Each pair is handled from its forward arc
+                int reverseArc = m_reverseArcs[arcIt];
+                if(m_arcEdges[arcIt] == -1 || (m_arcEdges[reverseArc] != -1 && m_arcEdges[arcIt] > m_arcEdges[reverseArc]))
+                    continue;
+                T flow = m_capacities[arcIt] - m_residuals[arcIt];
+                if(flow > T(0))
+                    result.edgeFlows[m_arcEdges[arcIt]] = flow;
+                else if(flow < T(0) && m_arcEdges[reverseArc] != -1)
+                    result.edgeFlows[m_arcEdges[reverseArc]] = -flow;
+            }
+
+            result.isSourceSide.assign(m_nrNodes, false);
+            result.isSourceSide[m_source] = true;
+            m_bfsQueue.clear();
+            m_bfsQueue.push_back(m_source);
+            for(size_t queueIt = 0; queueIt < m_bfsQueue.size(); ++queueIt)
+            {
+                int crNodeId = m_bfsQueue[queueIt];
+                for(int arcIt = m_offsets[crNodeId]; arcIt < m_offsets[crNodeId + 1]; ++arcIt)
+                {
+                    int neighbor = m_heads[arcIt];
+                    if(result.isSourceSide[neighbor] || !(m_residuals[arcIt] > T(0)))
+                        continue;
+                    result.isSourceSide[neighbor] = true;
+                    m_bfsQueue.push_back(neighbor);
+                }
+            }
+
+            result.cutEdgeIds.clear();
+            for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt)
+            {
+                const Edge<T>& edge = edges[edgeIt];
+                if(result.isSourceSide[edge.source] && !result.isSourceSide[edge.destination] &&
+                   GetCapacity(edge) > T(0) && IsListEdgeVisible(*m_graph, (int)edgeIt))
+                    result.cutEdgeIds.push_back(static_cast<int>(edgeIt));
+            }
+        }
+
+    public:
+        MaxFlowNetwork(const GraphType* graph) :
+            m_graph(graph),
+            m_graphVersion(graph->GetVersion()),
+            m_nrNodes(0),
+            m_maxListLabel(0),
+            m_source(-1),
+            m_sink(-1),
+            m_relabelWork(0)
+        {
+            BuildResidualNetwork();
+        }
+
+        // Returns false if source or sink are not valid nodes or are the
+        // same node. The residual network is rebuilt if the graph (or the
+        // masks of the view) changed since the last call
+        bool ComputeMaxFlow(int source, int sink, MaxFlowResult<T>& result)
+        {
+            if(m_graph->GetVersion() != m_graphVersion)
+                BuildResidualNetwork();
+            if(source < 0 || sink < 0 || source >= m_nrNodes || sink >= m_nrNodes || source == sink)
+                return false;
+
+            m_source = source;
+            m_sink = sink;
+            m_residuals = m_capacities;
+            m_excesses.assign(m_nrNodes, T(0));
+            m_labels.assign(m_nrNodes, 0);
+            m_currentArcs.resize(m_nrNodes);
+            m_labelHeads.assign(m_nrNodes, -1);
+            m_nextOnLabel.assign(m_nrNodes, -1);
+            m_previousOnLabel.assign(m_nrNodes, -1);
+            m_isQueued.assign(m_nrNodes, false);
+            m_activeNodes.clear();
+
+            for(int arcIt = m_offsets[source]; arcIt < m_offsets[source + 1]; ++arcIt)
+            {
+                T residual = m_residuals[arcIt];
+                if(!(residual > T(0)))
+                    continue;
+                m_residuals[arcIt] = T(0);
+                m_residuals[m_reverseArcs[arcIt]] += residual;
+                m_excesses[m_heads[arcIt]] += residual;
+                m_excesses[source] -= residual;
+            }
+            GlobalRelabel();
+            for(int nodeIt = 0; nodeIt < m_nrNodes; ++nodeIt)
+                Enqueue(nodeIt);
+
+            size_t globalRelabelWork = 6 * (size_t)m_nrNodes + m_offsets[m_nrNodes] / 2;
+            while(!m_activeNodes.empty())
+            {
+                int crNodeId = m_activeNodes.front();
+                m_activeNodes.pop_front();
+                m_isQueued[crNodeId] = false;
+                Discharge(crNodeId);
+                if(m_relabelWork > globalRelabelWork)
+                    GlobalRelabel();
+            }
+
+            FillResult(result);
+            return true;
+        }
+
+        T ComputeMaxFlow(int source, int sink)
+        {
+            MaxFlowResult<T> result;
+            ComputeMaxFlow(source, sink, result);
+            return result.flowValue;
+        }
+    };
+
+    typedef MaxFlowNetwork<int> IntMaxFlowNetwork;
+    typedef MaxFlowNetwork<float> FloatMaxFlowNetwork;
+    typedef MaxFlowNetwork< int, GraphView<int> > IntViewMaxFlowNetwork;
+    typedef MaxFlowNetwork< float, GraphView<float> > FloatViewMaxFlowNetwork;
+}
+
+#endif
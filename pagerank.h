@@ -0,0 +1,231 @@
+#ifndef KWGRAPH_PAGERANK_H
+#define KWGRAPH_PAGERANK_H
+
+#include <cmath>
+#include <unordered_map>
+#include "randomwalk.h"
+
+namespace KWGraph
+{
+    typedef std::unordered_map<int, double> PageRankScores;
+
+    struct PageRankConfig
+    {
+        PageRankConfig() :
+            restartChance(0.15f),
+            pushThreshold(1e-4),
+            nrWalks(10000),
+            seed(1234) {}
+
+        // Chance to jump back to the seed node at every step
+        float       restartChance;
+        // A node pushes its residual once it is over pushThreshold per out
+        // edge. Smaller values push further out and leave less to the walks
+        double      pushThreshold;
+        // Walks shared by the residuals left after the push, 0 returns the
+        // push estimate alone
+        int         nrWalks;
+        uint64_t    seed;
+    };
+
+    // Approximate personalized PageRank from a single seed node, forward
+    // push followed by Monte Carlo walks from the leftover residuals (FORA).
+    // The push moves probability mass out from the seed until every node's
+    // residual is small next to its out degree, the walks then spend the
+    // remaining mass so the estimate stays unbiased. The walk follows out
+    // edges uniformly, a node without out edges sends its mass back to the
+    // seed. Only the nodes the query reaches are touched, the dense arrays
+    // are stamped per query like TraversalWorkspace. A node's out degree is
+    // counted once when the query first touches it, and its neighbors are
+    // gathered the first time a walk leaves it, so pushes and steps don't
+    // go back to Neighbors (a full row scan on matrix storage).
+    // GraphType can also be a GraphView.
+    // NOTE: Not thread safe, use one engine per thread
+    template <typename T, typename GraphType = Graph<T> >
+    class PersonalizedPageRank
+    {
+    private:
+        const GraphType*        m_graph;
+        std::vector<double>     m_residuals;
+        std::vector<double>     m_estimates;
+        // A node's residual and estimate are valid when its stamp matches
+        std::vector<unsigned int> m_stamps;
+        unsigned int            m_stamp;
+        std::vector<int>        m_degrees;
+        // Where the neighbors of a node start in m_walkNeighbors, -1 until a
+        // walk first leaves the node
+        std::vector<int>        m_walkOffsets;
+        std::vector<int>        m_walkNeighbors;
+        std::vector<bool>       m_isQueued;
+        std::vector<int>        m_touched;
+        std::vector<int>        m_queue;
+
+        PersonalizedPageRank(const PersonalizedPageRank&);
+        PersonalizedPageRank& operator=(const PersonalizedPageRank&);
+
+        inline void Touch(int id)
+        {
+            if(m_stamps[id] == m_stamp)
+                return;
+            m_stamps[id] = m_stamp;
+            m_residuals[id] = 0.0;
+            m_estimates[id] = 0.0;
+            m_degrees[id] = static_cast<int>(m_graph->Neighbors(id).size());
+            m_walkOffsets[id] = -1;
+            m_touched.push_back(id);
+        }
+
+        inline void AddResidual(int id, double mass, double threshold)
+        {
+            Touch(id);
+            m_residuals[id] += mass;
+            if(!m_isQueued[id] && m_residuals[id] > threshold * std::max(m_degrees[id], 1))
+            {
+                m_isQueued[id] = true;
+                m_queue.push_back(id);
+            }
+        }
+
+        // Uniform out neighbor of a touched node with out edges
+        int PickNeighbor(int id, WalkRandom& random)
+        {
+            if(m_walkOffsets[id] == -1)
+            {
+                m_walkOffsets[id] = static_cast<int>(m_walkNeighbors.size());
+                NeighborRange<T> neighbors = m_graph->Neighbors(id);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                    m_walkNeighbors.push_back(edgeIt.GetDestination());
+            }
+            return m_walkNeighbors[m_walkOffsets[id] + random.NextInt(m_degrees[id])];
+        }
+
+        void ForwardPush(int seed, const PageRankConfig& config)
+        {
+            double restartChance = config.restartChance;
+            m_queue.clear();
+            AddResidual(seed, 1.0, config.pushThreshold);
+            for(size_t queueIt = 0; queueIt < m_queue.size(); ++queueIt)
+            {
+                int crNodeId = m_queue[queueIt];
+                m_isQueued[crNodeId] = false;
+                double residual = m_residuals[crNodeId];
+                m_residuals[crNodeId] = 0.0;
+                m_estimates[crNodeId] += restartChance * residual;
+
+                double spread = (1.0 - restartChance) * residual;
+                if(m_degrees[crNodeId] == 0)
+                {
+                    AddResidual(seed, spread, config.pushThreshold);
+                    continue;
+                }
+                double share = spread / m_degrees[crNodeId];
+                NeighborRange<T> neighbors = m_graph->Neighbors(crNodeId);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                    AddResidual(edgeIt.GetDestination(), share, config.pushThreshold);
+            }
+        }
+
+        // Every walk stops with restartChance at each step and leaves its
+        // share of the residual where it stopped
+        void SpendResiduals(int seed, const PageRankConfig& config)
+        {
+            double totalResidual = 0.0;
+            for(size_t touchedIt = 0; touchedIt < m_touched.size(); ++touchedIt)
+                totalResidual += m_residuals[m_touched[touchedIt]];
+            if(totalResidual <= 0.0 || config.nrWalks <= 0)
+                return;
+
+            WalkRandom random(config.seed);
+            // Walks can add nodes to m_touched
+            size_t nrSources = m_touched.size();
+            for(size_t touchedIt = 0; touchedIt < nrSources; ++touchedIt)
+            {
+                int source = m_touched[touchedIt];
+                double residual = m_residuals[source];
+                if(residual <= 0.0)
+                    continue;
+                int nrWalks = (int)std::ceil(residual / totalResidual * config.nrWalks);
+                double share = residual / nrWalks;
+                for(int walkIt = 0; walkIt < nrWalks; ++walkIt)
+                {
+                    int crNodeId = source;
+                    while(random.NextFloat() >= config.restartChance)
+                    {
+                        Touch(crNodeId);
+                        crNodeId = m_degrees[crNodeId] ? PickNeighbor(crNodeId, random) : seed;
+                    }
+                    Touch(crNodeId);
+                    m_estimates[crNodeId] += share;
+                }
+            }
+        }
+
+    public:
+        explicit PersonalizedPageRank(const GraphType* graph) :
+            m_graph(graph),
+            m_stamp(0) {}
+
+        // Stores the nodes with a non zero score and their score. The scores
+        // add up to 1, minus the leftover residuals when nrWalks is 0
+        void Compute(int seed, const PageRankConfig& config, PageRankScores& scores)
+        {
+            scores.clear();
+            size_t nrNodes = m_graph->GetNrNodes();
+            if(seed < 0 || (size_t)seed >= nrNodes)
+                return;
+
+            if(m_stamps.size() != nrNodes)
+            {
+                m_residuals.resize(nrNodes);
+                m_estimates.resize(nrNodes);
+                m_degrees.resize(nrNodes);
+                m_walkOffsets.resize(nrNodes);
+                m_stamps.assign(nrNodes, 0);
+                m_isQueued.assign(nrNodes, false);
+                m_stamp = 0;
+            }
+            if(++m_stamp == 0)
+            {
+                std::fill(m_stamps.begin(), m_stamps.end(), 0);
+                m_stamp = 1;
+            }
+            m_touched.clear();
+            m_walkNeighbors.clear();
+
+            ForwardPush(seed, config);
+            SpendResiduals(seed, config);
+
+            scores.reserve(m_touched.size());
+            for(size_t touchedIt = 0; touchedIt < m_touched.size(); ++touchedIt)
+            {
+                int nodeId = m_touched[touchedIt];
+                if(m_estimates[nodeId] > 0.0)
+                    scores[nodeId] = m_estimates[nodeId];
+            }
+        }
+    };
+
+    namespace
+    {
+        static inline bool IsHigherScore(const std::pair<int, double>& score, const std::pair<int, double>& other)
+        {
+            return score.second > other.second || (score.second == other.second && score.first < other.first);
+        }
+    }
+
+    // The k best scored nodes, best first
+    static inline void GetTopScores(const PageRankScores& scores, int k, std::vector< std::pair<int, double> >& top)
+    {
+        top.assign(scores.begin(), scores.end());
+        size_t nrKept = std::min((size_t)std::max(k, 0), top.size());
+        std::partial_sort(top.begin(), top.begin() + nrKept, top.end(), IsHigherScore);
+        top.resize(nrKept);
+    }
+
+    typedef PersonalizedPageRank<int> IntPersonalizedPageRank;
+    typedef PersonalizedPageRank<float> FloatPersonalizedPageRank;
+}
+
+#endif
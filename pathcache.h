@@ -0,0 +1,267 @@
+#ifndef KWGRAPH_PATH_CACHE_H
+#define KWGRAPH_PATH_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <stdint.h>
+#include "graphview.h"
+
+namespace KWGraph
+{
+    // Fixed width unsigned integers packed back to back in 64 bit words.
+    // A parent array only needs log2(nrNodes) bits per entry, for a million
+    // nodes that's 20 bits instead of 32
+    class PackedIntArray
+    {
+    private:
+        std::vector<uint64_t>   m_words;
+        size_t                  m_size;
+        unsigned int            m_bitWidth;
+        uint64_t                m_mask;
+    public:
+        PackedIntArray() : m_size(0), m_bitWidth(1), m_mask(1) {}
+
+        // Makes room for size values in [0, maxValue]
+        void Init(size_t size, uint64_t maxValue)
+        {
+            m_bitWidth = 1;
+            while(m_bitWidth < 64 && (maxValue >> m_bitWidth) != 0)
+                ++m_bitWidth;
+            m_mask = (m_bitWidth == 64) ? ~uint64_t(0) : ((uint64_t(1) << m_bitWidth) - 1);
+            m_size = size;
+            m_words.assign((size * m_bitWidth + 63) / 64, 0);
+        }
+
+        inline uint64_t Get(size_t index) const
+        {
+            size_t bitIndex = index * m_bitWidth;
+            size_t wordIndex = bitIndex >> 6;
+            unsigned int shift = bitIndex & 63;
+            uint64_t value = m_words[wordIndex] >> shift;
+            if(shift + m_bitWidth > 64)
+                value |= m_words[wordIndex + 1] << (64 - shift);
+            return value & m_mask;
+        }
+
+        inline void Set(size_t index, uint64_t value)
+        {
+            size_t bitIndex = index * m_bitWidth;
+            size_t wordIndex = bitIndex >> 6;
+            unsigned int shift = bitIndex & 63;
+            value &= m_mask;
+            m_words[wordIndex] = (m_words[wordIndex] & ~(m_mask << shift)) | (value << shift);
+            if(shift + m_bitWidth > 64)
+            {
+                unsigned int highBits = 64 - shift;
+                uint64_t highMask = m_mask >> highBits;
+                m_words[wordIndex + 1] = (m_words[wordIndex + 1] & ~highMask) | (value >> highBits);
+            }
+        }
+
+        inline size_t GetSize() const { return m_size; }
+        inline size_t GetMemorySize() const { return m_words.size() * sizeof(uint64_t); }
+    };
+
+    // LRU cache of BFS shortest path trees keyed by their source. A hit turns
+    // a shortest path query into a walk up the parent chain of the cached
+    // tree, same as the parent chase BFSShortestPath does on the nodes.
+    // The trees only keep the packed parent array, distances are the length
+    // of the walk. The cache drops everything once the graph version changes,
+    // which AddNode and AddEdge bump. GraphType can also be a GraphView,
+    // whose version also changes with its masks.
+    template <typename T, typename GraphType = Graph<T> >
+    class ShortestPathCache
+    {
+    private:
+        struct CachedTree
+        {
+            int             source;
+            // Parent of every node, nrNodes marks an unreached node and
+            // nrNodes + 1 the root
+            PackedIntArray  parents;
+        };
+
+        typedef std::list<CachedTree*>                      LRUList;
+        typedef std::unordered_map<int, typename LRUList::iterator> TreeMap;
+
+        const GraphType*    m_graph;
+        size_t              m_memoryBudget;
+        size_t              m_memoryUsed;
+        unsigned int        m_graphVersion;
+        // Most recently used trees are at the front
+        LRUList             m_lruTrees;
+        TreeMap             m_trees;
+        TraversalWorkspace  m_workspace;
+        mutable std::mutex  m_lock;
+        size_t              m_nrHits;
+        size_t              m_nrMisses;
+
+        ShortestPathCache(const ShortestPathCache&);
+        ShortestPathCache& operator=(const ShortestPathCache&);
+
+        void ClearLocked()
+        {
+            for(typename LRUList::iterator treeIt = m_lruTrees.begin(); treeIt != m_lruTrees.end(); ++treeIt)
+                delete *treeIt;
+            m_lruTrees.clear();
+            m_trees.clear();
+            m_memoryUsed = 0;
+        }
+
+        // Drops the least recently used trees until the cache fits the budget
+        // or only nrKept trees are left
+        void EvictToBudgetLocked(size_t nrKept)
+        {
+            while(m_memoryUsed > m_memoryBudget && m_lruTrees.size() > nrKept)
+            {
+                CachedTree* tree = m_lruTrees.back();
+                m_memoryUsed -= tree->parents.GetMemorySize();
+                m_trees.erase(tree->source);
+                m_lruTrees.pop_back();
+                delete tree;
+            }
+        }
+
+        CachedTree* BuildTree(int source)
+        {
+            size_t nrNodes = m_graph->GetNrNodes();
+            GraphVisitor<T> visitor(NULL, source);
+            m_graph->BFS(&visitor, m_workspace);
+
+            CachedTree* tree = new CachedTree();
+            tree->source = source;
+            tree->parents.Init(nrNodes, nrNodes + 1);
+            for(size_t nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                int parent = m_workspace.GetParent(nodeIt);
+                if(parent == INVALID_ID)
+                    tree->parents.Set(nodeIt, nrNodes);
+                else if(parent == ROOT_ID)
+                    tree->parents.Set(nodeIt, nrNodes + 1);
+                else
+                    tree->parents.Set(nodeIt, parent);
+            }
+            return tree;
+        }
+
+        // Returns the tree for source, building it on a miss
+        CachedTree* GetTreeLocked(int source)
+        {
+            if(m_graph->GetVersion() != m_graphVersion)
+            {
+                ClearLocked();
+                m_graphVersion = m_graph->GetVersion();
+            }
+
+            typename TreeMap::iterator treeIt = m_trees.find(source);
+            if(treeIt != m_trees.end())
+            {
+                ++m_nrHits;
+                m_lruTrees.splice(m_lruTrees.begin(), m_lruTrees, treeIt->second);
+                return *treeIt->second;
+            }
+
+            ++m_nrMisses;
+            CachedTree* tree = BuildTree(source);
+            m_lruTrees.push_front(tree);
+            m_trees[source] = m_lruTrees.begin();
+            m_memoryUsed += tree->parents.GetMemorySize();
+            // Keep the new tree around until the caller is done with it
+            EvictToBudgetLocked(1);
+            return tree;
+        }
+
+    public:
+        ShortestPathCache(const GraphType* graph, size_t memoryBudget) :
+            m_graph(graph),
+            m_memoryBudget(memoryBudget),
+            m_memoryUsed(0),
+            m_graphVersion(graph->GetVersion()),
+            m_nrHits(0),
+            m_nrMisses(0) {}
+
+        ~ShortestPathCache() { ClearLocked(); }
+
+        // Stores the path from source to destination, returns false if there
+        // is none. Safe to call from several threads, but the whole call
+        // holds the cache lock so concurrent lookups, hits included, run
+        // one at a time
+        bool GetPath(int source, int destination, std::vector<int>& path)
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            path.clear();
+            size_t nrNodes = m_graph->GetNrNodes();
+            if(source < 0 || destination < 0 || (size_t)source >= nrNodes || (size_t)destination >= nrNodes)
+                return false;
+
+            CachedTree* tree = GetTreeLocked(source);
+            uint64_t crNodeId = destination;
+            if(tree->parents.Get(crNodeId) == nrNodes)
+            {
+                EvictToBudgetLocked(0);
+                return false;
+            }
+            while(crNodeId != nrNodes + 1)
+            {
+                path.push_back(static_cast<int>(crNodeId));
+                crNodeId = tree->parents.Get(crNodeId);
+            }
+            std::reverse(path.begin(), path.end());
+            // A single tree can be over the budget on its own
+            EvictToBudgetLocked(0);
+            return true;
+        }
+
+        // Hop distance from source to destination or -1 if there is no path
+        int GetDistance(int source, int destination)
+        {
+            std::vector<int> path;
+            return GetPath(source, destination, path) ? (int)path.size() - 1 : -1;
+        }
+
+        void Clear()
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            ClearLocked();
+        }
+
+        void SetMemoryBudget(size_t memoryBudget)
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_memoryBudget = memoryBudget;
+            EvictToBudgetLocked(0);
+        }
+
+        // The stats take the lock too so they can be read while other
+        // threads call GetPath
+        size_t GetMemoryUsed() const
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            return m_memoryUsed;
+        }
+
+        size_t GetNrCachedTrees() const
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            return m_lruTrees.size();
+        }
+
+        size_t GetNrHits() const
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            return m_nrHits;
+        }
+
+        size_t GetNrMisses() const
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            return m_nrMisses;
+        }
+    };
+
+    typedef ShortestPathCache<int> IntShortestPathCache;
+    typedef ShortestPathCache<float> FloatShortestPathCache;
+}
+
+#endif
@@ -1,4 +1,9 @@
-#ifndef PLATFORM_H
-#define PLATFORM_H
+#ifndef KWGRAPH_PLATFORM_H
+#define KWGRAPH_PLATFORM_H
 
-#endif // PLATFORM_H
+#if defined(__linux__)
+#    include "platforms/platform.h"
+#    include "platforms/taskscheduler.h"
+#endif
+
+#endif // KWGRAPH_PLATFORM_H
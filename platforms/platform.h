@@ -1,11 +1,56 @@
 #ifndef PLATFORM_H
 #define PLATFORM_H
 
+#include <stddef.h>
 #include <pthread.h>
+#include <vector>
 typedef pthread_t PThreadID;
 typedef void* (*StartThreadFunc) (void* arg);
 
+struct PCpuInfo {
+	int cpu;
+	// Logical cpus with the same core and socket are SMT siblings
+	int core;
+	int socket;
+	int numaNode;
+};
+
+struct PCpuTopology {
+	// Only the cpus the process is allowed to run on, sorted by socket, core
+	// and then cpu so SMT siblings are next to each other
+	std::vector<PCpuInfo> cpus;
+	int nrCores;
+	int nrSockets;
+	int nrNumaNodes;
+};
+
+struct PMappedFile {
+	void*  data;
+	size_t size;
+	int    handle;
+};
+
 int PWaitOnThread(PThreadID threadId, void** result);
 int PStartThread(void* threadArg, StartThreadFunc, PThreadID& threadId);
+// Number of processors currently online, never less than 1
+int PGetNrProcessors();
+PThreadID PGetCurrentThread();
+
+// Reads the cpu, core, socket and NUMA node layout of the cpus in the process
+// affinity mask. Information that isn't available is filled with zeros
+int PGetCpuTopology(PCpuTopology& topology);
+// Restricts the thread to the given logical cpus
+int PSetThreadAffinity(PThreadID threadId, const int* cpus, int nrCpus);
+int PPinThreadToCpu(PThreadID threadId, int cpu);
+
+// Creates (or truncates) the file at path, grows it to size bytes and maps it
+// for reading and writing. The mapped memory starts out zeroed.
+int PMapFile(const char* path, size_t size, PMappedFile& file);
+// Unmaps the file and shrinks it to usedSize bytes so the unused tail of the
+// mapping doesn't end up on disk
+int PUnmapFile(PMappedFile& file, size_t usedSize);
+
+// Wall clock time in nanoseconds, cheap enough to be called per log record
+unsigned long long PGetTimestamp();
 
 #endif // PLATFORM_H
@@ -1,4 +1,14 @@
 #include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <algorithm>
 
 #include "platform.h"
 #include "../logger.h"
@@ -27,3 +37,175 @@ int PStartThread(void* threadArg, StartThreadFunc startRoutine, PThreadID& threa
 	}
 	return result;
 }
+
+int PGetNrProcessors() {
+	long nrProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+	return nrProcessors > 0 ? static_cast<int>(nrProcessors) : 1;
+}
+
+PThreadID PGetCurrentThread() {
+	return pthread_self();
+}
+
+namespace {
+// Reads a single integer from a sysfs file, returns fallback if it's missing
+int ReadSysInt(const char* path, int fallback) {
+	FILE* file = fopen(path, "r");
+	if(file == NULL)
+		return fallback;
+	int value;
+	if(fscanf(file, "%d", &value) != 1)
+		value = fallback;
+	fclose(file);
+	return value;
+}
+
+// The NUMA node shows up as a nodeX link in the cpu directory
+int ReadCpuNumaNode(int cpu) {
+	char path[128];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	DIR* cpuDir = opendir(path);
+	if(cpuDir == NULL)
+		return 0;
+
+	int numaNode = 0;
+	struct dirent* entry;
+	while((entry = readdir(cpuDir)) != NULL) {
+		if(strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+			numaNode = atoi(entry->d_name + 4);
+			break;
+		}
+	}
+	closedir(cpuDir);
+	return numaNode;
+}
+
+bool CompareCpus(const PCpuInfo& first, const PCpuInfo& second) {
+	if(first.socket != second.socket)
+		return first.socket < second.socket;
+	if(first.core != second.core)
+		return first.core < second.core;
+	return first.cpu < second.cpu;
+}
+
+int CountDistinct(std::vector<long long>& keys) {
+	std::sort(keys.begin(), keys.end());
+	return static_cast<int>(std::unique(keys.begin(), keys.end()) - keys.begin());
+}
+}
+
+int PGetCpuTopology(PCpuTopology& topology) {
+	topology.cpus.clear();
+	topology.nrCores = 0;
+	topology.nrSockets = 0;
+	topology.nrNumaNodes = 0;
+
+	cpu_set_t allowedCpus;
+	CPU_ZERO(&allowedCpus);
+	if(sched_getaffinity(0, sizeof(allowedCpus), &allowedCpus) != 0) {
+		Logger::getLogger().error("Failed to read the process affinity mask\n");
+		return errno;
+	}
+
+	char path[128];
+	for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if(!CPU_ISSET(cpu, &allowedCpus))
+			continue;
+
+		PCpuInfo info;
+		info.cpu = cpu;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+		info.core = ReadSysInt(path, cpu);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+		info.socket = ReadSysInt(path, 0);
+		info.numaNode = ReadCpuNumaNode(cpu);
+		topology.cpus.push_back(info);
+	}
+	std::sort(topology.cpus.begin(), topology.cpus.end(), CompareCpus);
+
+	// core ids are only unique inside of a socket
+	std::vector<long long> cores, sockets, numaNodes;
+	for(size_t cpuIt = 0; cpuIt < topology.cpus.size(); ++cpuIt) {
+		const PCpuInfo& info = topology.cpus[cpuIt];
+		cores.push_back((static_cast<long long>(info.socket) << 32) | info.core);
+		sockets.push_back(info.socket);
+		numaNodes.push_back(info.numaNode);
+	}
+	topology.nrCores = CountDistinct(cores);
+	topology.nrSockets = CountDistinct(sockets);
+	topology.nrNumaNodes = CountDistinct(numaNodes);
+	return 0;
+}
+
+int PSetThreadAffinity(PThreadID threadId, const int* cpus, int nrCpus) {
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	for(int cpuIt = 0; cpuIt < nrCpus; ++cpuIt) {
+		if(cpus[cpuIt] >= 0 && cpus[cpuIt] < CPU_SETSIZE)
+			CPU_SET(cpus[cpuIt], &cpuSet);
+	}
+
+	int result = pthread_setaffinity_np(threadId, sizeof(cpuSet), &cpuSet);
+	if(result != 0)
+		Logger::getLogger().warn("Failed to set the thread affinity\n");
+	return result;
+}
+
+int PPinThreadToCpu(PThreadID threadId, int cpu) {
+	return PSetThreadAffinity(threadId, &cpu, 1);
+}
+
+int PMapFile(const char* path, size_t size, PMappedFile& file) {
+	const Logger& logger = Logger::getLogger();
+	file.data = NULL;
+	file.size = 0;
+	file.handle = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(file.handle < 0) {
+		logger.error("Failed to open the file to be mapped");
+		return errno;
+	}
+
+	if(ftruncate(file.handle, size) != 0) {
+		int result = errno;
+		logger.error("Failed to grow the file to be mapped");
+		close(file.handle);
+		file.handle = -1;
+		return result;
+	}
+
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file.handle, 0);
+	if(data == MAP_FAILED) {
+		int result = errno;
+		logger.error("Failed to map the file");
+		close(file.handle);
+		file.handle = -1;
+		return result;
+	}
+
+	file.data = data;
+	file.size = size;
+	return 0;
+}
+
+int PUnmapFile(PMappedFile& file, size_t usedSize) {
+	if(file.data == NULL)
+		return EINVAL;
+
+	int result = 0;
+	if(munmap(file.data, file.size) != 0)
+		result = errno;
+	if(usedSize < file.size && ftruncate(file.handle, usedSize) != 0 && result == 0)
+		result = errno;
+	close(file.handle);
+
+	file.data = NULL;
+	file.size = 0;
+	file.handle = -1;
+	return result;
+}
+
+unsigned long long PGetTimestamp() {
+	struct timespec crTime;
+	clock_gettime(CLOCK_REALTIME, &crTime);
+	return crTime.tv_sec * 1000000000ULL + crTime.tv_nsec;
+}
@@ -0,0 +1,381 @@
+#include <thread>
+#include "taskscheduler.h"
+#include "../logger.h"
+
+namespace {
+const long long initialDequeCapacity = 256;
+// Number of rounds an idle worker keeps looking for work before parking
+const int idleSpinRounds = 64;
+
+thread_local const PTaskScheduler* currentScheduler = NULL;
+thread_local int currentWorkerIndex = -1;
+
+std::atomic<PTaskScheduler*> schedulerInstance(NULL);
+std::mutex schedulerInstanceLock;
+
+struct RangeTaskData {
+	PTaskScheduler* scheduler;
+	PTaskGroup*     group;
+	PRangeFunc      func;
+	void*           arg;
+	int             begin;
+	int             end;
+	int             grainSize;
+};
+
+void RunRangeTask(void* arg) {
+	RangeTaskData* data = static_cast<RangeTaskData*>(arg);
+	int begin = data->begin;
+	int end = data->end;
+	// Keep the left half and hand the right half to whoever wants to steal it
+	while(end - begin > data->grainSize) {
+		int middle = begin + (end - begin) / 2;
+		RangeTaskData* rightHalf = new RangeTaskData(*data);
+		rightHalf->begin = middle;
+		rightHalf->end = end;
+		data->scheduler->Spawn(*data->group, RunRangeTask, rightHalf);
+		end = middle;
+	}
+	data->func(data->arg, begin, end);
+	delete data;
+}
+}
+
+PTaskDeque::PTaskDeque() : m_top(0), m_bottom(0), m_array(new TaskArray(initialDequeCapacity)) {
+}
+
+PTaskDeque::~PTaskDeque() {
+	delete m_array.load(std::memory_order_relaxed);
+	for(size_t arrayIt = 0; arrayIt < m_oldArrays.size(); ++arrayIt)
+		delete m_oldArrays[arrayIt];
+}
+
+void PTaskDeque::Push(PTask* task) {
+	long long bottom = m_bottom.load(std::memory_order_relaxed);
+	long long top = m_top.load(std::memory_order_acquire);
+	TaskArray* array = m_array.load(std::memory_order_relaxed);
+	if(bottom - top > array->capacity - 1) {
+		TaskArray* grownArray = new TaskArray(array->capacity * 2);
+		for(long long taskIt = top; taskIt < bottom; ++taskIt)
+			grownArray->Put(taskIt, array->Get(taskIt));
+		m_oldArrays.push_back(array);
+		array = grownArray;
+		m_array.store(array, std::memory_order_release);
+	}
+	array->Put(bottom, task);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+PTask* PTaskDeque::Pop() {
+	long long bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	TaskArray* array = m_array.load(std::memory_order_relaxed);
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long top = m_top.load(std::memory_order_relaxed);
+
+	if(top > bottom) {
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	PTask* task = array->Get(bottom);
+	if(top == bottom) {
+		// Last task in the deque, race the thieves for it
+		if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+										  std::memory_order_relaxed))
+			task = NULL;
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return task;
+}
+
+PTask* PTaskDeque::Steal() {
+	long long top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long bottom = m_bottom.load(std::memory_order_acquire);
+	if(top >= bottom)
+		return NULL;
+
+	TaskArray* array = m_array.load(std::memory_order_acquire);
+	PTask* task = array->Get(top);
+	if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+									  std::memory_order_relaxed))
+		return NULL;
+	return task;
+}
+
+bool PTaskDeque::IsEmpty() const {
+	long long top = m_top.load(std::memory_order_acquire);
+	long long bottom = m_bottom.load(std::memory_order_acquire);
+	return top >= bottom;
+}
+
+PTaskScheduler::PTaskScheduler(int nrWorkers) :
+	m_nrParked(0),
+	m_workEpoch(0),
+	m_isStopping(false) {
+	PTaskSchedulerConfig config;
+	config.nrWorkers = (nrWorkers < 1) ? 1 : nrWorkers;
+	config.avoidSmtSiblings = false;
+	Init(config);
+}
+
+PTaskScheduler::PTaskScheduler(const PTaskSchedulerConfig& config) :
+	m_nrParked(0),
+	m_workEpoch(0),
+	m_isStopping(false) {
+	Init(config);
+}
+
+void PTaskScheduler::Init(const PTaskSchedulerConfig& config) {
+	// Candidate cpus with the first logical cpu of every core in front. The
+	// topology is sorted by socket so consecutive workers share a socket
+	std::vector<int> cpus;
+	PCpuTopology topology;
+	bool needsTopology = config.pinWorkers || config.nrWorkers <= 0;
+	if(needsTopology && PGetCpuTopology(topology) == 0) {
+		std::vector<int> siblings;
+		for(size_t cpuIt = 0; cpuIt < topology.cpus.size(); ++cpuIt) {
+			const PCpuInfo& info = topology.cpus[cpuIt];
+			bool isSibling = cpuIt > 0 &&
+							 topology.cpus[cpuIt - 1].core == info.core &&
+							 topology.cpus[cpuIt - 1].socket == info.socket;
+			if(isSibling)
+				siblings.push_back(info.cpu);
+			else
+				cpus.push_back(info.cpu);
+		}
+		if(!config.avoidSmtSiblings)
+			cpus.insert(cpus.end(), siblings.begin(), siblings.end());
+	}
+
+	int nrWorkers = config.nrWorkers;
+	if(nrWorkers <= 0) {
+		int nrCpus = cpus.empty() ? PGetNrProcessors() : static_cast<int>(cpus.size());
+		nrWorkers = nrCpus - 1;
+	}
+	if(nrWorkers < 1)
+		nrWorkers = 1;
+
+	m_workers.resize(nrWorkers);
+	for(int workerIt = 0; workerIt < nrWorkers; ++workerIt) {
+		Worker* worker = new Worker();
+		worker->scheduler = this;
+		worker->index = workerIt;
+		worker->cpu = -1;
+		if(config.pinWorkers && !cpus.empty())
+			worker->cpu = cpus[workerIt % cpus.size()];
+		worker->stealSeed = 2654435761u * (workerIt + 1);
+		m_workers[workerIt] = worker;
+	}
+
+	// Start the threads only after every deque exists since they steal from
+	// each other right away
+	for(int workerIt = 0; workerIt < nrWorkers; ++workerIt) {
+		Worker* worker = m_workers[workerIt];
+		if(PStartThread(worker, WorkerMain, worker->thread) != 0)
+			Logger::getLogger().error("Failed to start a task scheduler worker\n");
+	}
+}
+
+PTaskScheduler::~PTaskScheduler() {
+	{
+		std::lock_guard<std::mutex> lock(m_parkLock);
+		m_isStopping.store(true);
+	}
+	m_parkCondition.notify_all();
+
+	// Workers steal from each other until they stop, so every thread has to
+	// be gone before any deque is freed
+	for(size_t workerIt = 0; workerIt < m_workers.size(); ++workerIt)
+		PWaitOnThread(m_workers[workerIt]->thread, NULL);
+	for(size_t workerIt = 0; workerIt < m_workers.size(); ++workerIt)
+		delete m_workers[workerIt];
+	for(size_t taskIt = 0; taskIt < m_injectedTasks.size(); ++taskIt)
+		delete m_injectedTasks[taskIt];
+}
+
+PTaskScheduler& PTaskScheduler::GetScheduler() {
+	PTaskScheduler* scheduler = schedulerInstance.load(std::memory_order_acquire);
+	if(scheduler != NULL)
+		return *scheduler;
+
+	std::lock_guard<std::mutex> lock(schedulerInstanceLock);
+	scheduler = schedulerInstance.load(std::memory_order_relaxed);
+	if(scheduler == NULL) {
+		int nrProcessors = PGetNrProcessors();
+		scheduler = new PTaskScheduler(nrProcessors > 1 ? nrProcessors - 1 : 1);
+		schedulerInstance.store(scheduler, std::memory_order_release);
+	}
+	return *scheduler;
+}
+
+void PTaskScheduler::InitScheduler(int nrWorkers) {
+	std::lock_guard<std::mutex> lock(schedulerInstanceLock);
+	PTaskScheduler* oldScheduler = schedulerInstance.load(std::memory_order_relaxed);
+	schedulerInstance.store(new PTaskScheduler(nrWorkers), std::memory_order_release);
+	delete oldScheduler;
+}
+
+void PTaskScheduler::InitScheduler(const PTaskSchedulerConfig& config) {
+	std::lock_guard<std::mutex> lock(schedulerInstanceLock);
+	PTaskScheduler* oldScheduler = schedulerInstance.load(std::memory_order_relaxed);
+	schedulerInstance.store(new PTaskScheduler(config), std::memory_order_release);
+	delete oldScheduler;
+}
+
+int PTaskScheduler::GetWorkerIndex() const {
+	return currentScheduler == this ? currentWorkerIndex : -1;
+}
+
+void* PTaskScheduler::WorkerMain(void* arg) {
+	Worker* worker = static_cast<Worker*>(arg);
+	PTaskScheduler* scheduler = worker->scheduler;
+	currentScheduler = scheduler;
+	currentWorkerIndex = worker->index;
+	if(worker->cpu >= 0)
+		PPinThreadToCpu(PGetCurrentThread(), worker->cpu);
+
+	int idleRounds = 0;
+	while(!scheduler->m_isStopping.load(std::memory_order_acquire)) {
+		unsigned epoch = scheduler->m_workEpoch.load();
+		PTask* task = scheduler->FindTask(worker);
+		if(task != NULL) {
+			scheduler->RunTask(task);
+			idleRounds = 0;
+			continue;
+		}
+
+		if(++idleRounds < idleSpinRounds) {
+			std::this_thread::yield();
+			continue;
+		}
+		scheduler->Park(epoch);
+		idleRounds = 0;
+	}
+	return NULL;
+}
+
+PTask* PTaskScheduler::FindTask(Worker* worker) {
+	PTask* task = NULL;
+	if(worker != NULL)
+		task = worker->deque.Pop();
+	if(task == NULL)
+		task = PopInjectedTask();
+	if(task == NULL) {
+		thread_local unsigned int externalSeed = 0x9e3779b9u;
+		unsigned int& seed = worker != NULL ? worker->stealSeed : externalSeed;
+		task = StealTask(seed, worker != NULL ? worker->index : -1);
+	}
+	return task;
+}
+
+PTask* PTaskScheduler::StealTask(unsigned int& seed, int skipIndex) {
+	int nrWorkers = GetNrWorkers();
+	// Start from a random victim so thieves don't all gang up on worker 0
+	seed = seed * 1103515245u + 12345u;
+	int firstVictim = (seed >> 16) % nrWorkers;
+	for(int victimIt = 0; victimIt < nrWorkers; ++victimIt) {
+		int victim = (firstVictim + victimIt) % nrWorkers;
+		if(victim == skipIndex)
+			continue;
+		PTask* task = m_workers[victim]->deque.Steal();
+		if(task != NULL)
+			return task;
+	}
+	return NULL;
+}
+
+PTask* PTaskScheduler::PopInjectedTask() {
+	std::lock_guard<std::mutex> lock(m_injectLock);
+	if(m_injectedTasks.empty())
+		return NULL;
+	PTask* task = m_injectedTasks.back();
+	m_injectedTasks.pop_back();
+	return task;
+}
+
+void PTaskScheduler::RunTask(PTask* task) {
+	task->func(task->arg);
+	task->group->m_pending.fetch_sub(1, std::memory_order_release);
+	delete task;
+}
+
+void PTaskScheduler::WakeWorkers() {
+	// Pairs with Park: either the parking worker sees the new epoch or we
+	// see it in m_nrParked and wake it up
+	m_workEpoch.fetch_add(1);
+	if(m_nrParked.load() > 0) {
+		std::lock_guard<std::mutex> lock(m_parkLock);
+		m_parkCondition.notify_one();
+	}
+}
+
+void PTaskScheduler::Park(unsigned epoch) {
+	std::unique_lock<std::mutex> lock(m_parkLock);
+	m_nrParked.fetch_add(1);
+	while(m_workEpoch.load() == epoch && !m_isStopping.load())
+		m_parkCondition.wait(lock);
+	m_nrParked.fetch_sub(1);
+}
+
+void PTaskScheduler::Spawn(PTaskGroup& group, PTaskFunc func, void* arg) {
+	PTask* task = new PTask();
+	task->func = func;
+	task->arg = arg;
+	task->group = &group;
+	group.m_pending.fetch_add(1, std::memory_order_relaxed);
+
+	int workerIndex = GetWorkerIndex();
+	if(workerIndex >= 0) {
+		m_workers[workerIndex]->deque.Push(task);
+	}
+	else {
+		std::lock_guard<std::mutex> lock(m_injectLock);
+		m_injectedTasks.push_back(task);
+	}
+	WakeWorkers();
+}
+
+void PTaskScheduler::Wait(PTaskGroup& group) {
+	int workerIndex = GetWorkerIndex();
+	Worker* worker = workerIndex >= 0 ? m_workers[workerIndex] : NULL;
+	while(!group.IsDone()) {
+		PTask* task = FindTask(worker);
+		if(task != NULL)
+			RunTask(task);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void PTaskScheduler::ParallelFor(int begin, int end, int grainSize, PRangeFunc func, void* arg) {
+	if(end <= begin)
+		return;
+
+	if(grainSize <= 0) {
+		// A few ranges per worker so the stealing can even out skewed work
+		int nrRanges = (GetNrWorkers() + 1) * 8;
+		grainSize = (end - begin + nrRanges - 1) / nrRanges;
+		if(grainSize < 1)
+			grainSize = 1;
+	}
+
+	if(end - begin <= grainSize) {
+		func(arg, begin, end);
+		return;
+	}
+
+	PTaskGroup group;
+	RangeTaskData* data = new RangeTaskData();
+	data->scheduler = this;
+	data->group = &group;
+	data->func = func;
+	data->arg = arg;
+	data->begin = begin;
+	data->end = end;
+	data->grainSize = grainSize;
+	RunRangeTask(data);
+	Wait(group);
+}
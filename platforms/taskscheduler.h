@@ -0,0 +1,163 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "platform.h"
+
+// A persistent pool of worker threads that share work by stealing from each
+// other. Every worker owns a Chase-Lev deque: the owner pushes and pops tasks
+// at the bottom without locking while idle workers steal from the top. Tasks
+// spawned from threads outside of the pool go through a locked injection
+// queue. Workers that can't find anything to do park on a condition variable
+// until new work is spawned.
+
+typedef void (*PTaskFunc)(void* arg);
+// Processes the items in [begin, end)
+typedef void (*PRangeFunc)(void* arg, int begin, int end);
+
+class PTaskGroup;
+
+struct PTaskSchedulerConfig {
+	PTaskSchedulerConfig() : nrWorkers(0), pinWorkers(false), avoidSmtSiblings(true) {}
+	// Values <= 0 pick one worker per usable cpu, minus one for the thread
+	// that waits on the work and helps out in the meantime
+	int  nrWorkers;
+	// Pins every worker to its own cpu so it can't migrate between sockets.
+	// Workers fill the physical cores of a socket before moving to the next
+	bool pinWorkers;
+	// Only hands out one logical cpu per physical core. If more workers than
+	// cores are requested they share cores instead of using the siblings
+	bool avoidSmtSiblings;
+};
+
+struct PTask {
+	PTaskFunc   func;
+	void*       arg;
+	PTaskGroup* group;
+};
+
+// Tracks a set of spawned tasks so they can be waited on together
+class PTaskGroup {
+private:
+	friend class PTaskScheduler;
+	std::atomic<int> m_pending;
+public:
+	PTaskGroup() : m_pending(0) {}
+	bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+};
+
+// Chase-Lev work stealing deque, see "Correct and Efficient Work-Stealing for
+// Weak Memory Models" by Le et al. Only the owner may call Push and Pop
+class PTaskDeque {
+private:
+	struct TaskArray {
+		TaskArray(long long capacity) : capacity(capacity), tasks(new std::atomic<PTask*>[capacity]) {}
+		~TaskArray() { delete[] tasks; }
+		PTask* Get(long long index) const { return tasks[index & (capacity - 1)].load(std::memory_order_acquire); }
+		void Put(long long index, PTask* task) { tasks[index & (capacity - 1)].store(task, std::memory_order_release); }
+		long long capacity;
+		std::atomic<PTask*>* tasks;
+	};
+
+	std::atomic<long long>  m_top;
+	std::atomic<long long>  m_bottom;
+	std::atomic<TaskArray*> m_array;
+	// Thieves might still be reading from the old arrays after a resize so we
+	// only free them when the deque goes away
+	std::vector<TaskArray*> m_oldArrays;
+
+	PTaskDeque(const PTaskDeque&);
+	PTaskDeque& operator=(const PTaskDeque&);
+public:
+	PTaskDeque();
+	~PTaskDeque();
+	void Push(PTask* task);
+	PTask* Pop();
+	PTask* Steal();
+	bool IsEmpty() const;
+};
+
+class PTaskScheduler {
+private:
+	struct Worker {
+		PTaskScheduler* scheduler;
+		PTaskDeque      deque;
+		PThreadID       thread;
+		int             index;
+		// Cpu the worker is pinned to or -1
+		int             cpu;
+		unsigned int    stealSeed;
+	};
+
+	std::vector<Worker*>     m_workers;
+	std::vector<PTask*>      m_injectedTasks;
+	std::mutex               m_injectLock;
+	std::mutex               m_parkLock;
+	std::condition_variable  m_parkCondition;
+	std::atomic<int>         m_nrParked;
+	std::atomic<unsigned>    m_workEpoch;
+	std::atomic<bool>        m_isStopping;
+
+	void Init(const PTaskSchedulerConfig& config);
+	static void* WorkerMain(void* arg);
+	PTask* FindTask(Worker* worker);
+	PTask* StealTask(unsigned int& seed, int skipIndex);
+	PTask* PopInjectedTask();
+	void RunTask(PTask* task);
+	void WakeWorkers();
+	void Park(unsigned epoch);
+
+	PTaskScheduler(const PTaskScheduler&);
+	PTaskScheduler& operator=(const PTaskScheduler&);
+public:
+	explicit PTaskScheduler(int nrWorkers);
+	explicit PTaskScheduler(const PTaskSchedulerConfig& config);
+	~PTaskScheduler();
+
+	// The process wide scheduler used by the graph algorithms. It is created
+	// on first use with one worker per online processor, minus one for the
+	// thread that waits on the work and helps out in the meantime
+	static PTaskScheduler& GetScheduler();
+	// Replaces the process wide scheduler, must not be called while it is busy
+	static void InitScheduler(int nrWorkers);
+	static void InitScheduler(const PTaskSchedulerConfig& config);
+
+	int GetNrWorkers() const { return static_cast<int>(m_workers.size()); }
+	// Index of the calling worker or -1 if called from outside of the pool
+	int GetWorkerIndex() const;
+	// Cpu the worker was pinned to or -1 if the workers aren't pinned
+	int GetWorkerCpu(int workerIndex) const { return m_workers[workerIndex]->cpu; }
+
+	void Spawn(PTaskGroup& group, PTaskFunc func, void* arg);
+	// Runs pending tasks on the calling thread until the group is done
+	void Wait(PTaskGroup& group);
+	// Splits [begin, end) in halves until the ranges are at most grainSize
+	// items long and runs them in parallel. Passing a grainSize <= 0 picks one
+	// based on the number of workers
+	void ParallelFor(int begin, int end, int grainSize, PRangeFunc func, void* arg);
+
+	template <typename Func>
+	void ParallelFor(int begin, int end, int grainSize, const Func& func) {
+		ParallelFor(begin, end, grainSize, &RangeThunk<Func>, const_cast<Func*>(&func));
+	}
+
+	template <typename Func>
+	static void RangeThunk(void* arg, int begin, int end) {
+		(*static_cast<const Func*>(arg))(begin, end);
+	}
+};
+
+// Shorthands for the process wide scheduler
+template <typename Func>
+inline void PParallelFor(int begin, int end, int grainSize, const Func& func) {
+	PTaskScheduler::GetScheduler().ParallelFor(begin, end, grainSize, func);
+}
+
+inline void PParallelFor(int begin, int end, int grainSize, PRangeFunc func, void* arg) {
+	PTaskScheduler::GetScheduler().ParallelFor(begin, end, grainSize, func, arg);
+}
+
+#endif // TASK_SCHEDULER_H
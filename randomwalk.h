@@ -0,0 +1,364 @@
+#ifndef KWGRAPH_RANDOM_WALK_H
+#define KWGRAPH_RANDOM_WALK_H
+
+#include <stdint.h>
+#include <cmath>
+#include "graphview.h"
+
+namespace KWGraph
+{
+    enum RandomWalkMode
+    {
+        // Every out edge is equally likely
+        RandomWalkMode_Uniform,
+        // Out edges are picked proportionally to their weight
+        RandomWalkMode_Weighted,
+        // Second order walk from node2vec, the weighted pick is biased by
+        // where the walk came from, see returnParam and inOutParam
+        RandomWalkMode_Node2Vec
+    };
+
+    struct RandomWalkConfig
+    {
+        RandomWalkConfig() :
+            mode(RandomWalkMode_Uniform),
+            walkLength(80),
+            walksPerNode(10),
+            returnParam(1.0f),
+            inOutParam(1.0f),
+            seed(1234) {}
+
+        RandomWalkMode  mode;
+        // Nodes per walk, the start node included
+        int             walkLength;
+        int             walksPerNode;
+        // node2vec p: going straight back is weighted by 1 / p
+        float           returnParam;
+        // node2vec q: moving away from the previous node is weighted by
+        // 1 / q, staying next to it by 1
+        float           inOutParam;
+        // The same seed produces the same walks whatever the thread count
+        uint64_t        seed;
+    };
+
+    // Small xorshift64* generator, seeded through splitmix64 so nearby
+    // seeds give unrelated streams. Every walk gets its own stream derived
+    // from the config seed and the walk index
+    class WalkRandom
+    {
+    private:
+        uint64_t m_state;
+    public:
+        explicit WalkRandom(uint64_t seed)
+        {
+            uint64_t mixed = seed + 0x9E3779B97F4A7C15ull;
+            mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ull;
+            mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBull;
+            m_state = (mixed ^ (mixed >> 31)) | 1;
+        }
+
+        inline uint64_t Next()
+        {
+            m_state ^= m_state >> 12;
+            m_state ^= m_state << 25;
+            m_state ^= m_state >> 27;
+            return m_state * 0x2545F4914F6CDD1Dull;
+        }
+
+        // Uniform in [0, bound)
+        inline int NextInt(int bound)
+        {
+            return static_cast<int>(((Next() >> 32) * (uint64_t)bound) >> 32);
+        }
+
+        // Uniform in [0, 1)
+        inline float NextFloat()
+        {
+            return (Next() >> 40) * (1.0f / 16777216.0f);
+        }
+    };
+
+    // Generates random walks over the out edges of a graph. The edges are
+    // copied into a CSR with sorted neighbor lists and one alias table per
+    // node when the walker is built, after that a weighted step costs two
+    // random numbers and no search. node2vec steps use rejection sampling:
+    // a neighbor is proposed from the weighted alias table and accepted
+    // with its bias over the largest possible bias, so no per edge second
+    // order tables are needed. Walks are written back to back into one
+    // buffer.
+    // NOTE: Changes to the graph after the walker is built are not seen
+    template <typename T>
+    class RandomWalker
+    {
+    private:
+        std::vector<int>    m_offsets;
+        std::vector<int>    m_targets;
+        // Alias tables aligned with m_targets: slot i is kept with
+        // probability m_keepChances[i] and swapped for slot m_aliases[i]
+        // otherwise
+        std::vector<float>  m_keepChances;
+        std::vector<int>    m_aliases;
+
+        // Per call state
+        const RandomWalkConfig* m_config;
+        std::vector<int>*       m_walks;
+        const std::vector<int>* m_startNodes;
+
+        RandomWalker(const RandomWalker&);
+        RandomWalker& operator=(const RandomWalker&);
+
+        // Vose's alias method over the weights of one node
+        void BuildAliasTable(int nodeId, const std::vector<T>& weights,
+                             std::vector<int>& small, std::vector<int>& large)
+        {
+            int first = m_offsets[nodeId];
+            int degree = m_offsets[nodeId + 1] - first;
+            if(degree == 0)
+                return;
+
+            double totalWeight = 0.0;
+            for(int slotIt = first; slotIt < first + degree; ++slotIt)
+                totalWeight += std::max((double)weights[slotIt], 0.0);
+            small.clear();
+            large.clear();
+            for(int slotIt = 0; slotIt < degree; ++slotIt)
+            {
+                // All zero weights fall back to a uniform pick
+                double weight = std::max((double)weights[first + slotIt], 0.0);
+                float scaled = totalWeight > 0.0 ? (float)(weight * degree / totalWeight) : 1.0f;
+                m_keepChances[first + slotIt] = scaled;
+                m_aliases[first + slotIt] = slotIt;
+                if(scaled < 1.0f)
+                    small.push_back(slotIt);
+                else
+                    large.push_back(slotIt);
+            }
+            while(!small.empty() && !large.empty())
+            {
+                int smallSlot = small.back();
+                int largeSlot = large.back();
+                small.pop_back();
+                m_aliases[first + smallSlot] = largeSlot;
+                float& largeChance = m_keepChances[first + largeSlot];
+                largeChance -= 1.0f - m_keepChances[first + smallSlot];
+                if(largeChance < 1.0f)
+                {
+                    large.pop_back();
+                    small.push_back(largeSlot);
+                }
+            }
+            // Whatever is left is 1 up to rounding errors
+            for(size_t slotIt = 0; slotIt < small.size(); ++slotIt)
+                m_keepChances[first + small[slotIt]] = 1.0f;
+            for(size_t slotIt = 0; slotIt < large.size(); ++slotIt)
+                m_keepChances[first + large[slotIt]] = 1.0f;
+        }
+
+        struct BuildData
+        {
+            RandomWalker*           walker;
+            const std::vector<T>*   weights;
+        };
+
+        static void BuildAliasTables(void* arg, int begin, int end)
+        {
+            BuildData* data = static_cast<BuildData*>(arg);
+            std::vector<int> small;
+            std::vector<int> large;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+                data->walker->BuildAliasTable(nodeIt, *data->weights, small, large);
+        }
+
+        inline int PickUniform(int nodeId, WalkRandom& random) const
+        {
+            int first = m_offsets[nodeId];
+            return m_targets[first + random.NextInt(m_offsets[nodeId + 1] - first)];
+        }
+
+        inline int PickWeighted(int nodeId, WalkRandom& random) const
+        {
+            int first = m_offsets[nodeId];
+            int slot = first + random.NextInt(m_offsets[nodeId + 1] - first);
+            if(random.NextFloat() >= m_keepChances[slot])
+                slot = first + m_aliases[slot];
+            return m_targets[slot];
+        }
+
+        inline bool IsNeighbor(int nodeId, int other) const
+        {
+            return std::binary_search(m_targets.begin() + m_offsets[nodeId],
+                                      m_targets.begin() + m_offsets[nodeId + 1], other);
+        }
+
+        static inline bool IsValidBiasParam(float param)
+        {
+            return param > 0.0f && std::isfinite(param) && std::isfinite(1.0f / param);
+        }
+
+        void RunWalk(int walkId, int startNode, WalkRandom& random) const
+        {
+            const RandomWalkConfig& config = *m_config;
+            int* walk = &(*m_walks)[(size_t)walkId * config.walkLength];
+            float returnBias = 1.0f / config.returnParam;
+            float inOutBias = 1.0f / config.inOutParam;
+            float maxBias = std::max(1.0f, std::max(returnBias, inOutBias));
+
+            if(startNode < 0 || startNode >= GetNrNodes())
+            {
+                std::fill(walk, walk + config.walkLength, INVALID_ID);
+                return;
+            }
+
+            walk[0] = startNode;
+            int previousNode = -1;
+            int crNodeId = startNode;
+            for(int stepIt = 1; stepIt < config.walkLength; ++stepIt)
+            {
+                if(m_offsets[crNodeId] == m_offsets[crNodeId + 1])
+                {
+                    // Dead end, the rest of the walk is padding
+                    std::fill(walk + stepIt, walk + config.walkLength, INVALID_ID);
+                    return;
+                }
+
+                int nextNode;
+                if(config.mode == RandomWalkMode_Uniform)
+                    nextNode = PickUniform(crNodeId, random);
+                else if(config.mode == RandomWalkMode_Weighted || previousNode == -1)
+                    nextNode = PickWeighted(crNodeId, random);
+                else
+                {
+                    for(;;)
+                    {
+                        nextNode = PickWeighted(crNodeId, random);
+                        float bias = (nextNode == previousNode) ? returnBias
+                                   : IsNeighbor(previousNode, nextNode) ? 1.0f
+                                   : inOutBias;
+                        if(random.NextFloat() * maxBias < bias)
+                            break;
+                    }
+                }
+                walk[stepIt] = nextNode;
+                previousNode = crNodeId;
+                crNodeId = nextNode;
+            }
+        }
+
+        static void RunWalks(void* arg, int begin, int end)
+        {
+            RandomWalker* walker = static_cast<RandomWalker*>(arg);
+            const std::vector<int>& startNodes = *walker->m_startNodes;
+            int nrStartNodes = static_cast<int>(startNodes.size());
+            for(int walkIt = begin; walkIt < end; ++walkIt)
+            {
+                WalkRandom random(walker->m_config->seed ^ ((uint64_t)walkIt * 0xD1B54A32D192ED03ull));
+                walker->RunWalk(walkIt, startNodes[walkIt % nrStartNodes], random);
+            }
+        }
+
+        template <typename GraphType>
+        void Build(const GraphType& graph)
+        {
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            m_offsets.assign(nrNodes + 1, 0);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                m_offsets[nodeIt + 1] = m_offsets[nodeIt] + (int)graph.Neighbors(nodeIt).size();
+
+            std::vector< std::pair<int, T> > neighbors;
+            std::vector<T> weights(m_offsets[nrNodes]);
+            m_targets.resize(m_offsets[nrNodes]);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                NeighborRange<T> range = graph.Neighbors(nodeIt);
+                neighbors.clear();
+                for(typename NeighborRange<T>::Iterator edgeIt = range.begin(); edgeIt != range.end(); ++edgeIt)
+                {
+                    NeighborView<T> edge = *edgeIt;
+                    neighbors.push_back(std::make_pair(edge.destination, edge.weight));
+                }
+                // Sorted for the node2vec neighbor test
+                std::sort(neighbors.begin(), neighbors.end());
+                for(size_t neighborIt = 0; neighborIt < neighbors.size(); ++neighborIt)
+                {
+                    m_targets[m_offsets[nodeIt] + neighborIt] = neighbors[neighborIt].first;
+                    weights[m_offsets[nodeIt] + neighborIt] = neighbors[neighborIt].second;
+                }
+            }
+
+            m_keepChances.resize(m_targets.size());
+            m_aliases.resize(m_targets.size());
+            BuildData data;
+            data.walker = this;
+            data.weights = &weights;
+            if(nrNodes > 0)
+                PParallelFor(0, nrNodes, 0, BuildAliasTables, &data);
+        }
+
+    public:
+        explicit RandomWalker(const Graph<T>& graph) :
+            m_config(NULL),
+            m_walks(NULL),
+            m_startNodes(NULL)
+        {
+            Build(graph);
+        }
+
+        // Walks only take the visible edges
+        explicit RandomWalker(const GraphView<T>& graph) :
+            m_config(NULL),
+            m_walks(NULL),
+            m_startNodes(NULL)
+        {
+            Build(graph);
+        }
+
+        inline int GetNrNodes() const { return m_offsets.empty() ? 0 : (int)m_offsets.size() - 1; }
+
+        // Runs config.walksPerNode walks from every start node. Walk i is
+        // walks[i * walkLength] .. walks[(i + 1) * walkLength] and starts at
+        // startNodes[i % startNodes.size()], so each round over the start
+        // nodes is contiguous. A walk that reaches a node without out edges
+        // is padded with INVALID_ID, and so is the whole of every walk from a
+        // start node outside the graph, which keeps the walk layout intact.
+        // node2vec needs finite positive returnParam and inOutParam, other
+        // values give no walks at all. Not reentrant
+        void GenerateWalks(const std::vector<int>& startNodes, const RandomWalkConfig& config,
+                           std::vector<int>& walks)
+        {
+            walks.clear();
+            if(startNodes.empty() || config.walkLength <= 0 || config.walksPerNode <= 0)
+                return;
+            // A zero or tiny parameter makes its bias infinite and a negative
+            // one makes it negative, either way the rejection sampling in
+            // RunWalk could never accept a step
+            if(config.mode == RandomWalkMode_Node2Vec &&
+               (!IsValidBiasParam(config.returnParam) || !IsValidBiasParam(config.inOutParam)))
+                return;
+
+            int nrWalks = static_cast<int>(startNodes.size()) * config.walksPerNode;
+            walks.resize((size_t)nrWalks * config.walkLength);
+            m_config = &config;
+            m_walks = &walks;
+            m_startNodes = &startNodes;
+            // Walks cost the same so coarse ranges are fine
+            PParallelFor(0, nrWalks, 0, RunWalks, this);
+            m_config = NULL;
+            m_walks = NULL;
+            m_startNodes = NULL;
+        }
+
+        // Walks from every node of the graph
+        void GenerateWalks(const RandomWalkConfig& config, std::vector<int>& walks)
+        {
+            std::vector<int> startNodes(GetNrNodes());
+            for(size_t nodeIt = 0; nodeIt < startNodes.size(); ++nodeIt)
+                startNodes[nodeIt] = static_cast<int>(nodeIt);
+            GenerateWalks(startNodes, config, walks);
+        }
+    };
+
+    typedef RandomWalker<int> IntRandomWalker;
+    typedef RandomWalker<float> FloatRandomWalker;
+}
+
+#endif
@@ -0,0 +1,496 @@
+#ifndef KWGRAPH_REACHABILITY_H
+#define KWGRAPH_REACHABILITY_H
+
+#include <climits>
+#include <stdint.h>
+#include "graphview.h"
+
+namespace KWGraph
+{
+    namespace
+    {
+        // Out edges in CSR so the DFS can resume a node at any slot
+        template <typename T, typename GraphType>
+        static void BuildOutEdges(const GraphType& graph, std::vector<int>& offsets, std::vector<int>& targets)
+        {
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            offsets.assign(nrNodes + 1, 0);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                offsets[nodeIt + 1] = offsets[nodeIt] + (int)graph.Neighbors(nodeIt).size();
+            targets.resize(offsets[nrNodes]);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                int slot = offsets[nodeIt];
+                NeighborRange<T> neighbors = graph.Neighbors(nodeIt);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                    targets[slot++] = edgeIt.GetDestination();
+            }
+        }
+
+        struct ReachabilityFrame
+        {
+            int node;
+            int nextSlot;
+        };
+
+        static int FindComponents(const std::vector<int>& offsets, const std::vector<int>& targets,
+                                  std::vector<int>& componentOf)
+        {
+            int nrNodes = static_cast<int>(offsets.size()) - 1;
+            componentOf.assign(nrNodes, INVALID_ID);
+            std::vector<int> discovery(nrNodes, -1);
+            std::vector<int> low(nrNodes, 0);
+            std::vector<bool> isOnStack(nrNodes, false);
+            std::vector<int> componentStack;
+            std::vector<ReachabilityFrame> stack;
+            int time = 0;
+            int nrComponents = 0;
+
+            for(int rootIt = 0; rootIt < nrNodes; ++rootIt)
+            {
+                if(discovery[rootIt] != -1)
+                    continue;
+                discovery[rootIt] = low[rootIt] = time++;
+                componentStack.push_back(rootIt);
+                isOnStack[rootIt] = true;
+                ReachabilityFrame rootFrame = { rootIt, offsets[rootIt] };
+                stack.push_back(rootFrame);
+
+                while(!stack.empty())
+                {
+                    ReachabilityFrame& frame = stack.back();
+                    int crNodeId = frame.node;
+                    if(frame.nextSlot < offsets[crNodeId + 1])
+                    {
+                        int neighbor = targets[frame.nextSlot++];
+                        if(discovery[neighbor] == -1)
+                        {
+                            discovery[neighbor] = low[neighbor] = time++;
+                            componentStack.push_back(neighbor);
+                            isOnStack[neighbor] = true;
+                            // frame is invalidated by the push
+                            ReachabilityFrame childFrame = { neighbor, offsets[neighbor] };
+                            stack.push_back(childFrame);
+                        }
+                        else if(isOnStack[neighbor])
+                            low[crNodeId] = std::min(low[crNodeId], discovery[neighbor]);
+                        continue;
+                    }
+
+                    stack.pop_back();
+                    if(!stack.empty())
+                        low[stack.back().node] = std::min(low[stack.back().node], low[crNodeId]);
+                    if(low[crNodeId] != discovery[crNodeId])
+                        continue;
+
+                    int nodeId;
+                    do
+                    {
+                        nodeId = componentStack.back();
+                        componentStack.pop_back();
+                        isOnStack[nodeId] = false;
+                        componentOf[nodeId] = nrComponents;
+                    }
+                    while(nodeId != crNodeId);
+                    ++nrComponents;
+                }
+            }
+            return nrComponents;
+        }
+
+        // The DAG of the components, sorted and without duplicate edges
+        static void BuildCondensation(const std::vector<int>& offsets, const std::vector<int>& targets,
+                                      const std::vector<int>& componentOf, int nrComponents,
+                                      std::vector<int>& componentOffsets, std::vector<int>& componentTargets)
+        {
+            std::vector< std::pair<int, int> > edges;
+            int nrNodes = static_cast<int>(componentOf.size());
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                for(int slotIt = offsets[nodeIt]; slotIt < offsets[nodeIt + 1]; ++slotIt)
+                {
+                    int targetComponent = componentOf[targets[slotIt]];
+                    if(targetComponent != componentOf[nodeIt])
+                        edges.push_back(std::make_pair(componentOf[nodeIt], targetComponent));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+            componentOffsets.assign(nrComponents + 1, 0);
+            componentTargets.resize(edges.size());
+            for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt)
+            {
+                ++componentOffsets[edges[edgeIt].first + 1];
+                componentTargets[edgeIt] = edges[edgeIt].second;
+            }
+            for(int componentIt = 0; componentIt < nrComponents; ++componentIt)
+                componentOffsets[componentIt + 1] += componentOffsets[componentIt];
+        }
+    }
+
+    // Iterative Tarjan over the edges as stored. Returns the number of
+    // components, componentOf maps every node to its component. Components
+    // are numbered in reverse topological order: an edge between two
+    // components always goes to the one with the smaller id
+    template <typename T>
+    int FindStronglyConnectedComponents(const Graph<T>& graph, std::vector<int>& componentOf)
+    {
+        std::vector<int> offsets;
+        std::vector<int> targets;
+        BuildOutEdges<T>(graph, offsets, targets);
+        return FindComponents(offsets, targets, componentOf);
+    }
+
+    template <typename T>
+    int FindStronglyConnectedComponents(const GraphView<T>& graph, std::vector<int>& componentOf)
+    {
+        std::vector<int> offsets;
+        std::vector<int> targets;
+        BuildOutEdges<T>(graph, offsets, targets);
+        return FindComponents(offsets, targets, componentOf);
+    }
+
+    // Answers "is there a path from u to v" without a BFS per query. The
+    // strongly connected components are collapsed into a DAG and every DAG
+    // node gets a few GRAIL interval labels, one per randomized DFS over the
+    // DAG. If v is reachable from u the interval of v sits inside the one of
+    // u in every labeling, so most negative queries end at the label check.
+    // The others fall back to a DFS that only enters components whose labels
+    // still contain the target. Combined with the topological component ids
+    // that is close to constant time on the graphs we see.
+    // NOTE: Changes to the graph after the index is built are not seen
+    class ReachabilityIndex
+    {
+    private:
+        std::vector<int>    m_componentOf;
+        std::vector<int>    m_offsets;
+        std::vector<int>    m_targets;
+        int                 m_nrComponents;
+        int                 m_nrLabels;
+        // Label i of component c is [m_lows[i * m_nrComponents + c],
+        // m_posts[i * m_nrComponents + c]]. Label major so the parallel
+        // build doesn't share cache lines
+        std::vector<int>    m_lows;
+        std::vector<int>    m_posts;
+        TraversalWorkspace  m_workspace;
+
+        struct LabelData
+        {
+            ReachabilityIndex*  index;
+            uint64_t            seed;
+        };
+
+        void BuildLabel(int labelIt, uint64_t seed)
+        {
+            int* lows = &m_lows[(size_t)labelIt * m_nrComponents];
+            int* posts = &m_posts[(size_t)labelIt * m_nrComponents];
+            uint64_t random = seed ^ ((uint64_t)(labelIt + 1) * 0x9E3779B97F4A7C15ull);
+            std::vector<bool> isVisited(m_nrComponents, false);
+            std::vector<ReachabilityFrame> stack;
+            // Children are visited starting at a random slot, that is enough
+            // to make the labelings differ
+            std::vector<int> firstSlots(m_nrComponents);
+            int rank = 0;
+
+            // Roots go from the highest id down, the sources of the DAG come
+            // first that way
+            for(int rootIt = m_nrComponents - 1; rootIt >= 0; --rootIt)
+            {
+                if(isVisited[rootIt])
+                    continue;
+                isVisited[rootIt] = true;
+                ReachabilityFrame rootFrame = { rootIt, 0 };
+                stack.push_back(rootFrame);
+                while(!stack.empty())
+                {
+                    ReachabilityFrame& frame = stack.back();
+                    int component = frame.node;
+                    int degree = m_offsets[component + 1] - m_offsets[component];
+                    if(frame.nextSlot == 0)
+                    {
+                        random ^= random << 13;
+                        random ^= random >> 7;
+                        random ^= random << 17;
+                        firstSlots[component] = degree ? (int)(random % (uint64_t)degree) : 0;
+                        lows[component] = INT_MAX;
+                    }
+                    if(frame.nextSlot < degree)
+                    {
+                        int slot = m_offsets[component] + (firstSlots[component] + frame.nextSlot++) % degree;
+                        int child = m_targets[slot];
+                        if(!isVisited[child])
+                        {
+                            isVisited[child] = true;
+                            ReachabilityFrame childFrame = { child, 0 };
+                            stack.push_back(childFrame);
+                        }
+                        else
+                            lows[component] = std::min(lows[component], lows[child]);
+                        continue;
+                    }
+
+                    posts[component] = rank++;
+                    lows[component] = std::min(lows[component], posts[component]);
+                    stack.pop_back();
+                    if(!stack.empty())
+                        lows[stack.back().node] = std::min(lows[stack.back().node], lows[component]);
+                }
+            }
+        }
+
+        static void BuildLabels(void* userData, int begin, int end)
+        {
+            LabelData* data = static_cast<LabelData*>(userData);
+            for(int labelIt = begin; labelIt < end; ++labelIt)
+                data->index->BuildLabel(labelIt, data->seed);
+        }
+
+        // False means target can't be reached from component
+        inline bool MayReach(int component, int target) const
+        {
+            if(component < target)
+                return false;
+            for(int labelIt = 0; labelIt < m_nrLabels; ++labelIt)
+            {
+                size_t base = (size_t)labelIt * m_nrComponents;
+                if(m_lows[base + target] < m_lows[base + component] || m_posts[base + component] < m_posts[base + target])
+                    return false;
+            }
+            return true;
+        }
+
+        template <typename T, typename GraphType>
+        void Build(const GraphType& graph, int nrLabels)
+        {
+            std::vector<int> offsets;
+            std::vector<int> targets;
+            BuildOutEdges<T>(graph, offsets, targets);
+            m_nrComponents = FindComponents(offsets, targets, m_componentOf);
+            BuildCondensation(offsets, targets, m_componentOf, m_nrComponents, m_offsets, m_targets);
+
+            m_nrLabels = std::max(nrLabels, 1);
+            m_lows.resize((size_t)m_nrLabels * m_nrComponents);
+            m_posts.resize((size_t)m_nrLabels * m_nrComponents);
+            LabelData data;
+            data.index = this;
+            data.seed = 0x2545F4914F6CDD1Dull;
+            if(m_nrComponents > 0)
+                PParallelFor(0, m_nrLabels, 1, BuildLabels, &data);
+        }
+
+        ReachabilityIndex(const ReachabilityIndex&);
+        ReachabilityIndex& operator=(const ReachabilityIndex&);
+
+    public:
+        template <typename T>
+        explicit ReachabilityIndex(const Graph<T>& graph) :
+            m_nrComponents(0),
+            m_nrLabels(0)
+        {
+            Build<T>(graph, 3);
+        }
+
+        template <typename T>
+        explicit ReachabilityIndex(const GraphView<T>& graph) :
+            m_nrComponents(0),
+            m_nrLabels(0)
+        {
+            Build<T>(graph, 3);
+        }
+
+        // More labels filter more negative queries and cost one int pair
+        // per component each
+        template <typename T>
+        ReachabilityIndex(const Graph<T>& graph, int nrLabels) :
+            m_nrComponents(0),
+            m_nrLabels(0)
+        {
+            Build<T>(graph, nrLabels);
+        }
+
+        template <typename T>
+        ReachabilityIndex(const GraphView<T>& graph, int nrLabels) :
+            m_nrComponents(0),
+            m_nrLabels(0)
+        {
+            Build<T>(graph, nrLabels);
+        }
+
+        inline int GetNrComponents() const { return m_nrComponents; }
+        inline int GetComponent(int nodeId) const { return m_componentOf[nodeId]; }
+
+        // Every node reaches itself. The workspace keeps concurrent queries
+        // apart, one per thread
+        bool CanReach(int source, int destination, TraversalWorkspace& workspace) const
+        {
+            int nrNodes = static_cast<int>(m_componentOf.size());
+            if(source < 0 || source >= nrNodes || destination < 0 || destination >= nrNodes)
+                return false;
+            int sourceComponent = m_componentOf[source];
+            int target = m_componentOf[destination];
+            if(sourceComponent == target)
+                return true;
+            if(!MayReach(sourceComponent, target))
+                return false;
+
+            workspace.Reset(m_nrComponents);
+            workspace.Visit(sourceComponent, ROOT_ID, 0);
+            workspace.queue.push_back(sourceComponent);
+            while(!workspace.queue.empty())
+            {
+                int component = workspace.queue.back();
+                workspace.queue.pop_back();
+                for(int slotIt = m_offsets[component]; slotIt < m_offsets[component + 1]; ++slotIt)
+                {
+                    int child = m_targets[slotIt];
+                    if(child == target)
+                        return true;
+                    if(workspace.IsVisited(child) || !MayReach(child, target))
+                        continue;
+                    workspace.Visit(child, component, 0);
+                    workspace.queue.push_back(child);
+                }
+            }
+            return false;
+        }
+
+        // NOTE: Not thread safe, shares the index workspace
+        bool CanReach(int source, int destination)
+        {
+            return CanReach(source, destination, m_workspace);
+        }
+    };
+
+    namespace
+    {
+        struct ClosureData
+        {
+            const std::vector<int>*     offsets;
+            const std::vector<int>*     targets;
+            const std::vector<int>*     levelOrder;
+            std::vector<uint64_t>*      rows;
+            size_t                      nrWords;
+        };
+
+        // A component reaches itself and whatever its children reach. The
+        // children are on lower levels so their rows are final
+        static void BuildClosureRows(void* userData, int begin, int end)
+        {
+            ClosureData* data = static_cast<ClosureData*>(userData);
+            size_t nrWords = data->nrWords;
+            for(int orderIt = begin; orderIt < end; ++orderIt)
+            {
+                int component = (*data->levelOrder)[orderIt];
+                uint64_t* row = &(*data->rows)[(size_t)component * nrWords];
+                row[component >> 6] |= uint64_t(1) << (component & 63);
+                for(int slotIt = (*data->offsets)[component]; slotIt < (*data->offsets)[component + 1]; ++slotIt)
+                {
+                    const uint64_t* childRow = &(*data->rows)[(size_t)(*data->targets)[slotIt] * nrWords];
+                    // Components only reach smaller ids, the words above this
+                    // one are zero in the child rows
+                    size_t nrUsedWords = (component >> 6) + 1;
+                    for(size_t wordIt = 0; wordIt < nrUsedWords; ++wordIt)
+                        row[wordIt] |= childRow[wordIt];
+                }
+            }
+        }
+    }
+
+    // Full transitive closure as one row of bits per strongly connected
+    // component, for small dense graphs where nrComponents^2 / 8 bytes is
+    // affordable. Rows are built a DAG level at a time, the rows of a level
+    // in parallel, and a child row is merged a word at a time. A query is a
+    // single bit test.
+    // NOTE: Changes to the graph after the closure is built are not seen
+    class TransitiveClosure
+    {
+    private:
+        std::vector<int>        m_componentOf;
+        size_t                  m_nrWords;
+        std::vector<uint64_t>   m_rows;
+
+        void Build(const std::vector<int>& offsets, const std::vector<int>& targets)
+        {
+            int nrComponents = FindComponents(offsets, targets, m_componentOf);
+            std::vector<int> componentOffsets;
+            std::vector<int> componentTargets;
+            BuildCondensation(offsets, targets, m_componentOf, nrComponents, componentOffsets, componentTargets);
+
+            // Level 0 are the sinks, children have smaller ids so one pass
+            // in id order is enough
+            std::vector<int> levels(nrComponents, 0);
+            int nrLevels = nrComponents ? 1 : 0;
+            for(int componentIt = 0; componentIt < nrComponents; ++componentIt)
+            {
+                for(int slotIt = componentOffsets[componentIt]; slotIt < componentOffsets[componentIt + 1]; ++slotIt)
+                    levels[componentIt] = std::max(levels[componentIt], levels[componentTargets[slotIt]] + 1);
+                nrLevels = std::max(nrLevels, levels[componentIt] + 1);
+            }
+            std::vector<int> levelOffsets(nrLevels + 1, 0);
+            for(int componentIt = 0; componentIt < nrComponents; ++componentIt)
+                ++levelOffsets[levels[componentIt] + 1];
+            for(int levelIt = 0; levelIt < nrLevels; ++levelIt)
+                levelOffsets[levelIt + 1] += levelOffsets[levelIt];
+            std::vector<int> levelOrder(nrComponents);
+            std::vector<int> fill(levelOffsets.begin(), levelOffsets.end() - 1);
+            for(int componentIt = 0; componentIt < nrComponents; ++componentIt)
+                levelOrder[fill[levels[componentIt]]++] = componentIt;
+
+            m_nrWords = (nrComponents + 63) / 64;
+            m_rows.assign(m_nrWords * nrComponents, 0);
+            ClosureData data;
+            data.offsets = &componentOffsets;
+            data.targets = &componentTargets;
+            data.levelOrder = &levelOrder;
+            data.rows = &m_rows;
+            data.nrWords = m_nrWords;
+            for(int levelIt = 0; levelIt < nrLevels; ++levelIt)
+            {
+                int levelBegin = levelOffsets[levelIt];
+                int levelEnd = levelOffsets[levelIt + 1];
+                if(levelEnd - levelBegin < 64)
+                    BuildClosureRows(&data, levelBegin, levelEnd);
+                else
+                    PParallelFor(levelBegin, levelEnd, 0, BuildClosureRows, &data);
+            }
+        }
+
+        TransitiveClosure(const TransitiveClosure&);
+        TransitiveClosure& operator=(const TransitiveClosure&);
+
+    public:
+        template <typename T>
+        explicit TransitiveClosure(const Graph<T>& graph) :
+            m_nrWords(0)
+        {
+            std::vector<int> offsets;
+            std::vector<int> targets;
+            BuildOutEdges<T>(graph, offsets, targets);
+            Build(offsets, targets);
+        }
+
+        template <typename T>
+        explicit TransitiveClosure(const GraphView<T>& graph) :
+            m_nrWords(0)
+        {
+            std::vector<int> offsets;
+            std::vector<int> targets;
+            BuildOutEdges<T>(graph, offsets, targets);
+            Build(offsets, targets);
+        }
+
+        // Every node reaches itself
+        inline bool CanReach(int source, int destination) const
+        {
+            int nrNodes = static_cast<int>(m_componentOf.size());
+            if(source < 0 || source >= nrNodes || destination < 0 || destination >= nrNodes)
+                return false;
+            int target = m_componentOf[destination];
+            return (m_rows[(size_t)m_componentOf[source] * m_nrWords + (target >> 6)] >> (target & 63)) & 1;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,570 @@
+#ifndef KWGRAPH_SEMIRING_H
+#define KWGRAPH_SEMIRING_H
+
+#include <limits>
+#include "graphview.h"
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+namespace KWGraph
+{
+    // Matrix and vector products over a semiring picked at compile time, the
+    // GraphBLAS way of writing graph algorithms. With plus-times a product
+    // with the adjacency matrix is a PageRank step, with min-plus it's a
+    // Bellman-Ford relaxation and with or-and it's a BFS level.
+    //
+    // Semirings are plain structs with static Zero, Add and Multiply. Zero
+    // is the identity of Add and absorbs Multiply. IsSaturated tells when
+    // Add can't change a value anymore so a row can stop early.
+    //
+    // A T(0) entry means "no edge" in every matrix, as in the graph's own
+    // adjacency matrix. The builders leave out 0 weight edges and the
+    // kernels skip stored zeros, so sparse and dense products agree: with
+    // min-plus 0 is never a free hop and with or-and an entry is an edge
+    // exactly when it's not 0.
+
+    template <typename T>
+    struct PlusTimesSemiring
+    {
+        typedef T ValueType;
+        static inline T Zero() { return T(0); }
+        static inline T Add(T first, T second) { return first + second; }
+        static inline T Multiply(T first, T second) { return first * second; }
+        static inline bool IsSaturated(T) { return false; }
+    };
+
+    template <typename T>
+    struct MinPlusSemiring
+    {
+        typedef T ValueType;
+        static inline T Zero()
+        {
+            return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                        : std::numeric_limits<T>::max();
+        }
+        static inline T Add(T first, T second) { return second < first ? second : first; }
+        // Zero has to stay Zero, max() + x would overflow for integers
+        static inline T Multiply(T first, T second)
+        {
+            return (first == Zero() || second == Zero()) ? Zero() : first + second;
+        }
+        static inline bool IsSaturated(T) { return false; }
+    };
+
+    template <typename T>
+    struct OrAndSemiring
+    {
+        typedef T ValueType;
+        static inline T Zero() { return T(0); }
+        static inline T Add(T first, T second) { return (first != T(0) || second != T(0)) ? T(1) : T(0); }
+        static inline T Multiply(T first, T second) { return (first != T(0) && second != T(0)) ? T(1) : T(0); }
+        static inline bool IsSaturated(T value) { return value != T(0); }
+    };
+
+    // Row compressed sparse matrix, the columns of a row are sorted. Stored
+    // zeros are read as missing entries
+    template <typename T>
+    struct CsrMatrix
+    {
+        CsrMatrix() : nrRows(0), nrColumns(0) {}
+        int                 nrRows;
+        int                 nrColumns;
+        // Entries of row i are columns/values[offsets[i]] .. [offsets[i + 1]]
+        std::vector<int>    offsets;
+        std::vector<int>    columns;
+        std::vector<T>      values;
+    };
+
+    // Row major dense matrix that doesn't own its values, like the graph
+    // adjacency matrix
+    template <typename T>
+    struct DenseMatrixView
+    {
+        DenseMatrixView(const T* values, int nrRows, int nrColumns) :
+            values(values), nrRows(nrRows), nrColumns(nrColumns) {}
+        const T*    values;
+        int         nrRows;
+        int         nrColumns;
+
+        inline const T* GetRow(int row) const { return values + (size_t)row * nrColumns; }
+    };
+
+    // Limits which entries of the output get computed, the others keep the
+    // value they had. A complemented mask computes the entries it doesn't
+    // have set
+    struct VectorMask
+    {
+        VectorMask(const std::vector<unsigned char>* values, bool isComplemented) :
+            values(values), isComplemented(isComplemented) {}
+        const std::vector<unsigned char>*   values;
+        bool                                isComplemented;
+
+        inline bool IsSet(int index) const { return ((*values)[index] != 0) != isComplemented; }
+    };
+
+    namespace
+    {
+        template <typename T, typename GraphType>
+        static void BuildCsrRows(const GraphType& graph, CsrMatrix<T>& matrix)
+        {
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            matrix.nrRows = nrNodes;
+            matrix.nrColumns = nrNodes;
+            matrix.offsets.assign(nrNodes + 1, 0);
+            matrix.columns.clear();
+            matrix.values.clear();
+            std::vector< std::pair<int, T> > row;
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                NeighborRange<T> neighbors = graph.Neighbors(nodeIt);
+                row.clear();
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    NeighborView<T> edge = *edgeIt;
+                    if(edge.weight != T(0))
+                        row.push_back(std::make_pair(edge.destination, edge.weight));
+                }
+                std::sort(row.begin(), row.end());
+                for(size_t entryIt = 0; entryIt < row.size(); ++entryIt)
+                {
+                    matrix.columns.push_back(row[entryIt].first);
+                    matrix.values.push_back(row[entryIt].second);
+                }
+                matrix.offsets[nodeIt + 1] = static_cast<int>(matrix.columns.size());
+            }
+        }
+    }
+
+    // Entry (i, j) of the adjacency matrix is the weight of the edge from i
+    // to j. Parallel edges stay separate entries, which Add then combines.
+    // 0 weight edges are left out, the matrix storage can't hold them either
+    template <typename T>
+    void BuildCsrMatrix(const Graph<T>& graph, CsrMatrix<T>& matrix)
+    {
+        BuildCsrRows(graph, matrix);
+    }
+
+    // Only the visible edges, the rows of hidden nodes are empty
+    template <typename T>
+    void BuildCsrMatrix(const GraphView<T>& graph, CsrMatrix<T>& matrix)
+    {
+        BuildCsrRows(graph, matrix);
+    }
+
+    template <typename T>
+    void TransposeCsrMatrix(const CsrMatrix<T>& matrix, CsrMatrix<T>& transposed)
+    {
+        transposed.nrRows = matrix.nrColumns;
+        transposed.nrColumns = matrix.nrRows;
+        transposed.offsets.assign(matrix.nrColumns + 1, 0);
+        for(size_t entryIt = 0; entryIt < matrix.columns.size(); ++entryIt)
+            ++transposed.offsets[matrix.columns[entryIt] + 1];
+        for(int columnIt = 0; columnIt < matrix.nrColumns; ++columnIt)
+            transposed.offsets[columnIt + 1] += transposed.offsets[columnIt];
+
+        transposed.columns.resize(matrix.columns.size());
+        transposed.values.resize(matrix.values.size());
+        std::vector<int> fill(transposed.offsets.begin(), transposed.offsets.end() - 1);
+        // Going through the rows in order keeps the new rows sorted
+        for(int rowIt = 0; rowIt < matrix.nrRows; ++rowIt)
+        {
+            for(int entryIt = matrix.offsets[rowIt]; entryIt < matrix.offsets[rowIt + 1]; ++entryIt)
+            {
+                int slot = fill[matrix.columns[entryIt]]++;
+                transposed.columns[slot] = rowIt;
+                transposed.values[slot] = matrix.values[entryIt];
+            }
+        }
+    }
+
+    template <typename T>
+    DenseMatrixView<T> GetAdjacencyMatrixView(const Graph<T>& graph)
+    {
+        int nrNodes = static_cast<int>(graph.GetNrNodes());
+        const std::vector<T>& matrix = graph.GetAdjacencyMatrix();
+        // Empty when the graph has no matrix storage
+        if(nrNodes == 0 || matrix.size() != (size_t)nrNodes * nrNodes)
+            return DenseMatrixView<T>(NULL, 0, 0);
+        return DenseMatrixView<T>(&matrix[0], nrNodes, nrNodes);
+    }
+
+    namespace
+    {
+        // The inner loops, a dense row times a dense vector and a scaled
+        // dense row added into another. The generic versions are written so
+        // the compiler can vectorize them, the SSE2 ones cover the float
+        // semirings where it can't because of the zero handling
+        template <typename Semiring>
+        struct DenseKernels
+        {
+            typedef typename Semiring::ValueType T;
+
+            static inline T DotRow(const T* row, const T* vector, int size)
+            {
+                T result = Semiring::Zero();
+                for(int columnIt = 0; columnIt < size; ++columnIt)
+                {
+                    if(row[columnIt] == T(0))
+                        continue;
+                    result = Semiring::Add(result, Semiring::Multiply(row[columnIt], vector[columnIt]));
+                    if(Semiring::IsSaturated(result))
+                        break;
+                }
+                return result;
+            }
+
+            // result[k] = result[k] + scale * row[k]
+            static inline void AddScaledRow(T* result, T scale, const T* row, int size)
+            {
+                for(int columnIt = 0; columnIt < size; ++columnIt)
+                    result[columnIt] = Semiring::Add(result[columnIt], Semiring::Multiply(scale, row[columnIt]));
+            }
+        };
+
+#if defined(__SSE2__)
+        template <>
+        struct DenseKernels< PlusTimesSemiring<float> >
+        {
+            static inline float DotRow(const float* row, const float* vector, int size)
+            {
+                // Zero entries add nothing here, no need to skip them
+                __m128 sums = _mm_setzero_ps();
+                int columnIt = 0;
+                for(; columnIt + 4 <= size; columnIt += 4)
+                    sums = _mm_add_ps(sums, _mm_mul_ps(_mm_loadu_ps(row + columnIt), _mm_loadu_ps(vector + columnIt)));
+                float lanes[4];
+                _mm_storeu_ps(lanes, sums);
+                float result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+                for(; columnIt < size; ++columnIt)
+                    result += row[columnIt] * vector[columnIt];
+                return result;
+            }
+
+            static inline void AddScaledRow(float* result, float scale, const float* row, int size)
+            {
+                __m128 scales = _mm_set1_ps(scale);
+                int columnIt = 0;
+                for(; columnIt + 4 <= size; columnIt += 4)
+                {
+                    __m128 sums = _mm_add_ps(_mm_loadu_ps(result + columnIt),
+                                             _mm_mul_ps(scales, _mm_loadu_ps(row + columnIt)));
+                    _mm_storeu_ps(result + columnIt, sums);
+                }
+                for(; columnIt < size; ++columnIt)
+                    result[columnIt] += scale * row[columnIt];
+            }
+        };
+
+        template <>
+        struct DenseKernels< MinPlusSemiring<float> >
+        {
+            typedef MinPlusSemiring<float> Semiring;
+
+            static inline float DotRow(const float* row, const float* vector, int size)
+            {
+                // A 0 entry is a missing edge, so infinity and not a free hop
+                const __m128 zeros = _mm_setzero_ps();
+                const __m128 infinities = _mm_set1_ps(Semiring::Zero());
+                __m128 minimums = infinities;
+                int columnIt = 0;
+                for(; columnIt + 4 <= size; columnIt += 4)
+                {
+                    __m128 weights = _mm_loadu_ps(row + columnIt);
+                    __m128 isMissing = _mm_cmpeq_ps(weights, zeros);
+                    __m128 sums = _mm_add_ps(weights, _mm_loadu_ps(vector + columnIt));
+                    sums = _mm_or_ps(_mm_and_ps(isMissing, infinities), _mm_andnot_ps(isMissing, sums));
+                    minimums = _mm_min_ps(minimums, sums);
+                }
+                float lanes[4];
+                _mm_storeu_ps(lanes, minimums);
+                float result = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+                for(; columnIt < size; ++columnIt)
+                {
+                    if(row[columnIt] != 0.0f)
+                        result = std::min(result, row[columnIt] + vector[columnIt]);
+                }
+                return result;
+            }
+
+            static inline void AddScaledRow(float* result, float scale, const float* row, int size)
+            {
+                __m128 scales = _mm_set1_ps(scale);
+                int columnIt = 0;
+                for(; columnIt + 4 <= size; columnIt += 4)
+                {
+                    __m128 sums = _mm_add_ps(scales, _mm_loadu_ps(row + columnIt));
+                    _mm_storeu_ps(result + columnIt, _mm_min_ps(_mm_loadu_ps(result + columnIt), sums));
+                }
+                for(; columnIt < size; ++columnIt)
+                    result[columnIt] = std::min(result[columnIt], scale + row[columnIt]);
+            }
+        };
+#endif
+
+        template <typename Semiring>
+        static inline typename Semiring::ValueType DotSparseRow(const CsrMatrix<typename Semiring::ValueType>& matrix,
+                                                               int row, const typename Semiring::ValueType* vector)
+        {
+            typedef typename Semiring::ValueType T;
+            T result = Semiring::Zero();
+            for(int entryIt = matrix.offsets[row]; entryIt < matrix.offsets[row + 1]; ++entryIt)
+            {
+                if(matrix.values[entryIt] == T(0))
+                    continue;
+                result = Semiring::Add(result, Semiring::Multiply(matrix.values[entryIt], vector[matrix.columns[entryIt]]));
+                if(Semiring::IsSaturated(result))
+                    break;
+            }
+            return result;
+        }
+
+        template <typename Semiring, typename Matrix>
+        struct ProductData
+        {
+            typedef typename Semiring::ValueType T;
+            const Matrix*       matrix;
+            const T*            input;
+            T*                  output;
+            // Columns of the dense input and output for the matrix products
+            int                 nrColumns;
+            const VectorMask*   mask;
+        };
+
+        template <typename Semiring>
+        static void MultiplySparseRows(void* userData, int begin, int end)
+        {
+            typedef typename Semiring::ValueType T;
+            ProductData< Semiring, CsrMatrix<T> >* data = static_cast<ProductData< Semiring, CsrMatrix<T> >*>(userData);
+            for(int rowIt = begin; rowIt < end; ++rowIt)
+            {
+                if(data->mask && !data->mask->IsSet(rowIt))
+                    continue;
+                data->output[rowIt] = DotSparseRow<Semiring>(*data->matrix, rowIt, data->input);
+            }
+        }
+
+        template <typename Semiring>
+        static void MultiplyDenseRows(void* userData, int begin, int end)
+        {
+            typedef typename Semiring::ValueType T;
+            ProductData< Semiring, DenseMatrixView<T> >* data = static_cast<ProductData< Semiring, DenseMatrixView<T> >*>(userData);
+            const DenseMatrixView<T>& matrix = *data->matrix;
+            for(int rowIt = begin; rowIt < end; ++rowIt)
+            {
+                if(data->mask && !data->mask->IsSet(rowIt))
+                    continue;
+                data->output[rowIt] = DenseKernels<Semiring>::DotRow(matrix.GetRow(rowIt), data->input, matrix.nrColumns);
+            }
+        }
+
+        // Row i of the output is the sum of the input rows j scaled by the
+        // entries (i, j), so the inner loop runs along contiguous rows
+        template <typename Semiring>
+        static void MultiplySparseRowsDense(void* userData, int begin, int end)
+        {
+            typedef typename Semiring::ValueType T;
+            ProductData< Semiring, CsrMatrix<T> >* data = static_cast<ProductData< Semiring, CsrMatrix<T> >*>(userData);
+            const CsrMatrix<T>& matrix = *data->matrix;
+            int nrColumns = data->nrColumns;
+            for(int rowIt = begin; rowIt < end; ++rowIt)
+            {
+                T* outputRow = data->output + (size_t)rowIt * nrColumns;
+                std::fill(outputRow, outputRow + nrColumns, Semiring::Zero());
+                for(int entryIt = matrix.offsets[rowIt]; entryIt < matrix.offsets[rowIt + 1]; ++entryIt)
+                {
+                    if(matrix.values[entryIt] == T(0))
+                        continue;
+                    const T* inputRow = data->input + (size_t)matrix.columns[entryIt] * nrColumns;
+                    DenseKernels<Semiring>::AddScaledRow(outputRow, matrix.values[entryIt], inputRow, nrColumns);
+                }
+            }
+        }
+
+        template <typename Semiring>
+        static void MultiplyDenseRowsDense(void* userData, int begin, int end)
+        {
+            typedef typename Semiring::ValueType T;
+            ProductData< Semiring, DenseMatrixView<T> >* data = static_cast<ProductData< Semiring, DenseMatrixView<T> >*>(userData);
+            const DenseMatrixView<T>& matrix = *data->matrix;
+            int nrColumns = data->nrColumns;
+            for(int rowIt = begin; rowIt < end; ++rowIt)
+            {
+                T* outputRow = data->output + (size_t)rowIt * nrColumns;
+                std::fill(outputRow, outputRow + nrColumns, Semiring::Zero());
+                const T* row = matrix.GetRow(rowIt);
+                for(int columnIt = 0; columnIt < matrix.nrColumns; ++columnIt)
+                {
+                    if(row[columnIt] == T(0))
+                        continue;
+                    const T* inputRow = data->input + (size_t)columnIt * nrColumns;
+                    DenseKernels<Semiring>::AddScaledRow(outputRow, row[columnIt], inputRow, nrColumns);
+                }
+            }
+        }
+
+        template <typename Semiring>
+        struct MaskedProductData
+        {
+            typedef typename Semiring::ValueType T;
+            const CsrMatrix<T>* first;
+            const CsrMatrix<T>* secondTransposed;
+            const CsrMatrix<T>* mask;
+            std::vector<T>*     values;
+        };
+
+        // Entry (i, j) is the dot product of row i of the first matrix and
+        // column j of the second, both sorted so it's a merge
+        template <typename Semiring>
+        static void MultiplyMaskedEntries(void* userData, int begin, int end)
+        {
+            typedef typename Semiring::ValueType T;
+            MaskedProductData<Semiring>* data = static_cast<MaskedProductData<Semiring>*>(userData);
+            const CsrMatrix<T>& first = *data->first;
+            const CsrMatrix<T>& second = *data->secondTransposed;
+            const CsrMatrix<T>& mask = *data->mask;
+            for(int rowIt = begin; rowIt < end; ++rowIt)
+            {
+                for(int maskIt = mask.offsets[rowIt]; maskIt < mask.offsets[rowIt + 1]; ++maskIt)
+                {
+                    (*data->values)[maskIt] = Semiring::Zero();
+                    if(mask.values[maskIt] == T(0))
+                        continue;
+                    int column = mask.columns[maskIt];
+                    int firstIt = first.offsets[rowIt];
+                    int firstEnd = first.offsets[rowIt + 1];
+                    int secondIt = second.offsets[column];
+                    int secondEnd = second.offsets[column + 1];
+                    T result = Semiring::Zero();
+                    while(firstIt < firstEnd && secondIt < secondEnd && !Semiring::IsSaturated(result))
+                    {
+                        int firstColumn = first.columns[firstIt];
+                        int secondColumn = second.columns[secondIt];
+                        if(firstColumn == secondColumn && first.values[firstIt] != T(0) && second.values[secondIt] != T(0))
+                            result = Semiring::Add(result, Semiring::Multiply(first.values[firstIt], second.values[secondIt]));
+                        firstIt += (firstColumn <= secondColumn);
+                        secondIt += (secondColumn <= firstColumn);
+                    }
+                    (*data->values)[maskIt] = result;
+                }
+            }
+        }
+    }
+
+    // output = matrix * input. output is resized to the number of rows
+    template <typename Semiring>
+    void MultiplyVector(const CsrMatrix<typename Semiring::ValueType>& matrix,
+                        const std::vector<typename Semiring::ValueType>& input,
+                        const VectorMask* mask,
+                        std::vector<typename Semiring::ValueType>& output)
+    {
+        typedef typename Semiring::ValueType T;
+        output.resize(matrix.nrRows, Semiring::Zero());
+        if(matrix.nrRows == 0)
+            return;
+        ProductData< Semiring, CsrMatrix<T> > data;
+        data.matrix = &matrix;
+        data.input = input.empty() ? NULL : &input[0];
+        data.output = &output[0];
+        data.nrColumns = 1;
+        data.mask = mask;
+        PParallelFor(0, matrix.nrRows, 0, MultiplySparseRows<Semiring>, &data);
+    }
+
+    template <typename Semiring>
+    void MultiplyVector(const CsrMatrix<typename Semiring::ValueType>& matrix,
+                        const std::vector<typename Semiring::ValueType>& input,
+                        std::vector<typename Semiring::ValueType>& output)
+    {
+        MultiplyVector<Semiring>(matrix, input, NULL, output);
+    }
+
+    template <typename Semiring>
+    void MultiplyVector(const DenseMatrixView<typename Semiring::ValueType>& matrix,
+                        const std::vector<typename Semiring::ValueType>& input,
+                        const VectorMask* mask,
+                        std::vector<typename Semiring::ValueType>& output)
+    {
+        typedef typename Semiring::ValueType T;
+        output.resize(matrix.nrRows, Semiring::Zero());
+        if(matrix.nrRows == 0)
+            return;
+        ProductData< Semiring, DenseMatrixView<T> > data;
+        data.matrix = &matrix;
+        data.input = input.empty() ? NULL : &input[0];
+        data.output = &output[0];
+        data.nrColumns = 1;
+        data.mask = mask;
+        PParallelFor(0, matrix.nrRows, 0, MultiplyDenseRows<Semiring>, &data);
+    }
+
+    template <typename Semiring>
+    void MultiplyVector(const DenseMatrixView<typename Semiring::ValueType>& matrix,
+                        const std::vector<typename Semiring::ValueType>& input,
+                        std::vector<typename Semiring::ValueType>& output)
+    {
+        MultiplyVector<Semiring>(matrix, input, NULL, output);
+    }
+
+    // output = matrix * input where input is a row major dense matrix with
+    // nrColumns columns and as many rows as matrix has columns
+    template <typename Semiring>
+    void MultiplyMatrix(const CsrMatrix<typename Semiring::ValueType>& matrix,
+                        const std::vector<typename Semiring::ValueType>& input, int nrColumns,
+                        std::vector<typename Semiring::ValueType>& output)
+    {
+        typedef typename Semiring::ValueType T;
+        output.resize((size_t)matrix.nrRows * nrColumns);
+        if(output.empty())
+            return;
+        ProductData< Semiring, CsrMatrix<T> > data;
+        data.matrix = &matrix;
+        data.input = input.empty() ? NULL : &input[0];
+        data.output = &output[0];
+        data.nrColumns = nrColumns;
+        data.mask = NULL;
+        PParallelFor(0, matrix.nrRows, 0, MultiplySparseRowsDense<Semiring>, &data);
+    }
+
+    template <typename Semiring>
+    void MultiplyMatrix(const DenseMatrixView<typename Semiring::ValueType>& matrix,
+                        const std::vector<typename Semiring::ValueType>& input, int nrColumns,
+                        std::vector<typename Semiring::ValueType>& output)
+    {
+        typedef typename Semiring::ValueType T;
+        output.resize((size_t)matrix.nrRows * nrColumns);
+        if(output.empty())
+            return;
+        ProductData< Semiring, DenseMatrixView<T> > data;
+        data.matrix = &matrix;
+        data.input = input.empty() ? NULL : &input[0];
+        data.output = &output[0];
+        data.nrColumns = nrColumns;
+        data.mask = NULL;
+        PParallelFor(0, matrix.nrRows, 0, MultiplyDenseRowsDense<Semiring>, &data);
+    }
+
+    // Sparse times sparse, only computing the entries in the pattern of
+    // mask. values[i] gets the entry at mask.columns[i]. The second matrix
+    // is passed transposed so its columns are sorted rows. With plus-times,
+    // A as both inputs and A as the mask this counts the triangles per edge
+    template <typename Semiring>
+    void MultiplyMaskedMatrix(const CsrMatrix<typename Semiring::ValueType>& first,
+                              const CsrMatrix<typename Semiring::ValueType>& secondTransposed,
+                              const CsrMatrix<typename Semiring::ValueType>& mask,
+                              std::vector<typename Semiring::ValueType>& values)
+    {
+        values.resize(mask.columns.size());
+        if(mask.nrRows == 0)
+            return;
+        MaskedProductData<Semiring> data;
+        data.first = &first;
+        data.secondTransposed = &secondTransposed;
+        data.mask = &mask;
+        data.values = &values;
+        PParallelFor(0, mask.nrRows, 0, MultiplyMaskedEntries<Semiring>, &data);
+    }
+}
+
+#endif
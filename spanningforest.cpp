@@ -0,0 +1,46 @@
+#include "spanningforest.h"
+
+enum ForestProfileId
+{
+	ForestProfileId_Kruskal,
+	ForestProfileId_Boruvka
+};
+
+static const char* profileNames[] = {"Kruskal", "Boruvka"};
+
+template <typename T>
+void CompareSpanningForests(KWGraph::Graph<T>& graph, const char* graphName)
+{
+	printf("%s graph: %d nodes, %d edges\n", graphName, 
+		(int)graph.GetNrNodes(), (int)graph.GetNrEdges());
+
+	KWGraph::SpanningForest<T> kruskalForest;
+	KWGraph::StartMiniProfile(ForestProfileId_Kruskal, profileNames[ForestProfileId_Kruskal]);
+	KWGraph::KruskalSpanningForest(graph, kruskalForest);
+	KWGraph::EndMiniProfile(ForestProfileId_Kruskal);
+
+	KWGraph::SpanningForest<T> boruvkaForest;
+	KWGraph::StartMiniProfile(ForestProfileId_Boruvka, profileNames[ForestProfileId_Boruvka]);
+	KWGraph::BoruvkaSpanningForest(graph, boruvkaForest);
+	KWGraph::EndMiniProfile(ForestProfileId_Boruvka);
+
+	//Both break ties by edge id so they should pick the very same forest
+	printf("Kruskal: %d edges, weight %g\n", 
+		(int)kruskalForest.edgeIds.size(), (double)kruskalForest.totalWeight);
+	printf("Boruvka: %d edges, weight %g\n", 
+		(int)boruvkaForest.edgeIds.size(), (double)boruvkaForest.totalWeight);
+}
+
+int main()
+{
+	KWGraph::FloatGraph sparseGraph;
+	sparseGraph.ThreadedInitializeGraph(200000, KWGraph::GraphCreationFlags_Sparse     |
+	                                            KWGraph::GraphCreationFlags_AllowCycles, 
+	                                    1000.0f, KWGraph::StorageType_AdjacencyList, 4);
+	CompareSpanningForests(sparseGraph, "Sparse");
+
+	KWGraph::FloatGraph denseGraph;
+	denseGraph.ThreadedInitializeGraph(3000, KWGraph::GraphCreationFlags_AllowCycles, 
+	                                   1000.0f, KWGraph::StorageType_AdjacencyList, 4);
+	CompareSpanningForests(denseGraph, "Dense");
+}
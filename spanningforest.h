@@ -0,0 +1,360 @@
+#ifndef KWGRAPH_SPANNING_FOREST_H
+#define KWGRAPH_SPANNING_FOREST_H
+
+#include <atomic>
+#include "graphview.h"
+
+namespace KWGraph
+{
+    // Minimum spanning forest over m_edges, edges are treated as undirected
+    // so the reverse edge AddListEdge creates is just another candidate that
+    // never gets picked. Ties on the weight are broken by the edge id, which
+    // keeps the forest unique and the two algorithms in agreement. On a view
+    // only the visible edges are candidates.
+    template <typename T>
+    struct SpanningForest
+    {
+        SpanningForest() : totalWeight(0) {}
+        // Ids into Graph::GetEdges(), in the order they were picked
+        std::vector<int>    edgeIds;
+        T                   totalWeight;
+    };
+
+    // Union-find with union by rank and path halving
+    class DisjointSets
+    {
+    private:
+        std::vector<int>            m_parents;
+        std::vector<unsigned char>  m_ranks;
+    public:
+        void Init(int size)
+        {
+            m_parents.resize(size);
+            m_ranks.assign(size, 0);
+            for(int setIt = 0; setIt < size; ++setIt)
+                m_parents[setIt] = setIt;
+        }
+
+        inline int Find(int id)
+        {
+            while(m_parents[id] != id)
+            {
+                m_parents[id] = m_parents[m_parents[id]];
+                id = m_parents[id];
+            }
+            return id;
+        }
+
+        // Returns false if both were already in the same set
+        inline bool Unite(int first, int second)
+        {
+            first = Find(first);
+            second = Find(second);
+            if(first == second)
+                return false;
+            if(m_ranks[first] < m_ranks[second])
+                std::swap(first, second);
+            m_parents[second] = first;
+            if(m_ranks[first] == m_ranks[second])
+                ++m_ranks[first];
+            return true;
+        }
+
+        // Find without the path halving, safe to call from several threads
+        // as long as nobody is uniting
+        inline int GetRoot(int id) const
+        {
+            while(m_parents[id] != id)
+                id = m_parents[id];
+            return id;
+        }
+
+        inline int GetSize() const { return static_cast<int>(m_parents.size()); }
+    };
+
+    namespace
+    {
+        template <typename T>
+        static inline bool IsLighterEdge(const std::vector< Edge<T> >& edges, int edgeId, int otherId)
+        {
+            const T& weight = edges[edgeId].weight;
+            const T& otherWeight = edges[otherId].weight;
+            return weight < otherWeight || (!(otherWeight < weight) && edgeId < otherId);
+        }
+
+        template <typename T>
+        struct EdgeSortData
+        {
+            const std::vector< Edge<T> >*   edges;
+            std::vector<int>*               edgeIds;
+            std::vector<int>*               sortedIds;
+            int                             chunkSize;
+            int                             nrIds;
+        };
+
+        template <typename T>
+        struct LighterEdge
+        {
+            const std::vector< Edge<T> >* edges;
+            inline bool operator()(int edgeId, int otherId) const
+            {
+                return IsLighterEdge(*edges, edgeId, otherId);
+            }
+        };
+
+        template <typename T>
+        static void SortEdgeChunks(void* userData, int begin, int end)
+        {
+            EdgeSortData<T>* data = static_cast<EdgeSortData<T>*>(userData);
+            LighterEdge<T> lighter = { data->edges };
+            for(int chunkIt = begin; chunkIt < end; ++chunkIt)
+            {
+                int first = chunkIt * data->chunkSize;
+                int last = std::min(first + data->chunkSize, data->nrIds);
+                std::sort(data->edgeIds->begin() + first, data->edgeIds->begin() + last, lighter);
+            }
+        }
+
+        // Merges pairs of neighboring sorted runs of chunkSize ids into
+        // sortedIds
+        template <typename T>
+        static void MergeEdgeChunks(void* userData, int begin, int end)
+        {
+            EdgeSortData<T>* data = static_cast<EdgeSortData<T>*>(userData);
+            LighterEdge<T> lighter = { data->edges };
+            std::vector<int>& edgeIds = *data->edgeIds;
+            for(int pairIt = begin; pairIt < end; ++pairIt)
+            {
+                int first = pairIt * 2 * data->chunkSize;
+                int middle = std::min(first + data->chunkSize, data->nrIds);
+                int last = std::min(middle + data->chunkSize, data->nrIds);
+                std::merge(edgeIds.begin() + first, edgeIds.begin() + middle,
+                           edgeIds.begin() + middle, edgeIds.begin() + last,
+                           data->sortedIds->begin() + first, lighter);
+            }
+        }
+
+        // Sorts the ids by (weight, id): one chunk per worker sorted in
+        // parallel, then rounds of parallel pairwise merges
+        template <typename T>
+        static void SortEdgeIds(const std::vector< Edge<T> >& edges, std::vector<int>& edgeIds)
+        {
+            int nrIds = static_cast<int>(edgeIds.size());
+            int nrChunks = (PTaskScheduler::GetScheduler().GetNrWorkers() + 1) * 4;
+            if(nrIds < 4096 || nrChunks < 2)
+            {
+                LighterEdge<T> lighter = { &edges };
+                std::sort(edgeIds.begin(), edgeIds.end(), lighter);
+                return;
+            }
+
+            std::vector<int> sortedIds(nrIds);
+            EdgeSortData<T> data;
+            data.edges = &edges;
+            data.edgeIds = &edgeIds;
+            data.sortedIds = &sortedIds;
+            data.chunkSize = (nrIds + nrChunks - 1) / nrChunks;
+            data.nrIds = nrIds;
+            nrChunks = (nrIds + data.chunkSize - 1) / data.chunkSize;
+            PParallelFor(0, nrChunks, 1, SortEdgeChunks<T>, &data);
+
+            while(data.chunkSize < nrIds)
+            {
+                int nrPairs = (nrIds + 2 * data.chunkSize - 1) / (2 * data.chunkSize);
+                PParallelFor(0, nrPairs, 1, MergeEdgeChunks<T>, &data);
+                std::swap(data.edgeIds, data.sortedIds);
+                data.chunkSize *= 2;
+            }
+            if(data.edgeIds != &edgeIds)
+                edgeIds.swap(sortedIds);
+        }
+
+        // Self loops never join two trees so they aren't candidates
+        template <typename T, typename GraphType>
+        static void CollectForestEdges(const GraphType& graph, std::vector<int>& edgeIds)
+        {
+            const std::vector< Edge<T> >& edges = graph.GetEdges();
+            int nrEdges = static_cast<int>(edges.size());
+            edgeIds.clear();
+            edgeIds.reserve(nrEdges);
+            for(int edgeIt = 0; edgeIt < nrEdges; ++edgeIt)
+            {
+                if(edges[edgeIt].source != edges[edgeIt].destination && IsListEdgeVisible(graph, edgeIt))
+                    edgeIds.push_back(edgeIt);
+            }
+        }
+
+        template <typename T, typename GraphType>
+        static void BuildKruskalForest(const GraphType& graph, SpanningForest<T>& forest)
+        {
+            const std::vector< Edge<T> >& edges = graph.GetEdges();
+            forest.edgeIds.clear();
+            forest.totalWeight = 0;
+
+            std::vector<int> edgeIds;
+            CollectForestEdges<T>(graph, edgeIds);
+            SortEdgeIds(edges, edgeIds);
+
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            DisjointSets trees;
+            trees.Init(nrNodes);
+            for(size_t idIt = 0; idIt < edgeIds.size(); ++idIt)
+            {
+                const Edge<T>& edge = edges[edgeIds[idIt]];
+                if(!trees.Unite(edge.source, edge.destination))
+                    continue;
+                forest.edgeIds.push_back(edgeIds[idIt]);
+                forest.totalWeight += edge.weight;
+                if(forest.edgeIds.size() + 1 == (size_t)nrNodes)
+                    break;
+            }
+        }
+    }
+
+    // Kruskal: sort the edges by weight then keep every edge that joins two
+    // different trees
+    template <typename T>
+    void KruskalSpanningForest(const Graph<T>& graph, SpanningForest<T>& forest)
+    {
+        BuildKruskalForest(graph, forest);
+    }
+
+    template <typename T>
+    void KruskalSpanningForest(const GraphView<T>& graph, SpanningForest<T>& forest)
+    {
+        BuildKruskalForest(graph, forest);
+    }
+
+    namespace
+    {
+        template <typename T>
+        struct BoruvkaData
+        {
+            const std::vector< Edge<T> >*   edges;
+            const std::vector<int>*         activeEdges;
+            // Tree each node belongs to, flattened after every round
+            std::vector<int>*               components;
+            // Lightest edge leaving each tree, -1 if none was seen yet
+            std::vector< std::atomic<int> >* lightestEdges;
+            DisjointSets*                   trees;
+        };
+
+        template <typename T>
+        static inline void OfferLightestEdge(BoruvkaData<T>* data, int component, int edgeId)
+        {
+            std::atomic<int>& lightest = (*data->lightestEdges)[component];
+            int current = lightest.load(std::memory_order_relaxed);
+            while(current == -1 || IsLighterEdge(*data->edges, edgeId, current))
+            {
+                if(lightest.compare_exchange_weak(current, edgeId, std::memory_order_relaxed))
+                    break;
+            }
+        }
+
+        template <typename T>
+        static void FindLightestEdges(void* userData, int begin, int end)
+        {
+            BoruvkaData<T>* data = static_cast<BoruvkaData<T>*>(userData);
+            const std::vector<int>& components = *data->components;
+            for(int activeIt = begin; activeIt < end; ++activeIt)
+            {
+                int edgeId = (*data->activeEdges)[activeIt];
+                const Edge<T>& edge = (*data->edges)[edgeId];
+                int sourceComponent = components[edge.source];
+                int destComponent = components[edge.destination];
+                if(sourceComponent == destComponent)
+                    continue;
+                OfferLightestEdge(data, sourceComponent, edgeId);
+                OfferLightestEdge(data, destComponent, edgeId);
+            }
+        }
+
+        template <typename T>
+        static void FlattenComponents(void* userData, int begin, int end)
+        {
+            BoruvkaData<T>* data = static_cast<BoruvkaData<T>*>(userData);
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+                (*data->components)[nodeIt] = data->trees->GetRoot(nodeIt);
+        }
+
+        template <typename T, typename GraphType>
+        static void BuildBoruvkaForest(const GraphType& graph, SpanningForest<T>& forest)
+        {
+            const std::vector< Edge<T> >& edges = graph.GetEdges();
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            forest.edgeIds.clear();
+            forest.totalWeight = 0;
+            if(nrNodes == 0)
+                return;
+
+            std::vector<int> activeEdges;
+            CollectForestEdges<T>(graph, activeEdges);
+
+            std::vector<int> components(nrNodes);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                components[nodeIt] = nodeIt;
+            std::vector< std::atomic<int> > lightestEdges(nrNodes);
+            DisjointSets trees;
+            trees.Init(nrNodes);
+
+            BoruvkaData<T> data;
+            data.edges = &edges;
+            data.activeEdges = &activeEdges;
+            data.components = &components;
+            data.lightestEdges = &lightestEdges;
+            data.trees = &trees;
+
+            while(!activeEdges.empty())
+            {
+                for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                    lightestEdges[nodeIt].store(-1, std::memory_order_relaxed);
+                PParallelFor(0, (int)activeEdges.size(), 0, FindLightestEdges<T>, &data);
+
+                // Two trees can pick the same edge, the second Unite skips it.
+                // With the id tie break the picked edges can't form a cycle
+                bool isMerged = false;
+                for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                {
+                    int edgeId = lightestEdges[nodeIt].load(std::memory_order_relaxed);
+                    if(edgeId == -1 || !trees.Unite(edges[edgeId].source, edges[edgeId].destination))
+                        continue;
+                    forest.edgeIds.push_back(edgeId);
+                    forest.totalWeight += edges[edgeId].weight;
+                    isMerged = true;
+                }
+                if(!isMerged)
+                    break;
+                PParallelFor(0, nrNodes, 0, FlattenComponents<T>, &data);
+
+                size_t nrActive = 0;
+                for(size_t activeIt = 0; activeIt < activeEdges.size(); ++activeIt)
+                {
+                    const Edge<T>& edge = edges[activeEdges[activeIt]];
+                    if(components[edge.source] != components[edge.destination])
+                        activeEdges[nrActive++] = activeEdges[activeIt];
+                }
+                activeEdges.resize(nrActive);
+            }
+        }
+    }
+
+    // Boruvka: every tree picks its lightest outgoing edge in parallel and
+    // all of them get added at once, which at least halves the number of
+    // trees per round. Edges inside a tree are dropped between rounds
+    template <typename T>
+    void BoruvkaSpanningForest(const Graph<T>& graph, SpanningForest<T>& forest)
+    {
+        BuildBoruvkaForest(graph, forest);
+    }
+
+    template <typename T>
+    void BoruvkaSpanningForest(const GraphView<T>& graph, SpanningForest<T>& forest)
+    {
+        BuildBoruvkaForest(graph, forest);
+    }
+
+    typedef SpanningForest<int> IntSpanningForest;
+    typedef SpanningForest<float> FloatSpanningForest;
+}
+
+#endif
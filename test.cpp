@@ -1,13 +1,2004 @@
+// Behavior checks for the library, returns the number of failed checks
+// Build: g++ -std=c++11 -pthread test.cpp binarylogger.cpp logger.cpp
+//        platforms/platformlinux.cpp platforms/taskscheduler.cpp
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <sched.h>
+#include <unistd.h>
+#include <thread>
 #include "graph.h"
+#include "asyncquery.h"
+#include "batchquery.h"
+#include "pathcache.h"
+#include "triangles.h"
+#include "kcore.h"
+#include "spanningforest.h"
+#include "maxflow.h"
+#include "centrality.h"
+#include "community.h"
+#include "coloring.h"
+#include "toposort.h"
+#include "biconnected.h"
+#include "randomwalk.h"
+#include "pagerank.h"
+#include "semiring.h"
+#include "reachability.h"
+#include "landmarklabels.h"
+#include "hyperanf.h"
+#include "khop.h"
+#include "binarylogger.h"
+
+namespace {
+int nrFailures = 0;
+
+#define KW_CHECK(condition)                                                    \
+	do {                                                                       \
+		if(!(condition)) {                                                     \
+			printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition);      \
+			++nrFailures;                                                      \
+		}                                                                      \
+	} while(0)
+
+// Reads a closed binary log back and counts its events, the slots of the
+// first event end up in firstSlots
+int ReadBinaryLog(const char* path, std::vector<uint64_t>& firstSlots)
+{
+	std::vector<char> contents;
+	FILE* logFile = fopen(path, "rb");
+	if(logFile == NULL)
+		return -1;
+	char buffer[4096];
+	size_t readSize;
+	while((readSize = fread(buffer, 1, sizeof(buffer), logFile)) > 0)
+		contents.insert(contents.end(), buffer, buffer + readSize);
+	fclose(logFile);
+	if(contents.size() < sizeof(BinaryLogFileHeader))
+		return -1;
+
+	int nrEvents = 0;
+	size_t offset = sizeof(BinaryLogFileHeader);
+	while(offset + sizeof(uint64_t) * 2 <= contents.size()) {
+		uint16_t kind;
+		memcpy(&kind, &contents[offset], sizeof(kind));
+		if(kind == BinaryLogRecordKind_Format) {
+			BinaryLogFormatRecord format;
+			memcpy(&format, &contents[offset], sizeof(format));
+			offset += sizeof(format) + format.length;
+		}
+		else if(kind == BinaryLogRecordKind_Event) {
+			BinaryLogEventRecord event;
+			memcpy(&event, &contents[offset], sizeof(event));
+			if(nrEvents++ == 0) {
+				firstSlots.resize(event.nrArgs);
+				memcpy(firstSlots.data(), &contents[offset + sizeof(event)], event.nrArgs * sizeof(uint64_t));
+			}
+			offset += sizeof(event) + event.nrArgs * sizeof(uint64_t);
+		}
+		else {
+			break;
+		}
+	}
+	return nrEvents;
+}
+
+// Undirected graph where every pair of nodes is connected with the given
+// chance, same seed same graph
+void MakeRandomGraph(KWGraph::IntGraph& graph, int nrNodes, int edgePercent, KWGraph::StorageType storage,
+					 unsigned int seed)
+{
+	graph.InitializeGraph(0, 0, 1, storage);
+	srand(seed);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+		graph.AddNode(1);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		for(int otherIt = nodeIt + 1; otherIt < nrNodes; ++otherIt) {
+			if(rand() % 100 < edgePercent)
+				graph.AddEdge(nodeIt, otherIt, 1 + rand() % 9, true);
+		}
+	}
+}
+
+// Plain queue based hop distances, the reference the traversals are held to
+template <typename GraphType>
+std::vector<int> ReferenceDistances(const GraphType& graph, int source)
+{
+	std::vector<int> distances(graph.GetNrNodes(), -1);
+	std::vector<int> queue(1, source);
+	distances[source] = 0;
+	for(size_t queueIt = 0; queueIt < queue.size(); ++queueIt) {
+		int node = queue[queueIt];
+		KWGraph::NeighborRange<int> neighbors = graph.Neighbors(node);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it) {
+			int neighbor = it.GetDestination();
+			if(distances[neighbor] == -1) {
+				distances[neighbor] = distances[node] + 1;
+				queue.push_back(neighbor);
+			}
+		}
+	}
+	return distances;
+}
+
+// Symmetric yes/no adjacency without self loops for the brute force checks
+template <typename GraphType>
+std::vector< std::vector<bool> > MakeAdjacencyMatrix(const GraphType& graph)
+{
+	size_t nrNodes = graph.GetNrNodes();
+	std::vector< std::vector<bool> > isAdjacent(nrNodes, std::vector<bool>(nrNodes, false));
+	for(size_t nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		KWGraph::NeighborRange<int> neighbors = graph.Neighbors(nodeIt);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it) {
+			if(it.GetDestination() == (int)nodeIt)
+				continue;
+			isAdjacent[nodeIt][it.GetDestination()] = true;
+			isAdjacent[it.GetDestination()][nodeIt] = true;
+		}
+	}
+	return isAdjacent;
+}
+
+void TestBinaryLogger()
+{
+	const char* path = "/tmp/kwgraph_test.binlog";
+	BinaryLogger& logger = BinaryLogger::getBinaryLogger();
+	logger.setLoggingLevel(LogLevel_Debug);
+	KW_CHECK(logger.open(path, 1 << 20));
+	// Like Logger only the levels above the current one are kept
+	KW_BINARY_LOG(LogLevel_Debug, "filtered %d\n", 1);
+	KW_BINARY_LOG(LogLevel_Warn, "width %*d char %c\n", 6, 42, 'x');
+	logger.close();
+
+	std::vector<uint64_t> slots;
+	KW_CHECK(ReadBinaryLog(path, slots) == 1);
+	KW_CHECK(slots.size() == 3 && slots[0] == 6 && slots[1] == 42 && slots[2] == 'x');
+
+	// Closing while other threads log must neither lose track of a record
+	// nor write into the unmapped file
+	const int nrThreads = 4;
+	const int nrRecords = 20000;
+	uint64_t droppedBefore = logger.getDroppedRecords();
+	KW_CHECK(logger.open(path, 1 << 20));
+	std::vector<std::thread> writers;
+	for(int threadIt = 0; threadIt < nrThreads; ++threadIt) {
+		writers.push_back(std::thread([threadIt]() {
+			for(int recordIt = 0; recordIt < nrRecords; ++recordIt)
+				KW_BINARY_LOG(LogLevel_Error, "thread %d record %d\n", threadIt, recordIt);
+		}));
+	}
+	std::this_thread::yield();
+	logger.close();
+	for(int threadIt = 0; threadIt < nrThreads; ++threadIt)
+		writers[threadIt].join();
+	uint64_t nrDropped = logger.getDroppedRecords() - droppedBefore;
+	KW_CHECK(ReadBinaryLog(path, slots) + nrDropped == (uint64_t)nrThreads * nrRecords);
+	remove(path);
+}
+
+void TestTaskScheduler()
+{
+	// Every item is visited once, also when the ranges spawn nested loops
+	const int nrItems = 10000;
+	std::vector< std::atomic<int> > visits(nrItems);
+	for(int itemIt = 0; itemIt < nrItems; ++itemIt)
+		visits[itemIt].store(0);
+	PParallelFor(0, nrItems / 100, 1, [&visits](int begin, int end) {
+		for(int blockIt = begin; blockIt < end; ++blockIt) {
+			PParallelFor(blockIt * 100, (blockIt + 1) * 100, 7, [&visits](int first, int last) {
+				for(int itemIt = first; itemIt < last; ++itemIt)
+					visits[itemIt].fetch_add(1);
+			});
+		}
+	});
+	int nrWrong = 0;
+	for(int itemIt = 0; itemIt < nrItems; ++itemIt)
+		nrWrong += visits[itemIt].load() != 1;
+	KW_CHECK(nrWrong == 0);
+
+	PTaskScheduler scheduler(3);
+	KW_CHECK(scheduler.GetNrWorkers() == 3);
+	std::atomic<int> nrRuns(0);
+	PTaskGroup group;
+	for(int taskIt = 0; taskIt < 500; ++taskIt)
+		scheduler.Spawn(group, [](void* arg) { static_cast<std::atomic<int>*>(arg)->fetch_add(1); }, &nrRuns);
+	scheduler.Wait(group);
+	KW_CHECK(group.IsDone() && nrRuns.load() == 500);
+}
+
+void TestCpuTopology()
+{
+	PCpuTopology topology;
+	KW_CHECK(PGetCpuTopology(topology) == 0);
+	KW_CHECK(!topology.cpus.empty());
+	KW_CHECK(topology.nrCores >= 1 && topology.nrCores <= (int)topology.cpus.size());
+	KW_CHECK(topology.nrSockets >= 1 && topology.nrSockets <= topology.nrCores);
+	bool isSorted = true;
+	for(size_t cpuIt = 1; cpuIt < topology.cpus.size(); ++cpuIt) {
+		const PCpuInfo& previous = topology.cpus[cpuIt - 1];
+		const PCpuInfo& info = topology.cpus[cpuIt];
+		if(previous.socket != info.socket)
+			isSorted &= previous.socket < info.socket;
+		else if(previous.core != info.core)
+			isSorted &= previous.core < info.core;
+		else
+			isSorted &= previous.cpu < info.cpu;
+	}
+	KW_CHECK(isSorted);
+
+	// A pinned thread only runs on its cpu
+	int cpu = topology.cpus.back().cpu;
+	int runningCpu = -1;
+	std::thread pinned([cpu, &runningCpu]() {
+		if(PPinThreadToCpu(PGetCurrentThread(), cpu) == 0)
+			runningCpu = sched_getcpu();
+	});
+	pinned.join();
+	KW_CHECK(runningCpu == cpu);
+
+	PTaskSchedulerConfig config;
+	config.nrWorkers = 2;
+	config.pinWorkers = true;
+	PTaskScheduler scheduler(config);
+	bool isKnownCpu = false;
+	for(size_t cpuIt = 0; cpuIt < topology.cpus.size(); ++cpuIt)
+		isKnownCpu |= topology.cpus[cpuIt].cpu == scheduler.GetWorkerCpu(1);
+	KW_CHECK(isKnownCpu);
+}
+
+void TestAsyncQueries()
+{
+	KWGraph::IntGraph graph;
+	graph.InitializeGraph(10, KWGraph::GraphCreationFlags_Connected, 1, KWGraph::StorageType_AdjacencyList);
+	KWGraph::IntAsyncQueryEngine engine(&graph);
+
+	// Ids outside of the graph find nothing instead of running a BFS
+	KWGraph::PathFuture outOfRange = engine.ShortestPath(0, 50);
+	KWGraph::PathFuture invalidSource = engine.ShortestPath(KWGraph::INVALID_ID, 1);
+	KWGraph::DistancesFuture invalidDistances = engine.Distances(10);
+	KW_CHECK(outOfRange.Wait() == KWGraph::QueryStatus_Done);
+	KW_CHECK(!outOfRange.Get().found && outOfRange.Get().path.empty());
+	KW_CHECK(!invalidSource.Get().found && invalidSource.Get().path.empty());
+	bool isUnreachable = invalidDistances.Get().size() == 10;
+	for(size_t nodeIt = 0; nodeIt < invalidDistances.Get().size(); ++nodeIt)
+		isUnreachable &= invalidDistances.Get()[nodeIt] == -1;
+	KW_CHECK(isUnreachable);
+
+	KWGraph::PathFuture path = engine.ShortestPath(0, 9);
+	KWGraph::DistancesFuture distances = engine.Distances(0);
+	KW_CHECK(path.Get().found && path.Get().path.front() == 0 && path.Get().path.back() == 9);
+	KW_CHECK((int)path.Get().path.size() == distances.Get()[9] + 1);
+	KWGraph::ComponentsFuture components = engine.Components();
+	KW_CHECK(components.Get().nrComponents == 1);
+}
+
+void TestBatchQueries()
+{
+	KWGraph::IntGraph graph;
+	graph.InitializeGraph(10, KWGraph::GraphCreationFlags_Connected, 1, KWGraph::StorageType_AdjacencyList);
+	KWGraph::IntBatchQueryEngine engine(&graph);
+
+	std::vector<KWGraph::PathQuery> queries;
+	queries.push_back(KWGraph::PathQuery());
+	queries.push_back(KWGraph::PathQuery(0, 50));
+	queries.push_back(KWGraph::PathQuery(12, 3));
+	std::vector<KWGraph::PathQueryResult> results;
+	engine.ShortestPaths(queries, results);
+	KW_CHECK(results.size() == 3);
+	for(size_t queryIt = 0; queryIt < results.size(); ++queryIt)
+		KW_CHECK(!results[queryIt].found && results[queryIt].path.empty());
+
+	// Valid queries next to invalid ones are answered like the path cache does
+	KWGraph::IntShortestPathCache cache(&graph, 1 << 20);
+	for(int source = 0; source < 10; ++source)
+		queries.push_back(KWGraph::PathQuery(source, 9 - source));
+	engine.ShortestPaths(queries, results);
+	std::vector<int> path;
+	for(size_t queryIt = 3; queryIt < queries.size(); ++queryIt) {
+		KW_CHECK(cache.GetPath(queries[queryIt].source, queries[queryIt].destination, path));
+		KW_CHECK(results[queryIt].found && results[queryIt].path.size() == path.size());
+	}
+	KW_CHECK(!results[0].found && !results[1].found && !results[2].found);
+}
+
+void TestPathCache()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 60, 4, KWGraph::StorageType_AdjacencyList, 56);
+	KWGraph::IntShortestPathCache cache(&graph, 1 << 20);
+
+	// Every path is as long as the BFS distance and made of edges
+	int nrWrong = 0;
+	std::vector<int> path;
+	for(int source = 0; source < 60; source += 7) {
+		std::vector<int> distances = ReferenceDistances(graph, source);
+		for(int destination = 0; destination < 60; ++destination) {
+			bool found = cache.GetPath(source, destination, path);
+			nrWrong += found != (distances[destination] != -1);
+			nrWrong += cache.GetDistance(source, destination) != distances[destination];
+			if(!found)
+				continue;
+			nrWrong += path.front() != source || path.back() != destination;
+			for(size_t pathIt = 1; pathIt < path.size(); ++pathIt) {
+				std::vector<int> hop = ReferenceDistances(graph, path[pathIt - 1]);
+				nrWrong += hop[path[pathIt]] != 1;
+			}
+		}
+	}
+	KW_CHECK(nrWrong == 0);
+	KW_CHECK(cache.GetNrMisses() == 9 && cache.GetNrCachedTrees() == 9);
+	KW_CHECK(cache.GetNrHits() > 0);
+	KW_CHECK(!cache.GetPath(0, 60, path) && path.empty());
+
+	// Adding an edge drops the cached trees
+	graph.AddEdge(0, 59, 1, true);
+	KW_CHECK(cache.GetDistance(0, 59) == 1);
+	KW_CHECK(cache.GetNrCachedTrees() == 1);
+
+	// A budget below a single tree still answers, nothing is kept
+	cache.SetMemoryBudget(1);
+	KW_CHECK(cache.GetDistance(7, 7) == 0 && cache.GetDistance(14, 14) == 0);
+	KW_CHECK(cache.GetNrCachedTrees() == 0 && cache.GetMemoryUsed() == 0);
+
+	// The stats can be read while other threads look paths up
+	cache.SetMemoryBudget(1 << 20);
+	std::atomic<bool> isDone(false);
+	std::atomic<int> nrWrongLookups(0);
+	std::vector< std::vector<int> > allDistances;
+	for(int source = 0; source < 60; ++source)
+		allDistances.push_back(ReferenceDistances(graph, source));
+	std::vector<std::thread> readers;
+	for(int threadIt = 0; threadIt < 3; ++threadIt) {
+		readers.push_back(std::thread([threadIt, &cache, &allDistances, &nrWrongLookups]() {
+			for(int lookupIt = 0; lookupIt < 200; ++lookupIt) {
+				int source = (lookupIt + threadIt) % 60;
+				int destination = (lookupIt * 7) % 60;
+				nrWrongLookups += cache.GetDistance(source, destination) != allDistances[source][destination];
+			}
+		}));
+	}
+	size_t lastNrLookups = 0;
+	int nrDecreases = 0;
+	std::thread statsReader([&cache, &isDone, &lastNrLookups, &nrDecreases]() {
+		while(!isDone) {
+			size_t nrLookups = cache.GetNrHits() + cache.GetNrMisses();
+			nrDecreases += nrLookups < lastNrLookups;
+			lastNrLookups = nrLookups;
+			cache.GetNrCachedTrees();
+			cache.GetMemoryUsed();
+		}
+	});
+	for(size_t threadIt = 0; threadIt < readers.size(); ++threadIt)
+		readers[threadIt].join();
+	isDone = true;
+	statsReader.join();
+	KW_CHECK(nrWrongLookups == 0 && nrDecreases == 0);
+	KW_CHECK(cache.GetNrCachedTrees() > 0 && cache.GetMemoryUsed() > 0);
+}
+
+void TestTraversalRanges()
+{
+	const KWGraph::StorageType storages[] = { KWGraph::StorageType_AdjacencyList,
+											  KWGraph::StorageType_AdjacencyMatrix };
+	for(int storageIt = 0; storageIt < 2; ++storageIt) {
+		KWGraph::IntGraph graph;
+		MakeRandomGraph(graph, 80, 4, storages[storageIt], 57);
+		std::vector<int> distances = ReferenceDistances(graph, 5);
+
+		// BFS hands out the nodes by level with the same distances as the
+		// reference and a parent one level up
+		int nrWrong = 0;
+		int nrBFSNodes = 0;
+		int lastDistance = 0;
+		KWGraph::BFSNodeRange<int> bfs = graph.BFSRange(5);
+		for(KWGraph::BFSNodeRange<int>::Iterator it = bfs.begin(); it != bfs.end(); ++it) {
+			++nrBFSNodes;
+			nrWrong += it.GetDistance() != distances[it->id] || it.GetDistance() < lastDistance;
+			lastDistance = it.GetDistance();
+			if(it->id != 5)
+				nrWrong += distances[it.GetParent()] != it.GetDistance() - 1;
+		}
+		int nrReachable = 0;
+		for(size_t nodeIt = 0; nodeIt < distances.size(); ++nodeIt)
+			nrReachable += distances[nodeIt] != -1;
+		KW_CHECK(nrReachable > 40);
+		KW_CHECK(nrWrong == 0 && nrBFSNodes == nrReachable);
+
+		// DFS reaches the same nodes once each, every parent was handed out
+		// before its child and is a neighbor of it
+		std::vector<int> order(80, -1);
+		int nrDFSNodes = 0;
+		KWGraph::TraversalWorkspace workspace;
+		KWGraph::DFSNodeRange<int> dfs = graph.DFSRange(5, workspace);
+		for(KWGraph::DFSNodeRange<int>::Iterator it = dfs.begin(); it != dfs.end(); ++it) {
+			nrWrong += order[it->id] != -1 || distances[it->id] == -1;
+			order[it->id] = nrDFSNodes++;
+			if(it->id == 5)
+				continue;
+			int parent = it.GetParent();
+			nrWrong += order[parent] == -1 || ReferenceDistances(graph, parent)[it->id] != 1;
+			nrWrong += it.GetDistance() != workspace.GetDistance(parent) + 1;
+		}
+		KW_CHECK(nrWrong == 0 && nrDFSNodes == nrReachable);
+
+		// Skipping the children of the source ends the traversal
+		int nrSkipped = 0;
+		KWGraph::BFSNodeRange<int> skipped = graph.BFSRange(5);
+		for(KWGraph::BFSNodeRange<int>::Iterator it = skipped.begin(); it != skipped.end(); ++it) {
+			++nrSkipped;
+			it.SkipChildren();
+		}
+		KW_CHECK(nrSkipped == 1);
+		KWGraph::BFSNodeRange<int> outOfRange = graph.BFSRange(80);
+		KW_CHECK(outOfRange.begin() == outOfRange.end());
+	}
+}
+
+void TestNeighborRange()
+{
+	// The same edges built into a list and into a matrix read back the same
+	KWGraph::IntGraph listGraph;
+	KWGraph::IntGraph matrixGraph;
+	MakeRandomGraph(listGraph, 50, 10, KWGraph::StorageType_AdjacencyList, 58);
+	MakeRandomGraph(matrixGraph, 50, 10, KWGraph::StorageType_AdjacencyMatrix, 58);
+	KW_CHECK(listGraph.GetNrEdges() > 0 && matrixGraph.GetNrEdges() == 0);
+
+	int nrWrong = 0;
+	const std::vector<int>& matrix = matrixGraph.GetAdjacencyMatrix();
+	for(int nodeIt = 0; nodeIt < 50; ++nodeIt) {
+		std::vector< std::pair<int, int> > listNeighbors;
+		KWGraph::NeighborRange<int> neighbors = listGraph.Neighbors(nodeIt);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it) {
+			KWGraph::NeighborView<int> view = *it;
+			const KWGraph::Edge<int>& edge = listGraph.GetEdges()[view.edgeId];
+			nrWrong += edge.source != nodeIt || edge.destination != view.destination || edge.weight != view.weight;
+			listNeighbors.push_back(std::make_pair(view.destination, view.weight));
+		}
+		nrWrong += neighbors.IsMatrixRow() || neighbors.size() != listNeighbors.size();
+
+		std::vector< std::pair<int, int> > matrixNeighbors;
+		neighbors = matrixGraph.Neighbors(nodeIt);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it) {
+			KWGraph::NeighborView<int> view = *it;
+			nrWrong += view.edgeId != KWGraph::INVALID_ID || it.GetDestination() != view.destination;
+			nrWrong += matrix[nodeIt * 50 + view.destination] != view.weight;
+			matrixNeighbors.push_back(std::make_pair(view.destination, view.weight));
+		}
+		nrWrong += !neighbors.IsMatrixRow() || neighbors.size() != matrixNeighbors.size();
+
+		std::sort(listNeighbors.begin(), listNeighbors.end());
+		nrWrong += listNeighbors != matrixNeighbors;
+	}
+	KW_CHECK(nrWrong == 0);
+}
+
+void TestTriangles()
+{
+	KWGraph::IntGraph listGraph;
+	KWGraph::IntGraph matrixGraph;
+	MakeRandomGraph(listGraph, 40, 25, KWGraph::StorageType_AdjacencyList, 59);
+	MakeRandomGraph(matrixGraph, 40, 25, KWGraph::StorageType_AdjacencyMatrix, 59);
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(listGraph);
+
+	long long nrTriangles = 0;
+	std::vector<long long> nodeTriangles(40, 0);
+	for(int first = 0; first < 40; ++first) {
+		for(int second = first + 1; second < 40; ++second) {
+			for(int third = second + 1; third < 40; ++third) {
+				if(isAdjacent[first][second] && isAdjacent[second][third] && isAdjacent[first][third]) {
+					++nrTriangles;
+					++nodeTriangles[first];
+					++nodeTriangles[second];
+					++nodeTriangles[third];
+				}
+			}
+		}
+	}
+	KW_CHECK(nrTriangles > 0);
+
+	std::vector<long long> counted;
+	KW_CHECK(KWGraph::CountTriangles(listGraph, counted) == nrTriangles);
+	KW_CHECK(counted == nodeTriangles);
+	KW_CHECK(KWGraph::CountTriangles(matrixGraph) == nrTriangles);
+	KW_CHECK(KWGraph::CountMatrixTriangles(matrixGraph) == nrTriangles);
+
+	std::vector<double> coefficients;
+	KWGraph::ClusteringCoefficients(listGraph, coefficients);
+	int nrWrong = 0;
+	for(int nodeIt = 0; nodeIt < 40; ++nodeIt) {
+		double degree = (double)std::count(isAdjacent[nodeIt].begin(), isAdjacent[nodeIt].end(), true);
+		double expected = degree < 2 ? 0.0 : 2.0 * nodeTriangles[nodeIt] / (degree * (degree - 1));
+		nrWrong += fabs(coefficients[nodeIt] - expected) > 1e-9;
+	}
+	KW_CHECK(nrWrong == 0);
+}
+
+void TestCoreNumbers()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 60, 12, KWGraph::StorageType_AdjacencyList, 60);
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(graph);
+
+	// The k-core is what is left after removing nodes with fewer than k
+	// neighbors until none are left
+	std::vector<int> expected(60, 0);
+	for(int k = 1; k < 60; ++k) {
+		std::vector<bool> isInCore(60, true);
+		bool isChanged = true;
+		while(isChanged) {
+			isChanged = false;
+			for(int nodeIt = 0; nodeIt < 60; ++nodeIt) {
+				if(!isInCore[nodeIt])
+					continue;
+				int degree = 0;
+				for(int otherIt = 0; otherIt < 60; ++otherIt)
+					degree += isInCore[otherIt] && isAdjacent[nodeIt][otherIt];
+				if(degree < k) {
+					isInCore[nodeIt] = false;
+					isChanged = true;
+				}
+			}
+		}
+		for(int nodeIt = 0; nodeIt < 60; ++nodeIt) {
+			if(isInCore[nodeIt])
+				expected[nodeIt] = k;
+		}
+	}
+	KW_CHECK(*std::max_element(expected.begin(), expected.end()) >= 3);
+
+	std::vector<int> coreNumbers;
+	KWGraph::ComputeCoreNumbers(graph, coreNumbers);
+	KW_CHECK(coreNumbers == expected);
+	KWGraph::ComputeCoreNumbersPeeling(graph, coreNumbers);
+	KW_CHECK(coreNumbers == expected);
+}
+
+// Prim over the lightest edge between every pair, returns the forest weight
+// and leaves its number of edges in nrEdges
+template <typename GraphType>
+int ReferenceForestWeight(const GraphType& graph, int& nrEdges)
+{
+	const int noEdge = 1 << 30;
+	int nrNodes = (int)graph.GetNrNodes();
+	std::vector< std::vector<int> > weights(nrNodes, std::vector<int>(nrNodes, noEdge));
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		KWGraph::NeighborRange<int> neighbors = graph.Neighbors(nodeIt);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it) {
+			KWGraph::NeighborView<int> edge = *it;
+			int& weight = weights[nodeIt][edge.destination];
+			weight = std::min(weight, edge.weight);
+			weights[edge.destination][nodeIt] = weight;
+		}
+	}
+
+	int totalWeight = 0;
+	nrEdges = 0;
+	std::vector<bool> isInTree(nrNodes, false);
+	std::vector<int> bestWeights(nrNodes, noEdge);
+	for(int rootIt = 0; rootIt < nrNodes; ++rootIt) {
+		if(isInTree[rootIt])
+			continue;
+		bestWeights[rootIt] = 0;
+		while(true) {
+			int next = -1;
+			for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+				if(!isInTree[nodeIt] && bestWeights[nodeIt] != noEdge &&
+				   (next == -1 || bestWeights[nodeIt] < bestWeights[next]))
+					next = nodeIt;
+			}
+			if(next == -1)
+				break;
+			isInTree[next] = true;
+			if(next != rootIt) {
+				totalWeight += bestWeights[next];
+				++nrEdges;
+			}
+			for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+				bestWeights[nodeIt] = std::min(bestWeights[nodeIt], weights[next][nodeIt]);
+		}
+	}
+	return totalWeight;
+}
+
+template <typename GraphType>
+void CheckSpanningForests(const GraphType& graph)
+{
+	int nrEdges = 0;
+	int weight = ReferenceForestWeight(graph, nrEdges);
+	KWGraph::IntSpanningForest kruskalForest;
+	KWGraph::IntSpanningForest boruvkaForest;
+	KWGraph::KruskalSpanningForest(graph, kruskalForest);
+	KWGraph::BoruvkaSpanningForest(graph, boruvkaForest);
+	KW_CHECK(kruskalForest.totalWeight == weight && (int)kruskalForest.edgeIds.size() == nrEdges);
+	KW_CHECK(boruvkaForest.totalWeight == weight && (int)boruvkaForest.edgeIds.size() == nrEdges);
+
+	// The id tie break makes both pick the very same edges
+	std::sort(kruskalForest.edgeIds.begin(), kruskalForest.edgeIds.end());
+	std::sort(boruvkaForest.edgeIds.begin(), boruvkaForest.edgeIds.end());
+	KW_CHECK(kruskalForest.edgeIds == boruvkaForest.edgeIds);
+}
+
+void TestSpanningForests()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 70, 6, KWGraph::StorageType_AdjacencyList, 61);
+	CheckSpanningForests(graph);
+
+	// A view leaves out the light edges and the edges of a hidden node
+	KWGraph::IntGraphView view(&graph);
+	view.FilterEdges(KWGraph::MinEdgeWeight<int>(4));
+	view.SetNodeVisible(3, false);
+	CheckSpanningForests(view);
+	int nrViewEdges = 0;
+	int nrGraphEdges = 0;
+	KW_CHECK(ReferenceForestWeight(view, nrViewEdges) != ReferenceForestWeight(graph, nrGraphEdges));
+}
+
+// Compares every source and sink pair against the cheapest of all cuts
+template <typename GraphType>
+void CheckMaxFlows(const GraphType& graph)
+{
+	const std::vector< KWGraph::Edge<int> >& edges = graph.GetEdges();
+	int nrNodes = (int)graph.GetNrNodes();
+	KWGraph::MaxFlowNetwork<int, GraphType> network(&graph);
+	KWGraph::MaxFlowResult<int> result;
+	int nrWrong = 0;
+	for(int source = 0; source < nrNodes; ++source) {
+		for(int sink = 0; sink < nrNodes; ++sink) {
+			if(source == sink)
+				continue;
+			int minCut = 1 << 30;
+			for(int mask = 0; mask < (1 << nrNodes); ++mask) {
+				if(!(mask & (1 << source)) || (mask & (1 << sink)))
+					continue;
+				int cut = 0;
+				for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt) {
+					const KWGraph::Edge<int>& edge = edges[edgeIt];
+					if(KWGraph::IsListEdgeVisible(graph, (int)edgeIt) && (mask & (1 << edge.source)) &&
+					   !(mask & (1 << edge.destination)))
+						cut += std::max(edge.weight, 0);
+				}
+				minCut = std::min(minCut, cut);
+			}
+
+			nrWrong += !network.ComputeMaxFlow(source, sink, result) || result.flowValue != minCut;
+			// The flow fits the capacities and is conserved everywhere but
+			// at the source and the sink
+			std::vector<int> balances(nrNodes, 0);
+			for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt) {
+				int flow = result.edgeFlows[edgeIt];
+				nrWrong += flow < 0 || flow > std::max(edges[edgeIt].weight, 0);
+				nrWrong += flow > 0 && !KWGraph::IsListEdgeVisible(graph, (int)edgeIt);
+				balances[edges[edgeIt].source] -= flow;
+				balances[edges[edgeIt].destination] += flow;
+			}
+			for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+				int expected = nodeIt == source ? -minCut : nodeIt == sink ? minCut : 0;
+				nrWrong += balances[nodeIt] != expected;
+			}
+			int cutWeight = 0;
+			for(size_t cutIt = 0; cutIt < result.cutEdgeIds.size(); ++cutIt)
+				cutWeight += edges[result.cutEdgeIds[cutIt]].weight;
+			nrWrong += cutWeight != minCut || !result.isSourceSide[source] || result.isSourceSide[sink];
+		}
+	}
+	KW_CHECK(nrWrong == 0);
+}
+
+void TestMaxFlow()
+{
+	// Both one way edges and edge pairs, a few of them with no capacity
+	KWGraph::IntGraph graph;
+	graph.InitializeGraph(0, 0, 1, KWGraph::StorageType_AdjacencyList);
+	srand(62);
+	for(int nodeIt = 0; nodeIt < 10; ++nodeIt)
+		graph.AddNode(1);
+	for(int nodeIt = 0; nodeIt < 10; ++nodeIt) {
+		for(int otherIt = 0; otherIt < 10; ++otherIt) {
+			if(nodeIt != otherIt && rand() % 100 < 25)
+				graph.AddEdge(nodeIt, otherIt, rand() % 10, rand() % 3 == 0);
+		}
+	}
+	CheckMaxFlows(graph);
+
+	KWGraph::IntGraphView view(&graph);
+	view.FilterEdges(KWGraph::MinEdgeWeight<int>(3));
+	view.SetNodeVisible(4, false);
+	// Hides one edge of the first pair
+	for(size_t edgeIt = 0; edgeIt + 1 < graph.GetNrEdges(); ++edgeIt) {
+		if(graph.GetEdges()[edgeIt].directed && view.IsListEdgeVisible((int)edgeIt)) {
+			view.SetEdgeVisible(edgeIt + 1, false);
+			break;
+		}
+	}
+	CheckMaxFlows(view);
+
+	KWGraph::IntMaxFlowNetwork network(&graph);
+	KWGraph::MaxFlowResult<int> result;
+	KW_CHECK(!network.ComputeMaxFlow(3, 3, result) && !network.ComputeMaxFlow(0, 10, result));
+}
+
+// Betweenness from all pairs distances and path counts, pair by pair
+template <typename GraphType>
+std::vector<double> ReferenceBetweenness(const GraphType& graph, bool isWeighted)
+{
+	const int noPath = 1 << 28;
+	int nrNodes = (int)graph.GetNrNodes();
+	std::vector< std::vector<int> > weights(nrNodes, std::vector<int>(nrNodes, noPath));
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		KWGraph::NeighborRange<int> neighbors = graph.Neighbors(nodeIt);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it)
+			weights[nodeIt][it.GetDestination()] = isWeighted ? (*it).weight : 1;
+	}
+	std::vector< std::vector<int> > distances = weights;
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+		distances[nodeIt][nodeIt] = 0;
+	for(int middle = 0; middle < nrNodes; ++middle) {
+		for(int first = 0; first < nrNodes; ++first) {
+			for(int last = 0; last < nrNodes; ++last)
+				distances[first][last] = std::min(distances[first][last], distances[first][middle] + distances[middle][last]);
+		}
+	}
+
+	// Nodes closer to the source have their counts done first
+	std::vector< std::vector<double> > pathCounts(nrNodes, std::vector<double>(nrNodes, 0.0));
+	for(int source = 0; source < nrNodes; ++source) {
+		std::vector< std::pair<int, int> > order;
+		for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+			if(distances[source][nodeIt] < noPath)
+				order.push_back(std::make_pair(distances[source][nodeIt], nodeIt));
+		}
+		std::sort(order.begin(), order.end());
+		pathCounts[source][source] = 1.0;
+		for(size_t orderIt = 1; orderIt < order.size(); ++orderIt) {
+			int node = order[orderIt].second;
+			for(int previous = 0; previous < nrNodes; ++previous) {
+				if(weights[previous][node] < noPath && distances[source][previous] < noPath &&
+				   distances[source][previous] + weights[previous][node] == distances[source][node])
+					pathCounts[source][node] += pathCounts[source][previous];
+			}
+		}
+	}
+
+	std::vector<double> scores(nrNodes, 0.0);
+	for(int node = 0; node < nrNodes; ++node) {
+		for(int source = 0; source < nrNodes; ++source) {
+			for(int target = 0; target < nrNodes; ++target) {
+				if(source == node || target == node || source == target || distances[source][target] >= noPath)
+					continue;
+				if(distances[source][node] + distances[node][target] == distances[source][target])
+					scores[node] += pathCounts[source][node] * pathCounts[node][target] / pathCounts[source][target];
+			}
+		}
+	}
+	return scores;
+}
+
+bool AreScoresClose(const std::vector<double>& scores, const std::vector<double>& expected)
+{
+	if(scores.size() != expected.size())
+		return false;
+	for(size_t scoreIt = 0; scoreIt < scores.size(); ++scoreIt) {
+		if(fabs(scores[scoreIt] - expected[scoreIt]) > 1e-6 * std::max(1.0, fabs(expected[scoreIt])))
+			return false;
+	}
+	return true;
+}
+
+void TestBetweenness()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 30, 12, KWGraph::StorageType_AdjacencyList, 63);
+	std::vector<double> centrality;
+	KWGraph::BetweennessCentrality(graph, centrality);
+	KW_CHECK(AreScoresClose(centrality, ReferenceBetweenness(graph, false)));
+	KWGraph::IntBetweennessEngine weightedEngine(&graph, true);
+	weightedEngine.Compute(centrality);
+	KW_CHECK(AreScoresClose(centrality, ReferenceBetweenness(graph, true)));
+	// Asking for every node as a sample is the exact computation
+	KWGraph::BetweennessCentrality(graph, 30, 1, centrality);
+	KW_CHECK(AreScoresClose(centrality, ReferenceBetweenness(graph, false)));
+
+	KWGraph::IntGraphView view(&graph);
+	view.SetNodeVisible(0, false);
+	view.FilterEdges(KWGraph::MinEdgeWeight<int>(3));
+	KWGraph::BetweennessCentrality(view, centrality);
+	KW_CHECK(AreScoresClose(centrality, ReferenceBetweenness(view, false)));
+}
+
+// Newman modularity of a partition, straight from the definition
+template <typename GraphType>
+double ReferenceModularity(const GraphType& graph, const std::vector<int>& communities)
+{
+	int nrNodes = (int)graph.GetNrNodes();
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(graph);
+	double totalWeight = 0.0;
+	std::vector<double> degrees(nrNodes, 0.0);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		degrees[nodeIt] = (double)std::count(isAdjacent[nodeIt].begin(), isAdjacent[nodeIt].end(), true);
+		totalWeight += degrees[nodeIt];
+	}
+	double modularity = 0.0;
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		for(int otherIt = 0; otherIt < nrNodes; ++otherIt) {
+			if(communities[nodeIt] == communities[otherIt])
+				modularity += isAdjacent[nodeIt][otherIt] - degrees[nodeIt] * degrees[otherIt] / totalWeight;
+		}
+	}
+	return modularity / totalWeight;
+}
+
+// True if the communities are exactly the groups of groupSize consecutive
+// ids, leftover ids must each be alone
+bool IsGroupPartition(const std::vector<int>& communities, int groupSize, int nrGrouped)
+{
+	for(int nodeIt = 0; nodeIt < (int)communities.size(); ++nodeIt) {
+		for(int otherIt = 0; otherIt < (int)communities.size(); ++otherIt) {
+			bool isSameGroup = nodeIt == otherIt ||
+							   (nodeIt < nrGrouped && otherIt < nrGrouped && nodeIt / groupSize == otherIt / groupSize);
+			if((communities[nodeIt] == communities[otherIt]) != isSameGroup)
+				return false;
+		}
+	}
+	return true;
+}
+
+void TestCommunities()
+{
+	// Five cliques of six nodes in a ring, neighboring cliques share one edge
+	KWGraph::IntGraph graph;
+	graph.InitializeGraph(0, 0, 1, KWGraph::StorageType_AdjacencyList);
+	for(int nodeIt = 0; nodeIt < 30; ++nodeIt)
+		graph.AddNode(1);
+	for(int nodeIt = 0; nodeIt < 30; ++nodeIt) {
+		for(int otherIt = nodeIt + 1; otherIt < 30 && otherIt / 6 == nodeIt / 6; ++otherIt)
+			graph.AddEdge(nodeIt, otherIt, 1, true);
+	}
+	for(int cliqueIt = 0; cliqueIt < 5; ++cliqueIt)
+		graph.AddEdge(cliqueIt * 6, ((cliqueIt + 1) % 5) * 6 + 3, 1, true);
+
+	std::vector<int> communities;
+	double modularity = KWGraph::Louvain(graph, communities);
+	KW_CHECK(IsGroupPartition(communities, 6, 30));
+	KW_CHECK(fabs(modularity - ReferenceModularity(graph, communities)) < 1e-9);
+
+	// Label propagation settles with every node in a community that has
+	// the most neighbors around it
+	int nrCommunities = KWGraph::LabelPropagation(graph, communities);
+	KW_CHECK(nrCommunities == *std::max_element(communities.begin(), communities.end()) + 1);
+	int nrWrong = 0;
+	for(int nodeIt = 0; nodeIt < 30; ++nodeIt) {
+		std::vector<int> communityWeights(nrCommunities, 0);
+		KWGraph::NeighborRange<int> neighbors = graph.Neighbors(nodeIt);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it)
+			++communityWeights[communities[it.GetDestination()]];
+		nrWrong += communityWeights[communities[nodeIt]] != *std::max_element(communityWeights.begin(),
+																			   communityWeights.end());
+	}
+	KW_CHECK(nrWrong == 0);
+
+	// Hiding the last clique leaves its nodes alone
+	KWGraph::IntGraphView view(&graph);
+	view.FilterNodes([](const KWGraph::Node<int>& node) { return node.id < 24; });
+	modularity = KWGraph::Louvain(view, communities);
+	KW_CHECK(IsGroupPartition(communities, 6, 24));
+	KW_CHECK(fabs(modularity - ReferenceModularity(view, communities)) < 1e-9);
+}
+
+template <typename GraphType>
+void CheckColoring(const GraphType& graph)
+{
+	std::vector<int> colors;
+	int nrColors = KWGraph::ColorGraph(graph, colors);
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(graph);
+	int nrNodes = (int)graph.GetNrNodes();
+	int maxDegree = 0;
+	int nrWrong = 0;
+	std::vector<bool> isUsed(nrColors, false);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		maxDegree = std::max(maxDegree, (int)std::count(isAdjacent[nodeIt].begin(), isAdjacent[nodeIt].end(), true));
+		if(colors[nodeIt] < 0 || colors[nodeIt] >= nrColors) {
+			++nrWrong;
+			continue;
+		}
+		isUsed[colors[nodeIt]] = true;
+		for(int otherIt = 0; otherIt < nrNodes; ++otherIt)
+			nrWrong += isAdjacent[nodeIt][otherIt] && colors[nodeIt] == colors[otherIt];
+	}
+	KW_CHECK(nrWrong == 0 && (int)colors.size() == nrNodes);
+	// Greedy never needs more than one color past the largest degree
+	KW_CHECK(nrColors <= maxDegree + 1);
+	KW_CHECK(std::count(isUsed.begin(), isUsed.end(), true) == nrColors);
+}
+
+void TestColoring()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 300, 5, KWGraph::StorageType_AdjacencyList, 65);
+	CheckColoring(graph);
+
+	KWGraph::IntGraphView view(&graph);
+	view.FilterEdges(KWGraph::MinEdgeWeight<int>(5));
+	CheckColoring(view);
+}
+
+void TestTopologicalSort()
+{
+	// Edges only go from a lower to a higher rank, the ranks are shuffled
+	// over the ids
+	const int nrNodes = 120;
+	srand(66);
+	std::vector<int> ranks(nrNodes);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+		ranks[nodeIt] = nodeIt;
+	for(int nodeIt = nrNodes - 1; nodeIt > 0; --nodeIt)
+		std::swap(ranks[nodeIt], ranks[rand() % (nodeIt + 1)]);
+	KWGraph::IntGraph graph;
+	graph.InitializeGraph(0, 0, 1, KWGraph::StorageType_AdjacencyList);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+		graph.AddNode(1);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		for(int otherIt = 0; otherIt < nrNodes; ++otherIt) {
+			if(ranks[nodeIt] < ranks[otherIt] && rand() % 100 < 4)
+				graph.AddEdge(nodeIt, otherIt, rand() % 19 - 6, false);
+		}
+	}
+	const std::vector< KWGraph::Edge<int> >& edges = graph.GetEdges();
+
+	// The level of a node is the longest chain of edges that leads to it
+	std::vector<int> byRank(nrNodes);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+		byRank[ranks[nodeIt]] = nodeIt;
+	std::vector<int> expectedLevels(nrNodes, 0);
+	for(int rankIt = 0; rankIt < nrNodes; ++rankIt) {
+		for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt) {
+			if(edges[edgeIt].destination == byRank[rankIt])
+				expectedLevels[byRank[rankIt]] = std::max(expectedLevels[byRank[rankIt]],
+														  expectedLevels[edges[edgeIt].source] + 1);
+		}
+	}
+
+	KWGraph::TopologicalOrder topologicalOrder;
+	KW_CHECK(KWGraph::TopologicalSort(graph, topologicalOrder));
+	KW_CHECK((int)topologicalOrder.order.size() == nrNodes);
+	std::vector<int> levels(nrNodes, -1);
+	for(int levelIt = 0; levelIt < topologicalOrder.GetNrLevels(); ++levelIt) {
+		for(int orderIt = topologicalOrder.levelOffsets[levelIt]; orderIt < topologicalOrder.levelOffsets[levelIt + 1];
+			++orderIt)
+			levels[topologicalOrder.order[orderIt]] = levelIt;
+	}
+	KW_CHECK(levels == expectedLevels);
+
+	// Relaxing every edge nrNodes times settles the paths from the source
+	int source = byRank[0];
+	std::vector<int> shortest(nrNodes, 1 << 30);
+	std::vector<int> longest(nrNodes, -(1 << 30));
+	shortest[source] = 0;
+	longest[source] = 0;
+	for(int roundIt = 0; roundIt < nrNodes; ++roundIt) {
+		for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt) {
+			const KWGraph::Edge<int>& edge = edges[edgeIt];
+			if(shortest[edge.source] != 1 << 30)
+				shortest[edge.destination] = std::min(shortest[edge.destination], shortest[edge.source] + edge.weight);
+			if(longest[edge.source] != -(1 << 30))
+				longest[edge.destination] = std::max(longest[edge.destination], longest[edge.source] + edge.weight);
+		}
+	}
+	std::vector<int> distances;
+	std::vector<int> parents;
+	int nrWrong = 0;
+	KW_CHECK(KWGraph::DAGShortestPaths(graph, source, distances, parents));
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		bool isReached = parents[nodeIt] != KWGraph::INVALID_ID;
+		nrWrong += isReached != (shortest[nodeIt] != 1 << 30) || (isReached && distances[nodeIt] != shortest[nodeIt]);
+	}
+	KW_CHECK(KWGraph::DAGLongestPaths(graph, source, distances, parents));
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+		nrWrong += parents[nodeIt] != KWGraph::INVALID_ID && distances[nodeIt] != longest[nodeIt];
+	KW_CHECK(nrWrong == 0);
+
+	// An edge back to the first rank closes a cycle
+	graph.AddEdge(byRank[nrNodes - 1], source, 1, false);
+	KW_CHECK(!KWGraph::TopologicalSort(graph, topologicalOrder));
+	KW_CHECK(!KWGraph::DAGShortestPaths(graph, source, distances, parents));
+}
+
+// Number of connected components once the node skipped (if any) and the
+// edge between first and second (if any) are taken out, componentIds gets
+// the component of every node
+int CountComponentsWithout(const std::vector< std::vector<bool> >& isAdjacent, int skipped, int first, int second,
+						   std::vector<int>& componentIds)
+{
+	int nrNodes = (int)isAdjacent.size();
+	componentIds.assign(nrNodes, -1);
+	int nrComponents = 0;
+	for(int rootIt = 0; rootIt < nrNodes; ++rootIt) {
+		if(rootIt == skipped || componentIds[rootIt] != -1)
+			continue;
+		std::vector<int> queue(1, rootIt);
+		componentIds[rootIt] = nrComponents;
+		for(size_t queueIt = 0; queueIt < queue.size(); ++queueIt) {
+			int node = queue[queueIt];
+			for(int otherIt = 0; otherIt < nrNodes; ++otherIt) {
+				bool isRemoved = (node == first && otherIt == second) || (node == second && otherIt == first);
+				if(!isAdjacent[node][otherIt] || isRemoved || otherIt == skipped || componentIds[otherIt] != -1)
+					continue;
+				componentIds[otherIt] = nrComponents;
+				queue.push_back(otherIt);
+			}
+		}
+		++nrComponents;
+	}
+	return nrComponents;
+}
+
+void TestBiconnectedComponents()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 30, 8, KWGraph::StorageType_AdjacencyList, 67);
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(graph);
+	std::vector< std::pair<int, int> > edges;
+	for(int nodeIt = 0; nodeIt < 30; ++nodeIt) {
+		for(int otherIt = nodeIt + 1; otherIt < 30; ++otherIt) {
+			if(isAdjacent[nodeIt][otherIt])
+				edges.push_back(std::make_pair(nodeIt, otherIt));
+		}
+	}
+
+	// Articulation points and bridges split their component when removed
+	std::vector<int> componentIds;
+	int nrComponents = CountComponentsWithout(isAdjacent, -1, -1, -1, componentIds);
+	std::vector<int> articulationPoints;
+	for(int nodeIt = 0; nodeIt < 30; ++nodeIt) {
+		bool isIsolated = std::count(isAdjacent[nodeIt].begin(), isAdjacent[nodeIt].end(), true) == 0;
+		if(CountComponentsWithout(isAdjacent, nodeIt, -1, -1, componentIds) > nrComponents - isIsolated)
+			articulationPoints.push_back(nodeIt);
+	}
+	std::vector< std::pair<int, int> > bridges;
+	for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt) {
+		if(CountComponentsWithout(isAdjacent, -1, edges[edgeIt].first, edges[edgeIt].second, componentIds) > nrComponents)
+			bridges.push_back(edges[edgeIt]);
+	}
+
+	// Two edges are in different blocks if they are in different components
+	// or some node splits them apart, an edge at that node goes with its
+	// other end
+	std::vector<int> graphComponentIds;
+	CountComponentsWithout(isAdjacent, -1, -1, -1, graphComponentIds);
+	std::vector<int> blocks(edges.size());
+	for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt)
+		blocks[edgeIt] = (int)edgeIt;
+	for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt) {
+		for(size_t otherIt = edgeIt + 1; otherIt < edges.size(); ++otherIt) {
+			bool isSplit = graphComponentIds[edges[edgeIt].first] != graphComponentIds[edges[otherIt].first];
+			for(int nodeIt = 0; nodeIt < 30 && !isSplit; ++nodeIt) {
+				CountComponentsWithout(isAdjacent, nodeIt, -1, -1, componentIds);
+				int end = edges[edgeIt].first == nodeIt ? edges[edgeIt].second : edges[edgeIt].first;
+				int otherEnd = edges[otherIt].first == nodeIt ? edges[otherIt].second : edges[otherIt].first;
+				isSplit = componentIds[end] != componentIds[otherEnd];
+			}
+			if(!isSplit)
+				blocks[otherIt] = std::min(blocks[otherIt], blocks[edgeIt]);
+		}
+	}
+
+	KWGraph::BiconnectedComponents components;
+	KWGraph::FindBiconnectedComponents(graph, components);
+	KW_CHECK(components.articulationPoints == articulationPoints);
+	std::sort(components.bridges.begin(), components.bridges.end());
+	KW_CHECK(components.bridges == bridges);
+	KW_CHECK(!articulationPoints.empty() && !bridges.empty());
+
+	// Every edge sits in exactly one component, along with its block
+	std::vector<int> edgeComponents(edges.size(), -1);
+	int nrWrong = 0;
+	for(int componentIt = 0; componentIt < components.GetNrComponents(); ++componentIt) {
+		std::vector<int> nodes;
+		for(int edgeIt = components.edgeOffsets[componentIt]; edgeIt < components.edgeOffsets[componentIt + 1]; ++edgeIt) {
+			std::pair<int, int> edge = components.componentEdges[edgeIt];
+			if(edge.first > edge.second)
+				std::swap(edge.first, edge.second);
+			size_t edgeId = std::lower_bound(edges.begin(), edges.end(), edge) - edges.begin();
+			if(edgeId == edges.size() || edges[edgeId] != edge || edgeComponents[edgeId] != -1) {
+				++nrWrong;
+				continue;
+			}
+			edgeComponents[edgeId] = componentIt;
+			nodes.push_back(edge.first);
+			nodes.push_back(edge.second);
+		}
+		std::sort(nodes.begin(), nodes.end());
+		nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+		std::vector<int> componentNodes(components.componentNodes.begin() + components.nodeOffsets[componentIt],
+										components.componentNodes.begin() + components.nodeOffsets[componentIt + 1]);
+		std::sort(componentNodes.begin(), componentNodes.end());
+		nrWrong += componentNodes != nodes;
+	}
+	for(size_t edgeIt = 0; edgeIt < edges.size(); ++edgeIt) {
+		for(size_t otherIt = 0; otherIt < edges.size(); ++otherIt)
+			nrWrong += (blocks[edgeIt] == blocks[otherIt]) != (edgeComponents[edgeIt] == edgeComponents[otherIt]);
+	}
+	KW_CHECK(nrWrong == 0);
+}
+
+void TestRandomWalks()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 40, 10, KWGraph::StorageType_AdjacencyList, 68);
+	// A node whose only edge leads into a dead end
+	graph.AddNode(1);
+	graph.AddNode(1);
+	graph.AddEdge(40, 41, 1, false);
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(graph);
+	KWGraph::IntRandomWalker walker(graph);
+
+	const KWGraph::RandomWalkMode modes[] = { KWGraph::RandomWalkMode_Uniform, KWGraph::RandomWalkMode_Weighted,
+											  KWGraph::RandomWalkMode_Node2Vec };
+	for(int modeIt = 0; modeIt < 3; ++modeIt) {
+		KWGraph::RandomWalkConfig config;
+		config.mode = modes[modeIt];
+		config.walkLength = 20;
+		config.walksPerNode = 3;
+		std::vector<int> walks;
+		walker.GenerateWalks(config, walks);
+		KW_CHECK(walks.size() == 42 * 3 * 20);
+
+		// Every step follows an edge and padding only comes after a node
+		// without out edges
+		int nrWrong = 0;
+		for(size_t walkIt = 0; walkIt < walks.size() / 20; ++walkIt) {
+			const int* walk = &walks[walkIt * 20];
+			nrWrong += walk[0] != (int)(walkIt % 42);
+			for(int stepIt = 1; stepIt < 20; ++stepIt) {
+				if(walk[stepIt] == KWGraph::INVALID_ID)
+					nrWrong += walk[stepIt - 1] != 41 && walk[stepIt - 1] != KWGraph::INVALID_ID;
+				else
+					nrWrong += walk[stepIt - 1] == KWGraph::INVALID_ID || !isAdjacent[walk[stepIt - 1]][walk[stepIt]];
+			}
+		}
+		KW_CHECK(nrWrong == 0);
+		KW_CHECK(walks[41 * 20 + 1] == KWGraph::INVALID_ID && walks[40 * 20 + 2] == KWGraph::INVALID_ID);
+
+		std::vector<int> otherWalks;
+		walker.GenerateWalks(config, otherWalks);
+		KW_CHECK(walks == otherWalks);
+	}
+
+	// Weighted steps from a star follow the weights
+	KWGraph::IntGraph star;
+	star.InitializeGraph(0, 0, 1, KWGraph::StorageType_AdjacencyList);
+	for(int nodeIt = 0; nodeIt < 4; ++nodeIt)
+		star.AddNode(1);
+	for(int leafIt = 1; leafIt < 4; ++leafIt)
+		star.AddEdge(0, leafIt, leafIt, false);
+	KWGraph::IntRandomWalker starWalker(star);
+	KWGraph::RandomWalkConfig config;
+	config.mode = KWGraph::RandomWalkMode_Weighted;
+	config.walkLength = 2;
+	config.walksPerNode = 60000;
+	std::vector<int> walks;
+	starWalker.GenerateWalks(std::vector<int>(1, 0), config, walks);
+	std::vector<int> visits(4, 0);
+	for(size_t walkIt = 0; walkIt < walks.size(); walkIt += 2)
+		++visits[walks[walkIt + 1]];
+	for(int leafIt = 1; leafIt < 4; ++leafIt)
+		KW_CHECK(fabs(visits[leafIt] / 60000.0 - leafIt / 6.0) < 0.01);
+
+	// A tiny return parameter makes node2vec walks go back and forth
+	config.mode = KWGraph::RandomWalkMode_Node2Vec;
+	config.returnParam = 0.001f;
+	config.walkLength = 30;
+	config.walksPerNode = 20;
+	walker.GenerateWalks(std::vector<int>(1, 0), config, walks);
+	KW_CHECK(std::count(walks.begin(), walks.end(), KWGraph::INVALID_ID) == 0);
+	int nrReturns = 0;
+	int nrSteps = 0;
+	for(size_t walkIt = 0; walkIt < walks.size(); walkIt += 30) {
+		for(int stepIt = 2; stepIt < 30; ++stepIt) {
+			++nrSteps;
+			nrReturns += walks[walkIt + stepIt] == walks[walkIt + stepIt - 2];
+		}
+	}
+	KW_CHECK(nrReturns > nrSteps * 9 / 10);
+
+	// node2vec parameters without a finite positive bias give no walks
+	// instead of spinning in the rejection sampling
+	const float badParams[] = { 0.0f, -1.0f, 1e-45f, std::numeric_limits<float>::infinity(),
+								std::numeric_limits<float>::quiet_NaN() };
+	for(int paramIt = 0; paramIt < 5; ++paramIt) {
+		config.returnParam = badParams[paramIt];
+		config.inOutParam = 1.0f;
+		walker.GenerateWalks(std::vector<int>(1, 0), config, walks);
+		KW_CHECK(walks.empty());
+		config.returnParam = 1.0f;
+		config.inOutParam = badParams[paramIt];
+		walker.GenerateWalks(std::vector<int>(1, 0), config, walks);
+		KW_CHECK(walks.empty());
+	}
+
+	// Walks from start nodes outside the graph are all padding and leave
+	// the others in place
+	config.inOutParam = 1.0f;
+	config.walksPerNode = 2;
+	std::vector<int> startNodes;
+	startNodes.push_back(-1);
+	startNodes.push_back(0);
+	startNodes.push_back(42);
+	walker.GenerateWalks(startNodes, config, walks);
+	KW_CHECK(walks.size() == 3 * 2 * 30);
+	for(int walkIt = 0; walkIt < 6; ++walkIt) {
+		const int* walk = &walks[walkIt * 30];
+		if(walkIt % 3 == 1)
+			KW_CHECK(walk[0] == 0 && std::count(walk, walk + 30, KWGraph::INVALID_ID) == 0);
+		else
+			KW_CHECK(std::count(walk, walk + 30, KWGraph::INVALID_ID) == 30);
+	}
+}
+// Personalized PageRank by power iteration, dead ends restart at the seed
+template <typename GraphType>
+std::vector<double> ReferencePageRank(const GraphType& graph, int seed, double restartChance)
+{
+	size_t nrNodes = graph.GetNrNodes();
+	std::vector<double> scores(nrNodes, 0.0);
+	scores[seed] = 1.0;
+	for(int iterationIt = 0; iterationIt < 300; ++iterationIt) {
+		std::vector<double> next(nrNodes, 0.0);
+		next[seed] = restartChance;
+		for(size_t nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+			double spread = (1.0 - restartChance) * scores[nodeIt];
+			KWGraph::NeighborRange<int> neighbors = graph.Neighbors(nodeIt);
+			if(neighbors.size() == 0) {
+				next[seed] += spread;
+				continue;
+			}
+			for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it)
+				next[it.GetDestination()] += spread / neighbors.size();
+		}
+		scores.swap(next);
+	}
+	return scores;
+}
+
+template <typename GraphType>
+void CheckPageRank(const GraphType& graph, int seed)
+{
+	std::vector<double> reference = ReferencePageRank(graph, seed, 0.15);
+	KWGraph::PersonalizedPageRank<int, GraphType> pageRank(&graph);
+	KWGraph::PageRankConfig config;
+	KWGraph::PageRankScores scores;
+
+	// A fine push alone is off by no more than the leftover residual
+	config.pushThreshold = 1e-9;
+	config.nrWalks = 0;
+	pageRank.Compute(seed, config, scores);
+	double maxError = 0.0;
+	double total = 0.0;
+	for(size_t nodeIt = 0; nodeIt < reference.size(); ++nodeIt) {
+		double score = scores.count(nodeIt) ? scores[nodeIt] : 0.0;
+		maxError = std::max(maxError, fabs(score - reference[nodeIt]));
+		total += score;
+	}
+	KW_CHECK(maxError < 1e-5);
+	KW_CHECK(total <= 1.0 + 1e-9 && total > 1.0 - 1e-5);
+
+	// A coarse push leaves most of the mass to the walks
+	config.pushThreshold = 1e-2;
+	config.nrWalks = 200000;
+	pageRank.Compute(seed, config, scores);
+	maxError = 0.0;
+	total = 0.0;
+	for(size_t nodeIt = 0; nodeIt < reference.size(); ++nodeIt) {
+		double score = scores.count(nodeIt) ? scores[nodeIt] : 0.0;
+		maxError = std::max(maxError, fabs(score - reference[nodeIt]));
+		total += score;
+	}
+	KW_CHECK(maxError < 0.01);
+	KW_CHECK(fabs(total - 1.0) < 1e-9);
+
+	std::vector< std::pair<int, double> > top;
+	KWGraph::GetTopScores(scores, 5, top);
+	int best = (int)(std::max_element(reference.begin(), reference.end()) - reference.begin());
+	KW_CHECK(top.size() == 5 && top[0].first == best);
+	for(size_t topIt = 1; topIt < top.size(); ++topIt)
+		KW_CHECK(top[topIt - 1].second >= top[topIt].second);
+}
+
+void TestPersonalizedPageRank()
+{
+	for(int storageIt = 0; storageIt < 2; ++storageIt) {
+		// Random undirected edges and a dead end next to the seed, the nodes
+		// go in first since adding one drops the matrix
+		KWGraph::IntGraph graph;
+		graph.InitializeGraph(0, 0, 1, storageIt ? KWGraph::StorageType_AdjacencyMatrix :
+												   KWGraph::StorageType_AdjacencyList);
+		for(int nodeIt = 0; nodeIt < 41; ++nodeIt)
+			graph.AddNode(1);
+		srand(69);
+		for(int nodeIt = 0; nodeIt < 40; ++nodeIt) {
+			for(int otherIt = nodeIt + 1; otherIt < 40; ++otherIt) {
+				if(rand() % 100 < 8)
+					graph.AddEdge(nodeIt, otherIt, 1, true);
+			}
+		}
+		graph.AddEdge(0, 40, 1, false);
+		CheckPageRank(graph, 0);
+
+		KWGraph::IntGraphView view(&graph);
+		view.SetNodeVisible(1, false);
+		CheckPageRank(view, 0);
+	}
+
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 10, 30, KWGraph::StorageType_AdjacencyList, 69);
+	KWGraph::IntPersonalizedPageRank pageRank(&graph);
+	KWGraph::PageRankScores scores;
+	pageRank.Compute(10, KWGraph::PageRankConfig(), scores);
+	KW_CHECK(scores.empty());
+}
+// Sparse, dense and a plain loop over the weights must agree, every
+// entry that isn't 0 is an edge
+template <typename Semiring>
+void CheckSemiringProducts(const KWGraph::Graph<typename Semiring::ValueType>& graph)
+{
+	typedef typename Semiring::ValueType T;
+	int nrNodes = (int)graph.GetNrNodes();
+	const std::vector<T>& weights = graph.GetAdjacencyMatrix();
+	KWGraph::CsrMatrix<T> sparse;
+	KWGraph::BuildCsrMatrix(graph, sparse);
+	KWGraph::DenseMatrixView<T> dense = KWGraph::GetAdjacencyMatrixView(graph);
+
+	const int nrColumns = 3;
+	std::vector<T> input(nrNodes * nrColumns);
+	for(size_t valueIt = 0; valueIt < input.size(); ++valueIt)
+		input[valueIt] = valueIt % 3 == 0 ? Semiring::Zero() : T(valueIt % 5);
+	std::vector<T> reference(nrNodes * nrColumns, Semiring::Zero());
+	for(int rowIt = 0; rowIt < nrNodes; ++rowIt) {
+		for(int otherIt = 0; otherIt < nrNodes; ++otherIt) {
+			T weight = weights[rowIt * nrNodes + otherIt];
+			if(weight == T(0))
+				continue;
+			for(int columnIt = 0; columnIt < nrColumns; ++columnIt) {
+				T& entry = reference[rowIt * nrColumns + columnIt];
+				entry = Semiring::Add(entry, Semiring::Multiply(weight, input[otherIt * nrColumns + columnIt]));
+			}
+		}
+	}
+	std::vector<T> sparseOutput;
+	std::vector<T> denseOutput;
+	KWGraph::MultiplyMatrix<Semiring>(sparse, input, nrColumns, sparseOutput);
+	KWGraph::MultiplyMatrix<Semiring>(dense, input, nrColumns, denseOutput);
+	KW_CHECK(sparseOutput == reference && denseOutput == reference);
+
+	// The first column on its own, computing every other row
+	std::vector<T> vector(nrNodes);
+	std::vector<unsigned char> isSkipped(nrNodes);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		vector[nodeIt] = input[nodeIt * nrColumns];
+		isSkipped[nodeIt] = nodeIt % 2;
+	}
+	KWGraph::VectorMask mask(&isSkipped, true);
+	sparseOutput.assign(nrNodes, T(7));
+	denseOutput.assign(nrNodes, T(7));
+	KWGraph::MultiplyVector<Semiring>(sparse, vector, &mask, sparseOutput);
+	KWGraph::MultiplyVector<Semiring>(dense, vector, &mask, denseOutput);
+	int nrWrong = 0;
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		T expected = nodeIt % 2 ? T(7) : reference[nodeIt * nrColumns];
+		nrWrong += sparseOutput[nodeIt] != expected || denseOutput[nodeIt] != expected;
+	}
+	KW_CHECK(nrWrong == 0);
+}
+
+void TestSemiringProducts()
+{
+	// A node count that isn't a multiple of 4 keeps the SSE tails busy. The
+	// list holds the 0 weight arcs, the matrix can't
+	KWGraph::FloatGraph floatGraph;
+	KWGraph::IntGraph intGraph;
+	KWGraph::StorageType storage = (KWGraph::StorageType)(KWGraph::StorageType_AdjacencyList |
+														   KWGraph::StorageType_AdjacencyMatrix);
+	floatGraph.InitializeGraph(0, 0, 1, storage);
+	intGraph.InitializeGraph(0, 0, 1, storage);
+	for(int nodeIt = 0; nodeIt < 37; ++nodeIt) {
+		floatGraph.AddNode(1);
+		intGraph.AddNode(1);
+	}
+	srand(70);
+	int nrZeroArcs = 0;
+	for(int nodeIt = 0; nodeIt < 37; ++nodeIt) {
+		for(int otherIt = 0; otherIt < 37; ++otherIt) {
+			if(rand() % 100 >= 20)
+				continue;
+			int weight = rand() % 5;
+			nrZeroArcs += weight == 0;
+			floatGraph.AddEdge(nodeIt, otherIt, (float)weight, false);
+			intGraph.AddEdge(nodeIt, otherIt, weight, false);
+		}
+	}
+	KW_CHECK(nrZeroArcs > 0);
+	CheckSemiringProducts< KWGraph::PlusTimesSemiring<float> >(floatGraph);
+	CheckSemiringProducts< KWGraph::MinPlusSemiring<float> >(floatGraph);
+	CheckSemiringProducts< KWGraph::OrAndSemiring<float> >(floatGraph);
+	CheckSemiringProducts< KWGraph::PlusTimesSemiring<int> >(intGraph);
+	CheckSemiringProducts< KWGraph::MinPlusSemiring<int> >(intGraph);
+	CheckSemiringProducts< KWGraph::OrAndSemiring<int> >(intGraph);
+
+	// Common neighbors of every arc, a stored 0 in the mask gives Zero
+	KWGraph::CsrMatrix<int> sparse;
+	KWGraph::CsrMatrix<int> transposed;
+	KWGraph::BuildCsrMatrix(intGraph, sparse);
+	KWGraph::TransposeCsrMatrix(sparse, transposed);
+	KWGraph::CsrMatrix<int> mask = sparse;
+	mask.values[0] = 0;
+	std::vector<int> values;
+	KWGraph::MultiplyMaskedMatrix< KWGraph::OrAndSemiring<int> >(sparse, transposed, mask, values);
+	const std::vector<int>& weights = intGraph.GetAdjacencyMatrix();
+	int nrWrong = values[0] != 0;
+	for(int rowIt = 0; rowIt < 37; ++rowIt) {
+		for(int entryIt = mask.offsets[rowIt]; entryIt < mask.offsets[rowIt + 1]; ++entryIt) {
+			if(entryIt == 0)
+				continue;
+			int column = mask.columns[entryIt];
+			int isReachable = 0;
+			for(int middleIt = 0; middleIt < 37; ++middleIt)
+				isReachable |= weights[rowIt * 37 + middleIt] != 0 && weights[middleIt * 37 + column] != 0;
+			nrWrong += values[entryIt] != isReachable;
+		}
+	}
+	KW_CHECK(nrWrong == 0);
+}
+// Every pair against a BFS from the source
+template <typename GraphType>
+void CheckReachability(const GraphType& graph)
+{
+	int nrNodes = (int)graph.GetNrNodes();
+	std::vector< std::vector<int> > distances(nrNodes);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+		distances[nodeIt] = ReferenceDistances(graph, nodeIt);
+
+	std::vector<int> componentOf;
+	int nrComponents = KWGraph::FindStronglyConnectedComponents(graph, componentOf);
+	int nrWrong = 0;
+	std::vector<bool> isUsed(nrComponents, false);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		isUsed[componentOf[nodeIt]] = true;
+		for(int otherIt = 0; otherIt < nrNodes; ++otherIt) {
+			bool isStrong = distances[nodeIt][otherIt] != -1 && distances[otherIt][nodeIt] != -1;
+			nrWrong += isStrong != (componentOf[nodeIt] == componentOf[otherIt]);
+			// Edges go to smaller component ids
+			nrWrong += distances[nodeIt][otherIt] == 1 && componentOf[otherIt] > componentOf[nodeIt];
+		}
+	}
+	KW_CHECK(nrWrong == 0);
+	KW_CHECK(std::count(isUsed.begin(), isUsed.end(), false) == 0);
+
+	KWGraph::ReachabilityIndex index(graph);
+	KWGraph::ReachabilityIndex singleLabelIndex(graph, 1);
+	KWGraph::TransitiveClosure closure(graph);
+	KW_CHECK(index.GetNrComponents() == nrComponents);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		for(int otherIt = 0; otherIt < nrNodes; ++otherIt) {
+			bool canReach = distances[nodeIt][otherIt] != -1;
+			nrWrong += index.CanReach(nodeIt, otherIt) != canReach;
+			nrWrong += singleLabelIndex.CanReach(nodeIt, otherIt) != canReach;
+			nrWrong += closure.CanReach(nodeIt, otherIt) != canReach;
+		}
+	}
+	KW_CHECK(nrWrong == 0);
+	KW_CHECK(!index.CanReach(-1, 0) && !index.CanReach(0, nrNodes) && !closure.CanReach(nrNodes, 0));
+}
+
+void TestReachability()
+{
+	// Sparse arcs make a mix of small cycles and one way chains
+	KWGraph::IntGraph graph;
+	graph.InitializeGraph(0, 0, 1, KWGraph::StorageType_AdjacencyList);
+	for(int nodeIt = 0; nodeIt < 80; ++nodeIt)
+		graph.AddNode(1);
+	srand(71);
+	for(int nodeIt = 0; nodeIt < 80; ++nodeIt) {
+		for(int otherIt = 0; otherIt < 80; ++otherIt) {
+			if(nodeIt != otherIt && rand() % 1000 < 18)
+				graph.AddEdge(nodeIt, otherIt, 1, false);
+		}
+	}
+	std::vector<int> componentOf;
+	int nrComponents = KWGraph::FindStronglyConnectedComponents(graph, componentOf);
+	KW_CHECK(nrComponents > 1 && nrComponents < 80);
+	CheckReachability(graph);
+
+	KWGraph::IntGraphView view(&graph);
+	for(int nodeIt = 0; nodeIt < 80; nodeIt += 9)
+		view.SetNodeVisible(nodeIt, false);
+	CheckReachability(view);
+}
+// Every pair against a BFS over the edges taken both ways
+template <typename GraphType>
+int CountWrongLabelDistances(const GraphType& graph, const KWGraph::PrunedLandmarkLabeling& labeling)
+{
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(graph);
+	int nrNodes = (int)graph.GetNrNodes();
+	int nrWrong = labeling.GetNrNodes() != nrNodes;
+	for(int sourceIt = 0; sourceIt < nrNodes && nrWrong == 0; ++sourceIt) {
+		std::vector<int> distances(nrNodes, -1);
+		std::vector<int> queue(1, sourceIt);
+		distances[sourceIt] = 0;
+		for(size_t queueIt = 0; queueIt < queue.size(); ++queueIt) {
+			int node = queue[queueIt];
+			for(int neighbor = 0; neighbor < nrNodes; ++neighbor) {
+				if(isAdjacent[node][neighbor] && distances[neighbor] == -1) {
+					distances[neighbor] = distances[node] + 1;
+					queue.push_back(neighbor);
+				}
+			}
+		}
+		for(int destinationIt = 0; destinationIt < nrNodes; ++destinationIt)
+			nrWrong += labeling.GetDistance(sourceIt, destinationIt) != distances[destinationIt];
+	}
+	return nrWrong;
+}
+
+void TestLandmarkLabels()
+{
+	// A sparse graph in a few pieces and a few one way arcs
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 150, 2, KWGraph::StorageType_AdjacencyList, 72);
+	graph.AddEdge(3, 140, 5, false);
+	graph.AddEdge(77, 12, 5, false);
+	KWGraph::PrunedLandmarkLabeling labeling;
+	labeling.Build(graph);
+	KW_CHECK(CountWrongLabelDistances(graph, labeling) == 0);
+	KW_CHECK(labeling.GetDistance(140, 3) == 1 && labeling.GetDistance(-1, 3) == -1 &&
+			 labeling.GetDistance(3, 150) == -1);
+
+	KWGraph::IntGraphView view(&graph);
+	for(int nodeIt = 0; nodeIt < 150; nodeIt += 7)
+		view.SetNodeVisible(nodeIt, false);
+	KWGraph::PrunedLandmarkLabeling viewLabeling;
+	viewLabeling.Build(view);
+	KW_CHECK(CountWrongLabelDistances(view, viewLabeling) == 0);
+
+	// A saved index answers the same, a cut off one doesn't load
+	const char* path = "/tmp/kwgraph_test.labels";
+	KW_CHECK(labeling.Save(path));
+	KWGraph::PrunedLandmarkLabeling loaded;
+	KW_CHECK(loaded.Load(path));
+	KW_CHECK(loaded.GetNrLabelEntries() == labeling.GetNrLabelEntries());
+	KW_CHECK(CountWrongLabelDistances(graph, loaded) == 0);
+	FILE* file = fopen(path, "r+b");
+	KW_CHECK(file != NULL);
+	if(file) {
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fclose(file);
+		KW_CHECK(truncate(path, size - 4) == 0);
+	}
+	KW_CHECK(!loaded.Load(path) && loaded.GetNrNodes() == 0);
+	remove(path);
+}
+// The estimate holds every hop count within a few percent of the pairs
+// counted with a BFS from each visible node
+template <typename GraphType>
+void CheckNeighborhoodFunction(const GraphType& graph, int nrVisible)
+{
+	int nrNodes = (int)graph.GetNrNodes();
+	std::vector<double> exact;
+	for(int sourceIt = 0; sourceIt < nrNodes; ++sourceIt) {
+		if(!KWGraph::IsNodeVisible(graph, sourceIt))
+			continue;
+		std::vector<int> distances = ReferenceDistances(graph, sourceIt);
+		for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+			if(distances[nodeIt] == -1)
+				continue;
+			if((int)exact.size() <= distances[nodeIt])
+				exact.resize(distances[nodeIt] + 1, 0.0);
+			exact[distances[nodeIt]] += 1.0;
+		}
+	}
+	for(size_t hopIt = 1; hopIt < exact.size(); ++hopIt)
+		exact[hopIt] += exact[hopIt - 1];
+	KW_CHECK(exact[0] == nrVisible);
+
+	KWGraph::NeighborhoodFunction function;
+	KWGraph::ComputeNeighborhoodFunction(graph, 10, function);
+	KW_CHECK(function.neighborhood.size() >= exact.size() && function.neighborhood.size() <= exact.size() + 1);
+	int nrWrong = 0;
+	for(size_t hopIt = 0; hopIt < function.neighborhood.size(); ++hopIt) {
+		double expected = exact[std::min(hopIt, exact.size() - 1)];
+		nrWrong += fabs(function.neighborhood[hopIt] - expected) > 0.05 * expected;
+	}
+	KW_CHECK(nrWrong == 0);
+}
+
+void TestNeighborhoodFunction()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 300, 1, KWGraph::StorageType_AdjacencyList, 73);
+	CheckNeighborhoodFunction(graph, 300);
+
+	// A third of the nodes hidden, they must not count as their own pair
+	KWGraph::IntGraphView view(&graph);
+	for(int nodeIt = 0; nodeIt < 300; nodeIt += 3)
+		view.SetNodeVisible(nodeIt, false);
+	CheckNeighborhoodFunction(view, 200);
+}
+// Hop counts against BFS and the weights against hop bounded
+// Bellman-Ford, from two seeds
+template <typename GraphType>
+void CheckKHop(const GraphType& graph, int firstSeed, int secondSeed)
+{
+	int nrNodes = (int)graph.GetNrNodes();
+	std::vector<int> hops = ReferenceDistances(graph, firstSeed);
+	std::vector<int> otherHops = ReferenceDistances(graph, secondSeed);
+	for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+		if(hops[nodeIt] == -1 || (otherHops[nodeIt] != -1 && otherHops[nodeIt] < hops[nodeIt]))
+			hops[nodeIt] = otherHops[nodeIt];
+	}
+
+	// lightest[h][v] is the lightest path with at most h edges
+	const int maxHops = 3;
+	const int maxWeight = 12;
+	const int unreached = 1 << 30;
+	std::vector< std::vector<int> > lightest(maxHops + 1, std::vector<int>(nrNodes, unreached));
+	lightest[0][firstSeed] = 0;
+	lightest[0][secondSeed] = 0;
+	for(int hopIt = 1; hopIt <= maxHops; ++hopIt) {
+		lightest[hopIt] = lightest[hopIt - 1];
+		for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+			if(lightest[hopIt - 1][nodeIt] == unreached)
+				continue;
+			KWGraph::NeighborRange<int> neighbors = graph.Neighbors(nodeIt);
+			for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it) {
+				int& weight = lightest[hopIt][it.GetDestination()];
+				weight = std::min(weight, lightest[hopIt - 1][nodeIt] + (*it).weight);
+			}
+		}
+	}
+
+	KWGraph::KHopExtractor<int, GraphType> extractor(&graph);
+	KWGraph::KHopConfig<int> config;
+	config.maxHops = maxHops;
+	KWGraph::KHopNeighborhood<int> neighborhood;
+	std::vector<int> seeds;
+	seeds.push_back(firstSeed);
+	seeds.push_back(secondSeed);
+	seeds.push_back(firstSeed);
+	seeds.push_back(nrNodes);
+	for(int limitIt = 0; limitIt < 2; ++limitIt) {
+		config.isWeightLimited = limitIt == 1;
+		config.maxWeight = maxWeight;
+		extractor.Extract(seeds, config, neighborhood);
+		std::vector<int> hopOf(nrNodes, -1);
+		int nrWrong = neighborhood.hopOffsets.back() != (int)neighborhood.nodes.size();
+		for(int hopIt = 0; hopIt < neighborhood.GetNrHops(); ++hopIt) {
+			for(int slotIt = neighborhood.hopOffsets[hopIt]; slotIt < neighborhood.hopOffsets[hopIt + 1]; ++slotIt) {
+				int node = neighborhood.nodes[slotIt];
+				nrWrong += hopOf[node] != -1;
+				hopOf[node] = hopIt;
+				if(config.isWeightLimited)
+					nrWrong += neighborhood.weights[slotIt] != lightest[maxHops][node];
+			}
+		}
+		for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt) {
+			int expected = hops[nodeIt] <= maxHops ? hops[nodeIt] : -1;
+			if(config.isWeightLimited) {
+				expected = -1;
+				for(int hopIt = maxHops; hopIt >= 0; --hopIt)
+					expected = lightest[hopIt][nodeIt] <= maxWeight ? hopIt : expected;
+			}
+			nrWrong += hopOf[nodeIt] != expected;
+		}
+		KW_CHECK(nrWrong == 0);
+	}
+
+	// The cap drops nodes for good, so later hops only shrink
+	config.isWeightLimited = false;
+	config.maxNodesPerHop = 3;
+	extractor.Extract(seeds, config, neighborhood);
+	int nrOverCap = 0;
+	for(int hopIt = 1; hopIt < neighborhood.GetNrHops(); ++hopIt)
+		nrOverCap += neighborhood.hopOffsets[hopIt + 1] - neighborhood.hopOffsets[hopIt] > 3;
+	KW_CHECK(nrOverCap == 0 && neighborhood.GetNrHops() > 1);
+
+	// Every edge between two kept nodes, once
+	config.maxNodesPerHop = 0;
+	config.maxHops = 2;
+	KWGraph::IntGraph subgraph;
+	extractor.ExtractSubgraph(seeds, config, neighborhood, subgraph);
+	std::vector<int> slotOf(nrNodes, -1);
+	for(size_t slotIt = 0; slotIt < neighborhood.nodes.size(); ++slotIt)
+		slotOf[neighborhood.nodes[slotIt]] = (int)slotIt;
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(subgraph);
+	size_t nrInside = 0;
+	int nrWrong = subgraph.GetNrNodes() != neighborhood.nodes.size();
+	for(size_t slotIt = 0; slotIt < neighborhood.nodes.size(); ++slotIt) {
+		KWGraph::NeighborRange<int> neighbors = graph.Neighbors(neighborhood.nodes[slotIt]);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it) {
+			int slot = slotOf[it.GetDestination()];
+			if(slot == -1)
+				continue;
+			++nrInside;
+			nrWrong += !isAdjacent[slotIt][slot];
+		}
+	}
+	KW_CHECK(nrWrong == 0 && subgraph.GetNrEdges() == nrInside);
+}
+
+void TestKHop()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 120, 3, KWGraph::StorageType_AdjacencyList, 74);
+	CheckKHop(graph, 0, 60);
+
+	KWGraph::IntGraphView view(&graph);
+	view.FilterEdges(KWGraph::MinEdgeWeight<int>(3));
+	for(int nodeIt = 1; nodeIt < 120; nodeIt += 11)
+		view.SetNodeVisible(nodeIt, false);
+	CheckKHop(view, 0, 60);
+}
+// Neighbors of a view against the graph's own edges filtered by hand, the
+// sizes included
+int CountWrongViewNeighbors(const KWGraph::IntGraph& graph, const KWGraph::IntGraphView& view, int minWeight)
+{
+	int nrWrong = 0;
+	for(int nodeIt = 0; nodeIt < (int)graph.GetNrNodes(); ++nodeIt) {
+		std::vector<int> expected;
+		KWGraph::NeighborRange<int> neighbors = graph.Neighbors(nodeIt);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it) {
+			if(view.IsNodeVisible(nodeIt) && view.IsNodeVisible(it.GetDestination()) && (*it).weight >= minWeight)
+				expected.push_back(it.GetDestination());
+		}
+		std::vector<int> visible;
+		neighbors = view.Neighbors(nodeIt);
+		for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it)
+			visible.push_back(it.GetDestination());
+		nrWrong += visible != expected || neighbors.size() != expected.size();
+	}
+	return nrWrong;
+}
+
+void TestGraphView()
+{
+	for(int storageIt = 0; storageIt < 2; ++storageIt) {
+		KWGraph::IntGraph graph;
+		MakeRandomGraph(graph, 80, 10, storageIt ? KWGraph::StorageType_AdjacencyMatrix :
+							   KWGraph::StorageType_AdjacencyList, 75);
+		KWGraph::IntGraphView view(&graph);
+		unsigned int version = view.GetVersion();
+		view.FilterEdges(KWGraph::MinEdgeWeight<int>(4));
+		KW_CHECK(view.GetVersion() != version);
+		for(int nodeIt = 0; nodeIt < 80; nodeIt += 6)
+			view.SetNodeVisible(nodeIt, false);
+		KW_CHECK(CountWrongViewNeighbors(graph, view, 4) == 0);
+
+		// The degrees follow every later change to the masks
+		view.SetNodeVisible(1, false);
+		view.SetNodeVisible(0, true);
+		KW_CHECK(CountWrongViewNeighbors(graph, view, 4) == 0);
+
+		// The first calls after a change can come from several threads
+		view.SetNodeVisible(2, false);
+		std::atomic<int> nrEdges(0);
+		PParallelFor(0, 80, 1, [&view, &nrEdges](int begin, int end) {
+			for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+				nrEdges.fetch_add((int)view.Neighbors(nodeIt).size());
+		});
+		int nrExpected = 0;
+		for(int nodeIt = 0; nodeIt < 80; ++nodeIt) {
+			KWGraph::NeighborRange<int> neighbors = view.Neighbors(nodeIt);
+			for(KWGraph::NeighborRange<int>::Iterator it = neighbors.begin(); it != neighbors.end(); ++it)
+				++nrExpected;
+		}
+		KW_CHECK(nrEdges.load() == nrExpected && nrExpected > 0);
+
+		view.ShowAll();
+		KW_CHECK(CountWrongViewNeighbors(graph, view, 0) == 0);
+	}
+}
+// Keeps the order the nodes were processed in
+class RecordingVisitor : public KWGraph::IntGraphVisitor
+{
+public:
+	RecordingVisitor(int source, KWGraph::DFSOrder order) :
+		KWGraph::IntGraphVisitor(NULL, source), order(order), nrEnded(0) {}
+
+	virtual KWGraph::NodeAction OnNodeProcess(const KWGraph::Node<int>& node)
+	{
+		processed.push_back(node.id);
+		return KWGraph::NodeAction_Continue;
+	}
+
+	virtual KWGraph::NodeAction OnEndNodeProcess(const KWGraph::Node<int>& /*node*/)
+	{
+		++nrEnded;
+		return KWGraph::NodeAction_Continue;
+	}
+
+	KWGraph::DFSOrder order;
+	std::vector<int> processed;
+	int nrEnded;
+};
+
+// The workspace visitor traversals reach what a BFS reaches, BFS in
+// distance order and DFS along tree edges in the asked order
+template <typename GraphType>
+int CountWrongVisits(const GraphType& graph, int source)
+{
+	std::vector<int> distances = ReferenceDistances(graph, source);
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(graph);
+	size_t nrReachable = graph.GetNrNodes() - std::count(distances.begin(), distances.end(), -1);
+	KWGraph::TraversalWorkspace workspace;
+	RecordingVisitor bfsVisitor(source, KWGraph::DFSOrder_PreOrder);
+	graph.BFS(&bfsVisitor, workspace);
+	int nrWrong = bfsVisitor.processed.size() != nrReachable || bfsVisitor.nrEnded != (int)nrReachable;
+	for(size_t visitIt = 0; visitIt < bfsVisitor.processed.size(); ++visitIt) {
+		int node = bfsVisitor.processed[visitIt];
+		nrWrong += workspace.GetDistance(node) != distances[node];
+		if(visitIt > 0)
+			nrWrong += distances[node] < distances[bfsVisitor.processed[visitIt - 1]];
+	}
+
+	const KWGraph::DFSOrder orders[] = { KWGraph::DFSOrder_PreOrder, KWGraph::DFSOrder_PostOrder };
+	for(int orderIt = 0; orderIt < 2; ++orderIt) {
+		RecordingVisitor dfsVisitor(source, orders[orderIt]);
+		graph.DFS(&dfsVisitor, orders[orderIt], workspace);
+		nrWrong += dfsVisitor.processed.size() != nrReachable;
+		std::vector<int> position(graph.GetNrNodes(), -1);
+		for(size_t visitIt = 0; visitIt < dfsVisitor.processed.size(); ++visitIt)
+			position[dfsVisitor.processed[visitIt]] = (int)visitIt;
+		for(size_t visitIt = 0; visitIt < dfsVisitor.processed.size(); ++visitIt) {
+			int node = dfsVisitor.processed[visitIt];
+			int parent = workspace.GetParent(node);
+			nrWrong += distances[node] == -1;
+			if(node == source) {
+				nrWrong += parent != KWGraph::ROOT_ID || workspace.GetDistance(node) != 0;
+				continue;
+			}
+			nrWrong += parent < 0 || !isAdjacent[parent][node];
+			nrWrong += parent >= 0 && workspace.GetDistance(node) != workspace.GetDistance(parent) + 1;
+			// Parents come first in pre order and last in post order
+			if(parent >= 0 && orders[orderIt] == KWGraph::DFSOrder_PreOrder)
+				nrWrong += position[parent] > position[node];
+			else if(parent >= 0)
+				nrWrong += position[parent] < position[node];
+		}
+	}
+	return nrWrong;
+}
+
+// Every entry point that takes a graph also takes a view, checked against
+// the same brute force as the graph
+void TestViewEntryPoints()
+{
+	KWGraph::IntGraph graph;
+	MakeRandomGraph(graph, 60, 12, KWGraph::StorageType_AdjacencyMatrix, 75);
+	KWGraph::IntGraphView view(&graph);
+	view.FilterEdges(KWGraph::MinEdgeWeight<int>(3));
+	for(int nodeIt = 1; nodeIt < 60; nodeIt += 7)
+		view.SetNodeVisible(nodeIt, false);
+
+	std::vector< std::vector<bool> > isAdjacent = MakeAdjacencyMatrix(view);
+	long long nrTriangles = 0;
+	for(int first = 0; first < 60; ++first) {
+		for(int second = first + 1; second < 60; ++second) {
+			for(int third = second + 1; third < 60 && isAdjacent[first][second]; ++third)
+				nrTriangles += isAdjacent[first][third] && isAdjacent[second][third];
+		}
+	}
+	KW_CHECK(nrTriangles > 0 && KWGraph::CountMatrixTriangles(view) == nrTriangles);
+	KW_CHECK(KWGraph::CountTriangles(view) == nrTriangles);
+	KW_CHECK(KWGraph::CountMatrixTriangles(graph) > nrTriangles);
+
+	KW_CHECK(CountWrongVisits(graph, 0) == 0);
+	KW_CHECK(CountWrongVisits(view, 0) == 0 && CountWrongVisits(view, 16) == 0);
+	KWGraph::TraversalWorkspace workspace;
+	RecordingVisitor hiddenVisitor(1, KWGraph::DFSOrder_PreOrder);
+	view.BFS(&hiddenVisitor, workspace);
+	view.DFS(&hiddenVisitor, KWGraph::DFSOrder_PreOrder, workspace);
+	KW_CHECK(hiddenVisitor.processed.empty());
+
+	// The query engines answer like a BFS on the view
+	KWGraph::AsyncQueryEngine< int, KWGraph::IntGraphView > asyncEngine(&view);
+	KWGraph::BatchQueryEngine< int, KWGraph::IntGraphView > batchEngine(&view);
+	KWGraph::ShortestPathCache< int, KWGraph::IntGraphView > cache(&view, 1 << 20);
+	KWGraph::ComponentsFuture components = asyncEngine.Components();
+	std::vector<KWGraph::PathQuery> queries;
+	for(int source = 0; source < 60; source += 5) {
+		for(int destination = 0; destination < 60; destination += 3)
+			queries.push_back(KWGraph::PathQuery(source, destination));
+	}
+	std::vector<KWGraph::PathQueryResult> results;
+	batchEngine.ShortestPaths(queries, results);
+	int nrWrong = 0;
+	int nrFound = 0;
+	std::vector<int> path;
+	for(int source = 0; source < 60; source += 5) {
+		std::vector<int> distances = ReferenceDistances(view, source);
+		if(!view.IsNodeVisible(source))
+			distances.assign(60, -1);
+		KWGraph::DistancesFuture asyncDistances = asyncEngine.Distances(source);
+		nrWrong += asyncDistances.Get() != distances;
+		for(int destination = 0; destination < 60; destination += 3) {
+			int distance = distances[destination];
+			nrFound += distance != -1;
+			KWGraph::PathFuture asyncPath = asyncEngine.ShortestPath(source, destination);
+			nrWrong += asyncPath.Get().found != (distance != -1);
+			nrWrong += cache.GetDistance(source, destination) != distance;
+			const KWGraph::PathQueryResult& result = results[(source / 5) * 20 + destination / 3];
+			nrWrong += result.found != (distance != -1);
+			if(distance == -1)
+				continue;
+			nrWrong += (int)asyncPath.Get().path.size() != distance + 1 || (int)result.path.size() != distance + 1;
+			for(size_t pathIt = 1; pathIt < result.path.size(); ++pathIt)
+				nrWrong += !isAdjacent[result.path[pathIt - 1]][result.path[pathIt]];
+		}
+	}
+	KW_CHECK(nrWrong == 0 && nrFound > 0);
+
+	// Same component exactly when reachable, hidden nodes are in none
+	const KWGraph::ComponentsQueryResult& componentResult = components.Get();
+	for(int nodeIt = 0; nodeIt < 60; ++nodeIt) {
+		std::vector<int> distances = ReferenceDistances(view, nodeIt);
+		int component = componentResult.componentIds[nodeIt];
+		if(!view.IsNodeVisible(nodeIt)) {
+			nrWrong += component != KWGraph::INVALID_ID;
+			continue;
+		}
+		for(int otherIt = 0; otherIt < 60; ++otherIt) {
+			if(view.IsNodeVisible(otherIt))
+				nrWrong += (component == componentResult.componentIds[otherIt]) != (distances[otherIt] != -1);
+		}
+	}
+	KW_CHECK(nrWrong == 0);
+
+	// Hiding a node changes the view version, so the cache starts over
+	KW_CHECK(cache.GetDistance(0, 0) == 0);
+	view.SetNodeVisible(0, false);
+	KW_CHECK(cache.GetDistance(0, 0) == -1);
+}
+}
 
 int main()
 {
 	KWGraph::IntGraph graph;
 	KWGraph::IntPrinter printer(&graph);
-	graph.InitializeGraph(8, 	KWGraph::GraphCreationFlags_Connected, 
+	graph.InitializeGraph(8, 	KWGraph::GraphCreationFlags_Connected, 1,
 								KWGraph::StorageType_AdjacencyList);
-	
+
 	graph.BFS(&printer);
 	graph.DFS(&printer, KWGraph::DFSOrder_PreOrder);
 	graph.DFS(&printer, KWGraph::DFSOrder_PostOrder);
+
+	TestBinaryLogger();
+	TestTaskScheduler();
+	TestCpuTopology();
+	TestAsyncQueries();
+	TestBatchQueries();
+	TestPathCache();
+	TestTraversalRanges();
+	TestNeighborRange();
+	TestTriangles();
+	TestCoreNumbers();
+	TestSpanningForests();
+	TestMaxFlow();
+	TestBetweenness();
+	TestCommunities();
+	TestColoring();
+	TestTopologicalSort();
+	TestBiconnectedComponents();
+	TestRandomWalks();
+	TestPersonalizedPageRank();
+	TestSemiringProducts();
+	TestReachability();
+	TestLandmarkLabels();
+	TestNeighborhoodFunction();
+	TestKHop();
+	TestGraphView();
+	TestViewEntryPoints();
+
+	printf("%d failed checks\n", nrFailures);
+	return nrFailures;
 }
@@ -0,0 +1,303 @@
+#ifndef KWGRAPH_TOPOSORT_H
+#define KWGRAPH_TOPOSORT_H
+
+#include <atomic>
+#include "graphview.h"
+
+namespace KWGraph
+{
+    // Topological order split into levels, every edge goes from a level to
+    // a later one so the nodes of a level don't depend on each other
+    struct TopologicalOrder
+    {
+        std::vector<int> order;
+        // Level i is order[levelOffsets[i]] .. order[levelOffsets[i + 1]]
+        std::vector<int> levelOffsets;
+
+        inline int GetNrLevels() const { return levelOffsets.empty() ? 0 : (int)levelOffsets.size() - 1; }
+    };
+
+    namespace
+    {
+        // Levels smaller than this are done on the calling thread, spawning
+        // costs more than they do
+        static const int s_minParallelLevel = 1024;
+
+        template <typename T, typename GraphType>
+        struct KahnData
+        {
+            const GraphType*                graph;
+            std::vector< std::atomic<int> >* inDegrees;
+            std::vector<int>*               order;
+            // Where the next node that runs out of incoming edges goes
+            std::atomic<int>*               orderEnd;
+        };
+
+        template <typename T, typename GraphType>
+        static void CountInDegrees(void* userData, int begin, int end)
+        {
+            KahnData<T, GraphType>* data = static_cast<KahnData<T, GraphType>*>(userData);
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                NeighborRange<T> neighbors = data->graph->Neighbors(nodeIt);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                    (*data->inDegrees)[edgeIt.GetDestination()].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // Removes the out edges of order[begin, end), the nodes left without
+        // incoming edges make up the next level
+        template <typename T, typename GraphType>
+        static void ReleaseLevel(void* userData, int begin, int end)
+        {
+            KahnData<T, GraphType>* data = static_cast<KahnData<T, GraphType>*>(userData);
+            for(int orderIt = begin; orderIt < end; ++orderIt)
+            {
+                NeighborRange<T> neighbors = data->graph->Neighbors((*data->order)[orderIt]);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    int destination = edgeIt.GetDestination();
+                    if((*data->inDegrees)[destination].fetch_sub(1, std::memory_order_relaxed) == 1)
+                        (*data->order)[data->orderEnd->fetch_add(1, std::memory_order_relaxed)] = destination;
+                }
+            }
+        }
+
+        template <typename T, typename GraphType>
+        static bool RunKahn(const GraphType& graph, TopologicalOrder& topologicalOrder)
+        {
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            std::vector<int>& order = topologicalOrder.order;
+            order.resize(nrNodes);
+            topologicalOrder.levelOffsets.assign(1, 0);
+            if(nrNodes == 0)
+                return true;
+
+            std::vector< std::atomic<int> > inDegrees(nrNodes);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                inDegrees[nodeIt].store(0, std::memory_order_relaxed);
+            std::atomic<int> orderEnd(0);
+            KahnData<T, GraphType> data;
+            data.graph = &graph;
+            data.inDegrees = &inDegrees;
+            data.order = &order;
+            data.orderEnd = &orderEnd;
+            PParallelFor(0, nrNodes, 0, CountInDegrees<T, GraphType>, &data);
+
+            int nrOrdered = 0;
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                if(inDegrees[nodeIt].load(std::memory_order_relaxed) == 0)
+                    order[nrOrdered++] = nodeIt;
+            }
+            orderEnd.store(nrOrdered);
+
+            int levelBegin = 0;
+            while(levelBegin < nrOrdered)
+            {
+                topologicalOrder.levelOffsets.push_back(nrOrdered);
+                if(nrOrdered - levelBegin < s_minParallelLevel)
+                    ReleaseLevel<T, GraphType>(&data, levelBegin, nrOrdered);
+                else
+                    PParallelFor(levelBegin, nrOrdered, 0, ReleaseLevel<T, GraphType>, &data);
+                levelBegin = nrOrdered;
+                nrOrdered = orderEnd.load();
+            }
+
+            order.resize(nrOrdered);
+            return nrOrdered == nrNodes;
+        }
+    }
+
+    // Level synchronous parallel Kahn. Edges are followed as stored, so an
+    // edge added with AddListEdge(..., true) is a two node cycle, use
+    // directed = false to build a DAG. Returns false if the graph has a
+    // cycle, order then only holds the nodes that come before it
+    template <typename T>
+    bool TopologicalSort(const Graph<T>& graph, TopologicalOrder& topologicalOrder)
+    {
+        return RunKahn<T>(graph, topologicalOrder);
+    }
+
+    // Only the visible edges, hidden nodes have none and get ordered too
+    template <typename T>
+    bool TopologicalSort(const GraphView<T>& graph, TopologicalOrder& topologicalOrder)
+    {
+        return RunKahn<T>(graph, topologicalOrder);
+    }
+
+    namespace
+    {
+        // Incoming edges of every node in CSR, for pulling the distances
+        template <typename T>
+        struct IncomingEdges
+        {
+            std::vector<int>    offsets;
+            std::vector<int>    sources;
+            std::vector<T>      weights;
+        };
+
+        template <typename T, typename GraphType>
+        static void BuildIncomingEdges(const GraphType& graph, IncomingEdges<T>& incoming)
+        {
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            incoming.offsets.assign(nrNodes + 1, 0);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                NeighborRange<T> neighbors = graph.Neighbors(nodeIt);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                    ++incoming.offsets[edgeIt.GetDestination() + 1];
+            }
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                incoming.offsets[nodeIt + 1] += incoming.offsets[nodeIt];
+
+            incoming.sources.resize(incoming.offsets[nrNodes]);
+            incoming.weights.resize(incoming.offsets[nrNodes]);
+            std::vector<int> fill(incoming.offsets.begin(), incoming.offsets.end() - 1);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            {
+                NeighborRange<T> neighbors = graph.Neighbors(nodeIt);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin();
+                    edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    NeighborView<T> edge = *edgeIt;
+                    int slot = fill[edge.destination]++;
+                    incoming.sources[slot] = nodeIt;
+                    incoming.weights[slot] = edge.weight;
+                }
+            }
+        }
+
+        template <typename T>
+        struct DAGPathData
+        {
+            const IncomingEdges<T>* incoming;
+            const std::vector<int>* order;
+            std::vector<T>*         distances;
+            std::vector<int>*       parents;
+            bool                    isLongest;
+            // Without a source every node that is not reached from another
+            // node starts its own path at 0
+            bool                    isEveryRoot;
+        };
+
+        // The nodes of one level pull their distance from their incoming
+        // edges, whose sources are all on earlier levels and final
+        template <typename T>
+        static void PullDistances(void* userData, int begin, int end)
+        {
+            DAGPathData<T>* data = static_cast<DAGPathData<T>*>(userData);
+            const IncomingEdges<T>& incoming = *data->incoming;
+            std::vector<T>& distances = *data->distances;
+            std::vector<int>& parents = *data->parents;
+            for(int orderIt = begin; orderIt < end; ++orderIt)
+            {
+                int nodeId = (*data->order)[orderIt];
+                if(parents[nodeId] == ROOT_ID)
+                    continue;
+                for(int edgeIt = incoming.offsets[nodeId]; edgeIt < incoming.offsets[nodeId + 1]; ++edgeIt)
+                {
+                    int source = incoming.sources[edgeIt];
+                    if(parents[source] == INVALID_ID)
+                        continue;
+                    T distance = distances[source] + incoming.weights[edgeIt];
+                    bool isBetter = data->isLongest ? distances[nodeId] < distance
+                                                    : distance < distances[nodeId];
+                    if(parents[nodeId] == INVALID_ID || isBetter)
+                    {
+                        distances[nodeId] = distance;
+                        parents[nodeId] = source;
+                    }
+                }
+                if(parents[nodeId] == INVALID_ID && data->isEveryRoot)
+                {
+                    distances[nodeId] = T(0);
+                    parents[nodeId] = ROOT_ID;
+                }
+            }
+        }
+
+        template <typename T, typename GraphType>
+        static bool GetDAGPaths(const GraphType& graph, int source, bool isLongest,
+                                std::vector<T>& distances, std::vector<int>& parents)
+        {
+            int nrNodes = static_cast<int>(graph.GetNrNodes());
+            distances.assign(nrNodes, T(0));
+            parents.assign(nrNodes, INVALID_ID);
+            TopologicalOrder topologicalOrder;
+            if(!RunKahn<T>(graph, topologicalOrder))
+                return false;
+            if(source >= nrNodes)
+                return false;
+            if(source >= 0)
+                parents[source] = ROOT_ID;
+
+            IncomingEdges<T> incoming;
+            BuildIncomingEdges(graph, incoming);
+            DAGPathData<T> data;
+            data.incoming = &incoming;
+            data.order = &topologicalOrder.order;
+            data.distances = &distances;
+            data.parents = &parents;
+            data.isLongest = isLongest;
+            data.isEveryRoot = source < 0;
+            for(int levelIt = 0; levelIt < topologicalOrder.GetNrLevels(); ++levelIt)
+            {
+                int levelBegin = topologicalOrder.levelOffsets[levelIt];
+                int levelEnd = topologicalOrder.levelOffsets[levelIt + 1];
+                if(levelEnd - levelBegin < s_minParallelLevel)
+                    PullDistances<T>(&data, levelBegin, levelEnd);
+                else
+                    PParallelFor(levelBegin, levelEnd, 0, PullDistances<T>, &data);
+            }
+            return true;
+        }
+    }
+
+    // Single source shortest paths on a DAG in O(nodes + edges), negative
+    // weights are fine. parents holds ROOT_ID for the source and INVALID_ID
+    // for the nodes it doesn't reach. Returns false if the graph has a cycle
+    template <typename T>
+    bool DAGShortestPaths(const Graph<T>& graph, int source, std::vector<T>& distances, std::vector<int>& parents)
+    {
+        return source >= 0 && GetDAGPaths(graph, source, false, distances, parents);
+    }
+
+    template <typename T>
+    bool DAGShortestPaths(const GraphView<T>& graph, int source, std::vector<T>& distances, std::vector<int>& parents)
+    {
+        return source >= 0 && GetDAGPaths(graph, source, false, distances, parents);
+    }
+
+    // Same as DAGShortestPaths but with the heaviest paths
+    template <typename T>
+    bool DAGLongestPaths(const Graph<T>& graph, int source, std::vector<T>& distances, std::vector<int>& parents)
+    {
+        return source >= 0 && GetDAGPaths(graph, source, true, distances, parents);
+    }
+
+    template <typename T>
+    bool DAGLongestPaths(const GraphView<T>& graph, int source, std::vector<T>& distances, std::vector<int>& parents)
+    {
+        return source >= 0 && GetDAGPaths(graph, source, true, distances, parents);
+    }
+
+    // Heaviest path ending at every node, starting from any node without
+    // incoming edges (the critical path when weights are durations)
+    template <typename T>
+    bool DAGLongestPaths(const Graph<T>& graph, std::vector<T>& distances, std::vector<int>& parents)
+    {
+        return GetDAGPaths(graph, -1, true, distances, parents);
+    }
+
+    template <typename T>
+    bool DAGLongestPaths(const GraphView<T>& graph, std::vector<T>& distances, std::vector<int>& parents)
+    {
+        return GetDAGPaths(graph, -1, true, distances, parents);
+    }
+}
+
+#endif
@@ -0,0 +1,439 @@
+#ifndef KWGRAPH_TRIANGLES_H
+#define KWGRAPH_TRIANGLES_H
+
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+#include "adjacency.h"
+#include "intersect.h"
+
+namespace KWGraph
+{
+    // Triangle counting treats the graph as undirected, see SymmetricAdjacency.
+    // Every edge is oriented from the endpoint with the lower (degree, id)
+    // rank to the higher one, which caps the out degree of a node at
+    // O(sqrt(edges)). A triangle is then found exactly once, by intersecting
+    // the oriented lists of its two lowest ranked nodes.
+
+    struct OrientedAdjacency
+    {
+        std::vector<int> offsets;
+        std::vector<int> targets;
+    };
+
+    namespace
+    {
+        template <typename T>
+        struct OrientData
+        {
+            const SymmetricAdjacency<T>*    adjacency;
+            OrientedAdjacency*              oriented;
+        };
+
+        template <typename T>
+        static inline bool IsRankedHigher(const SymmetricAdjacency<T>& adjacency, int node, int other)
+        {
+            int degree = adjacency.GetDegree(node);
+            int otherDegree = adjacency.GetDegree(other);
+            return otherDegree > degree || (otherDegree == degree && other > node);
+        }
+
+        template <typename T>
+        static void CountOrientedEdges(void* userData, int begin, int end)
+        {
+            OrientData<T>* data = static_cast<OrientData<T>*>(userData);
+            const SymmetricAdjacency<T>& adjacency = *data->adjacency;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                const int* neighbors = adjacency.GetNeighbors(nodeIt);
+                int degree = adjacency.GetDegree(nodeIt);
+                int nrOriented = 0;
+                for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+                    nrOriented += IsRankedHigher(adjacency, nodeIt, neighbors[neighborIt]);
+                data->oriented->offsets[nodeIt + 1] = nrOriented;
+            }
+        }
+
+        template <typename T>
+        static void FillOrientedEdges(void* userData, int begin, int end)
+        {
+            OrientData<T>* data = static_cast<OrientData<T>*>(userData);
+            const SymmetricAdjacency<T>& adjacency = *data->adjacency;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                const int* neighbors = adjacency.GetNeighbors(nodeIt);
+                int degree = adjacency.GetDegree(nodeIt);
+                int outIt = data->oriented->offsets[nodeIt];
+                // Neighbors are sorted by id so the oriented lists are too
+                for(int neighborIt = 0; neighborIt < degree; ++neighborIt)
+                {
+                    if(IsRankedHigher(adjacency, nodeIt, neighbors[neighborIt]))
+                        data->oriented->targets[outIt++] = neighbors[neighborIt];
+                }
+            }
+        }
+
+        struct TriangleCountData
+        {
+            const OrientedAdjacency*            oriented;
+            std::atomic<long long>*             total;
+            // Optional, per node triangle counts
+            std::vector< std::atomic<long long> >* nodeTriangles;
+        };
+
+        struct CountThirdNodes
+        {
+            std::vector< std::atomic<long long> >* nodeTriangles;
+            inline void operator()(int node) const
+            {
+                (*nodeTriangles)[node].fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+
+        static void CountTrianglesInRange(void* userData, int begin, int end)
+        {
+            TriangleCountData* data = static_cast<TriangleCountData*>(userData);
+            const OrientedAdjacency& oriented = *data->oriented;
+            long long rangeTotal = 0;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                const int* nodeTargets = oriented.targets.data() + oriented.offsets[nodeIt];
+                int nodeDegree = oriented.offsets[nodeIt + 1] - oriented.offsets[nodeIt];
+                long long nodeTotal = 0;
+                for(int targetIt = 0; targetIt < nodeDegree; ++targetIt)
+                {
+                    int target = nodeTargets[targetIt];
+                    const int* targetTargets = oriented.targets.data() + oriented.offsets[target];
+                    int targetDegree = oriented.offsets[target + 1] - oriented.offsets[target];
+                    long long found;
+                    if(data->nodeTriangles)
+                    {
+                        CountThirdNodes countThird = { data->nodeTriangles };
+                        found = IntersectSorted(nodeTargets, nodeDegree, targetTargets, targetDegree, countThird);
+                        if(found)
+                            (*data->nodeTriangles)[target].fetch_add(found, std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        found = IntersectSortedSize(nodeTargets, nodeDegree, targetTargets, targetDegree);
+                    }
+                    nodeTotal += found;
+                }
+                if(data->nodeTriangles && nodeTotal)
+                    (*data->nodeTriangles)[nodeIt].fetch_add(nodeTotal, std::memory_order_relaxed);
+                rangeTotal += nodeTotal;
+            }
+            data->total->fetch_add(rangeTotal, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename T>
+    void BuildOrientedAdjacency(const SymmetricAdjacency<T>& adjacency, OrientedAdjacency& oriented)
+    {
+        int nrNodes = static_cast<int>(adjacency.GetNrNodes());
+        oriented.offsets.assign(nrNodes + 1, 0);
+        if(nrNodes == 0)
+        {
+            oriented.targets.clear();
+            return;
+        }
+
+        OrientData<T> data;
+        data.adjacency = &adjacency;
+        data.oriented = &oriented;
+        PParallelFor(0, nrNodes, 0, CountOrientedEdges<T>, &data);
+        for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+            oriented.offsets[nodeIt + 1] += oriented.offsets[nodeIt];
+        oriented.targets.resize(oriented.offsets[nrNodes]);
+        PParallelFor(0, nrNodes, 0, FillOrientedEdges<T>, &data);
+    }
+
+    // Counts the triangles of the graph and, when nodeTriangles isn't NULL,
+    // how many triangles every node is part of
+    template <typename T>
+    long long CountTriangles(const SymmetricAdjacency<T>& adjacency, std::vector<long long>* nodeTriangles)
+    {
+        int nrNodes = static_cast<int>(adjacency.GetNrNodes());
+        if(nrNodes == 0)
+        {
+            if(nodeTriangles)
+                nodeTriangles->clear();
+            return 0;
+        }
+
+        OrientedAdjacency oriented;
+        BuildOrientedAdjacency(adjacency, oriented);
+
+        std::atomic<long long> total(0);
+        std::vector< std::atomic<long long> > nodeCounts(nodeTriangles ? nrNodes : 0);
+        for(size_t nodeIt = 0; nodeIt < nodeCounts.size(); ++nodeIt)
+            nodeCounts[nodeIt].store(0, std::memory_order_relaxed);
+
+        TriangleCountData data;
+        data.oriented = &oriented;
+        data.total = &total;
+        data.nodeTriangles = nodeTriangles ? &nodeCounts : NULL;
+        // The work per node grows with the square of its oriented degree so
+        // the ranges are kept small and left to the work stealing to balance
+        PParallelFor(0, nrNodes, 64, CountTrianglesInRange, &data);
+
+        if(nodeTriangles)
+        {
+            nodeTriangles->resize(nrNodes);
+            for(int nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+                (*nodeTriangles)[nodeIt] = nodeCounts[nodeIt].load(std::memory_order_relaxed);
+        }
+        return total.load();
+    }
+
+    template <typename T>
+    long long CountTriangles(const Graph<T>& graph)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        return CountTriangles(adjacency, (std::vector<long long>*)NULL);
+    }
+
+    template <typename T>
+    long long CountTriangles(const GraphView<T>& graph)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        return CountTriangles(adjacency, (std::vector<long long>*)NULL);
+    }
+
+    template <typename T>
+    long long CountTriangles(const Graph<T>& graph, std::vector<long long>& nodeTriangles)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        return CountTriangles(adjacency, &nodeTriangles);
+    }
+
+    template <typename T>
+    long long CountTriangles(const GraphView<T>& graph, std::vector<long long>& nodeTriangles)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        return CountTriangles(adjacency, &nodeTriangles);
+    }
+
+    // Local clustering coefficient, the fraction of pairs of neighbors that
+    // are connected. Nodes with less than two neighbors get 0
+    template <typename T>
+    void ClusteringCoefficients(const SymmetricAdjacency<T>& adjacency, std::vector<double>& coefficients)
+    {
+        std::vector<long long> nodeTriangles;
+        CountTriangles(adjacency, &nodeTriangles);
+
+        size_t nrNodes = adjacency.GetNrNodes();
+        coefficients.resize(nrNodes);
+        for(size_t nodeIt = 0; nodeIt < nrNodes; ++nodeIt)
+        {
+            double degree = adjacency.GetDegree(nodeIt);
+            coefficients[nodeIt] = (degree < 2) ? 0.0
+                                                : 2.0 * nodeTriangles[nodeIt] / (degree * (degree - 1));
+        }
+    }
+
+    template <typename T>
+    void ClusteringCoefficients(const Graph<T>& graph, std::vector<double>& coefficients)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        ClusteringCoefficients(adjacency, coefficients);
+    }
+
+    template <typename T>
+    void ClusteringCoefficients(const GraphView<T>& graph, std::vector<double>& coefficients)
+    {
+        SymmetricAdjacency<T> adjacency;
+        BuildSymmetricAdjacency(graph, adjacency);
+        ClusteringCoefficients(adjacency, coefficients);
+    }
+
+    namespace
+    {
+        struct BitMatrixData
+        {
+            const std::vector<uint64_t>*    rows;
+            size_t                          nrWords;
+            int                             nrNodes;
+            std::atomic<long long>*         total;
+        };
+
+        template <typename T, typename GraphType>
+        struct BitMatrixBuildData
+        {
+            const GraphType*                graph;
+            std::vector<uint64_t>*          rows;
+            // The out edges of a view, see BuildViewBitRows
+            std::vector<uint64_t>*          outRows;
+            size_t                          nrWords;
+        };
+
+        template <typename T>
+        static void BuildBitRows(void* userData, int begin, int end)
+        {
+            BitMatrixBuildData< T, Graph<T> >* data = static_cast<BitMatrixBuildData< T, Graph<T> >*>(userData);
+            const std::vector<T>& matrix = data->graph->GetAdjacencyMatrix();
+            int nrNodes = static_cast<int>(data->graph->GetNrNodes());
+            for(int rowIt = begin; rowIt < end; ++rowIt)
+            {
+                uint64_t* row = &(*data->rows)[rowIt * data->nrWords];
+                for(int columnIt = 0; columnIt < nrNodes; ++columnIt)
+                {
+                    // Symmetric and without the diagonal, same as the lists
+                    bool isEdge = columnIt != rowIt &&
+                                  (matrix[data->graph->GetMatrixIndex(rowIt, columnIt)] != T(0) ||
+                                   matrix[data->graph->GetMatrixIndex(columnIt, rowIt)] != T(0));
+                    if(isEdge)
+                        row[columnIt >> 6] |= uint64_t(1) << (columnIt & 63);
+                }
+            }
+        }
+
+        // A view hides matrix entries through its masks, so its rows come
+        // from Neighbors. A row only gets the out edges of its own node here,
+        // the symmetric rows are made from them in a second pass so no two
+        // threads write the same row
+        template <typename T>
+        static void BuildViewOutBitRows(void* userData, int begin, int end)
+        {
+            BitMatrixBuildData< T, GraphView<T> >* data = static_cast<BitMatrixBuildData< T, GraphView<T> >*>(userData);
+            std::vector<uint64_t>& outRows = *data->outRows;
+            for(int rowIt = begin; rowIt < end; ++rowIt)
+            {
+                uint64_t* row = &outRows[rowIt * data->nrWords];
+                NeighborRange<T> neighbors = data->graph->Neighbors(rowIt);
+                for(typename NeighborRange<T>::Iterator edgeIt = neighbors.begin(); edgeIt != neighbors.end(); ++edgeIt)
+                {
+                    int columnIt = edgeIt.GetDestination();
+                    if(columnIt != rowIt)
+                        row[columnIt >> 6] |= uint64_t(1) << (columnIt & 63);
+                }
+            }
+        }
+
+        template <typename T>
+        static void BuildViewBitRows(void* userData, int begin, int end)
+        {
+            BitMatrixBuildData< T, GraphView<T> >* data = static_cast<BitMatrixBuildData< T, GraphView<T> >*>(userData);
+            const std::vector<uint64_t>& outRows = *data->outRows;
+            size_t nrWords = data->nrWords;
+            int nrNodes = static_cast<int>(data->graph->GetNrNodes());
+            for(int rowIt = begin; rowIt < end; ++rowIt)
+            {
+                uint64_t* row = &(*data->rows)[rowIt * nrWords];
+                memcpy(row, &outRows[rowIt * nrWords], nrWords * sizeof(uint64_t));
+                uint64_t rowBit = uint64_t(1) << (rowIt & 63);
+                for(int columnIt = 0; columnIt < nrNodes; ++columnIt)
+                {
+                    if(outRows[columnIt * nrWords + (rowIt >> 6)] & rowBit)
+                        row[columnIt >> 6] |= uint64_t(1) << (columnIt & 63);
+                }
+            }
+        }
+
+        static void CountBitMatrixTriangles(void* userData, int begin, int end)
+        {
+            BitMatrixData* data = static_cast<BitMatrixData*>(userData);
+            size_t nrWords = data->nrWords;
+            long long rangeTotal = 0;
+            for(int nodeIt = begin; nodeIt < end; ++nodeIt)
+            {
+                const uint64_t* row = &(*data->rows)[nodeIt * nrWords];
+                // Only look at neighbors above the node and third nodes above
+                // the neighbor so every triangle is counted once
+                for(size_t neighborWord = (nodeIt + 1) >> 6; neighborWord < nrWords; ++neighborWord)
+                {
+                    uint64_t neighborBits = row[neighborWord];
+                    if(neighborWord == (size_t)(nodeIt + 1) >> 6)
+                        neighborBits &= ~uint64_t(0) << ((nodeIt + 1) & 63);
+                    while(neighborBits)
+                    {
+#if defined(__GNUC__)
+                        int neighbor = (int)(neighborWord << 6) + __builtin_ctzll(neighborBits);
+#else
+                        int neighbor = (int)(neighborWord << 6);
+                        while(!(neighborBits & (uint64_t(1) << (neighbor & 63))))
+                            ++neighbor;
+#endif
+                        neighborBits &= neighborBits - 1;
+
+                        const uint64_t* neighborRow = &(*data->rows)[neighbor * nrWords];
+                        int firstThird = neighbor + 1;
+                        size_t wordIt = firstThird >> 6;
+                        if(wordIt >= nrWords)
+                            continue;
+                        uint64_t firstMask = ~uint64_t(0) << (firstThird & 63);
+                        rangeTotal += PopCount64(row[wordIt] & neighborRow[wordIt] & firstMask);
+                        for(++wordIt; wordIt < nrWords; ++wordIt)
+                            rangeTotal += PopCount64(row[wordIt] & neighborRow[wordIt]);
+                    }
+                }
+            }
+            data->total->fetch_add(rangeTotal, std::memory_order_relaxed);
+        }
+    }
+
+    namespace
+    {
+        static long long CountBitRowTriangles(const std::vector<uint64_t>& rows, int nrNodes, size_t nrWords)
+        {
+            std::atomic<long long> total(0);
+            BitMatrixData data;
+            data.rows = &rows;
+            data.nrWords = nrWords;
+            data.nrNodes = nrNodes;
+            data.total = &total;
+            // Low rows have more neighbors above them, small ranges even that out
+            PParallelFor(0, nrNodes, 16, CountBitMatrixTriangles, &data);
+            return total.load();
+        }
+    }
+
+    // Dense graph variant for graphs stored in the adjacency matrix. The
+    // matrix is turned into rows of bits and the triangles closed by an edge
+    // are the popcount of the AND of its two rows
+    template <typename T>
+    long long CountMatrixTriangles(const Graph<T>& graph)
+    {
+        int nrNodes = static_cast<int>(graph.GetNrNodes());
+        if(nrNodes == 0 || graph.GetAdjacencyMatrix().size() != (size_t)nrNodes * nrNodes)
+            return 0;
+
+        size_t nrWords = (nrNodes + 63) / 64;
+        std::vector<uint64_t> rows(nrWords * nrNodes, 0);
+        BitMatrixBuildData< T, Graph<T> > buildData;
+        buildData.graph = &graph;
+        buildData.rows = &rows;
+        buildData.outRows = NULL;
+        buildData.nrWords = nrWords;
+        PParallelFor(0, nrNodes, 0, BuildBitRows<T>, &buildData);
+        return CountBitRowTriangles(rows, nrNodes, nrWords);
+    }
+
+    // Only the visible edges, the graph still needs its matrix
+    template <typename T>
+    long long CountMatrixTriangles(const GraphView<T>& graph)
+    {
+        int nrNodes = static_cast<int>(graph.GetNrNodes());
+        if(nrNodes == 0 || graph.GetGraph().GetAdjacencyMatrix().size() != (size_t)nrNodes * nrNodes)
+            return 0;
+
+        size_t nrWords = (nrNodes + 63) / 64;
+        std::vector<uint64_t> outRows(nrWords * nrNodes, 0);
+        std::vector<uint64_t> rows(nrWords * nrNodes);
+        BitMatrixBuildData< T, GraphView<T> > buildData;
+        buildData.graph = &graph;
+        buildData.rows = &rows;
+        buildData.outRows = &outRows;
+        buildData.nrWords = nrWords;
+        PParallelFor(0, nrNodes, 0, BuildViewOutBitRows<T>, &buildData);
+        PParallelFor(0, nrNodes, 0, BuildViewBitRows<T>, &buildData);
+        return CountBitRowTriangles(rows, nrNodes, nrWords);
+    }
+}
+
+#endif